@@ -0,0 +1,657 @@
+/*
+	dio_column.c
+	Columnar trace format of dioparse.
+
+	This source is free on GNU General Public License.
+*/
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "dio_column.h"
+
+#define DIO_COL_TRAILER_LEN	(8 + DIO_COL_MAGIC_LEN)
+#define DIO_COL_MAX_VARINT	10
+#define INIT_PID_INDEX_SIZE	64
+
+// blocks which have the bits of a pid, in increasing order
+struct dio_col_pidlist{
+	uint32_t* blocks;
+	uint32_t cnt;
+	uint32_t size;
+};
+
+/*--------------	encoding	------------------*/
+static inline uint8_t* put_varint(uint8_t* p, uint64_t v){
+	while( v >= 0x80 ){
+		*p++ = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (uint8_t)v;
+	return p;
+}
+
+// return NULL if the varint is over the end
+static inline const uint8_t* get_varint(const uint8_t* p, const uint8_t* end, uint64_t* v){
+	uint64_t r = 0;
+	int shift = 0;
+
+	while( p < end && shift < 64 ){
+		r |= (uint64_t)(*p & 0x7f) << shift;
+		if( !(*p++ & 0x80) ){
+			*v = r;
+			return p;
+		}
+		shift += 7;
+	}
+	return NULL;
+}
+
+static inline uint64_t zigzag(uint64_t cur, uint64_t prev){
+	int64_t d = (int64_t)(cur - prev);
+	return ((uint64_t)d << 1) ^ (uint64_t)(d >> 63);
+}
+
+static inline uint64_t unzigzag(uint64_t z, uint64_t prev){
+	return prev + ((z >> 1) ^ (uint64_t)(-(int64_t)(z & 1)));
+}
+
+static bool write_all(int fd, const void* buf, size_t len){
+	const char* p = (const char*)buf;
+	ssize_t wrsz;
+
+	while( len > 0 ){
+		wrsz = write(fd, p, len);
+		if( wrsz < 0 ){
+			if( errno == EINTR )
+				continue;
+			return false;
+		}
+		p += wrsz;
+		len -= wrsz;
+	}
+	return true;
+}
+
+static bool pread_all(int fd, void* buf, size_t len, uint64_t offset){
+	char* p = (char*)buf;
+	ssize_t rdsz;
+
+	while( len > 0 ){
+		rdsz = pread(fd, p, len, (off_t)offset);
+		if( rdsz < 0 ){
+			if( errno == EINTR )
+				continue;
+			return false;
+		}
+		if( rdsz == 0 ){
+			errno = EINVAL;		//truncated file
+			return false;
+		}
+		p += rdsz;
+		len -= rdsz;
+		offset += rdsz;
+	}
+	return true;
+}
+
+static bool reserve(uint8_t** pbuf, size_t* psize, size_t need){
+	uint8_t* buf;
+	size_t size = *psize ? *psize : 4096;
+
+	if( *psize >= need )
+		return true;
+	while( size < need )
+		size *= 2;
+	buf = (uint8_t*)realloc(*pbuf, size);
+	if( buf == NULL )
+		return false;
+	*pbuf = buf;
+	*psize = size;
+	return true;
+}
+
+static bool alloc_block(struct dio_col_block* pblk){
+	memset(pblk, 0, sizeof(struct dio_col_block));
+	pblk->bits = (struct blk_io_trace*)malloc(sizeof(struct blk_io_trace) * DIO_COL_BLOCK_BITS);
+	pblk->pdu_off = (uint32_t*)malloc(sizeof(uint32_t) * DIO_COL_BLOCK_BITS);
+	return pblk->bits != NULL && pblk->pdu_off != NULL;
+}
+
+static void free_pidlists(struct dio_hash* ph){
+	struct dio_col_pidlist* pl;
+	unsigned int i;
+
+	if( ph->tbl == NULL )
+		return;
+	for(i=0; i<ph->size; i++){
+		pl = (struct dio_col_pidlist*)ph->tbl[i].val;
+		if( pl != NULL ){
+			free(pl->blocks);
+			free(pl);
+		}
+	}
+	dio_hash_destroy(ph);
+}
+
+/*--------------	writer	------------------*/
+bool dio_col_writer_open(struct dio_col_writer* pw, const char* path){
+	memset(pw, 0, sizeof(struct dio_col_writer));
+
+	pw->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if( pw->fd < 0 )
+		return false;
+	if( !alloc_block(&pw->blk) || !dio_hash_init(&pw->pids, INIT_PID_INDEX_SIZE) ||
+		!write_all(pw->fd, DIO_COL_MAGIC, DIO_COL_MAGIC_LEN) ){
+		close(pw->fd);
+		free(pw->blk.bits);
+		free(pw->blk.pdu_off);
+		dio_hash_destroy(&pw->pids);
+		return false;
+	}
+	pw->offset = DIO_COL_MAGIC_LEN;
+	return true;
+}
+
+static bool add_pid_block(struct dio_col_writer* pw, uint32_t pid, uint32_t blkidx){
+	struct dio_col_pidlist* pl;
+	uint32_t* blocks;
+
+	pl = (struct dio_col_pidlist*)dio_hash_lookup(&pw->pids, pid);
+	if( pl == NULL ){
+		pl = (struct dio_col_pidlist*)calloc(1, sizeof(struct dio_col_pidlist));
+		if( pl == NULL || !dio_hash_insert(&pw->pids, pid, pl) ){
+			free(pl);
+			return false;
+		}
+	}
+	if( pl->cnt > 0 && pl->blocks[pl->cnt-1] == blkidx )
+		return true;
+
+	if( pl->cnt == pl->size ){
+		blocks = (uint32_t*)realloc(pl->blocks, sizeof(uint32_t) * (pl->size ? pl->size * 2 : 16));
+		if( blocks == NULL )
+			return false;
+		pl->blocks = blocks;
+		pl->size = pl->size ? pl->size * 2 : 16;
+	}
+	pl->blocks[pl->cnt++] = blkidx;
+	return true;
+}
+
+static bool flush_block(struct dio_col_writer* pw){
+	struct dio_col_block* pblk = &pw->blk;
+	struct dio_col_meta* pmeta;
+	struct dio_col_meta* metas;
+	struct blk_io_trace* pbit;
+	uint8_t* p;
+	uint8_t* colp;
+	uint64_t prev;
+	uint32_t i;
+	int col;
+
+	if( pblk->nr_bits == 0 )
+		return true;
+
+	if( pw->nr_blocks == pw->metas_size ){
+		metas = (struct dio_col_meta*)realloc(pw->metas,
+			sizeof(struct dio_col_meta) * (pw->metas_size ? pw->metas_size * 2 : 256));
+		if( metas == NULL )
+			return false;
+		pw->metas = metas;
+		pw->metas_size = pw->metas_size ? pw->metas_size * 2 : 256;
+	}
+	pmeta = &pw->metas[pw->nr_blocks];
+	memset(pmeta, 0, sizeof(struct dio_col_meta));
+	pmeta->offset = pw->offset;
+	pmeta->nr_bits = pblk->nr_bits;
+	pmeta->zone.min_time = pmeta->zone.min_sector = (uint64_t)(-1);
+	pmeta->zone.min_pid = (uint32_t)(-1);
+
+	if( !reserve(&pw->enc, &pw->enc_size,
+		(size_t)pblk->nr_bits * DIO_COL_NR * DIO_COL_MAX_VARINT + pblk->pdu_len) )
+		return false;
+
+	p = pw->enc;
+	for(col=0; col<DIO_COL_NR; col++){
+		colp = p;
+		prev = 0;
+		for(i=0; i<pblk->nr_bits; i++){
+			pbit = &pblk->bits[i];
+			switch(col){
+			case DIO_COL_MAGIC_NR:
+				p = put_varint(p, zigzag(pbit->magic, prev));
+				prev = pbit->magic;
+				break;
+			case DIO_COL_SEQUENCE:
+				p = put_varint(p, zigzag(pbit->sequence, prev));
+				prev = pbit->sequence;
+				break;
+			case DIO_COL_TIME:
+				p = put_varint(p, zigzag(pbit->time, prev));
+				prev = pbit->time;
+				break;
+			case DIO_COL_SECTOR:
+				p = put_varint(p, zigzag(pbit->sector, prev));
+				prev = pbit->sector;
+				break;
+			case DIO_COL_BYTES:
+				p = put_varint(p, pbit->bytes);
+				break;
+			case DIO_COL_ACTION:
+				p = put_varint(p, pbit->action);
+				break;
+			case DIO_COL_PID:
+				p = put_varint(p, pbit->pid);
+				break;
+			case DIO_COL_DEVICE:
+				p = put_varint(p, pbit->device);
+				break;
+			case DIO_COL_CPU:
+				p = put_varint(p, pbit->cpu);
+				break;
+			case DIO_COL_ERROR:
+				p = put_varint(p, pbit->error);
+				break;
+			case DIO_COL_PDU:
+				p = put_varint(p, pbit->pdu_len);
+				memcpy(p, pblk->pdu + pblk->pdu_off[i], pbit->pdu_len);
+				p += pbit->pdu_len;
+				break;
+			}
+		}
+		pmeta->col_len[col] = (uint32_t)(p - colp);
+	}
+
+	for(i=0; i<pblk->nr_bits; i++){
+		pbit = &pblk->bits[i];
+		if( pmeta->zone.min_time > pbit->time )
+			pmeta->zone.min_time = pbit->time;
+		if( pmeta->zone.max_time < pbit->time )
+			pmeta->zone.max_time = pbit->time;
+		if( pmeta->zone.min_sector > pbit->sector )
+			pmeta->zone.min_sector = pbit->sector;
+		if( pmeta->zone.max_sector < pbit->sector )
+			pmeta->zone.max_sector = pbit->sector;
+		if( pmeta->zone.min_pid > pbit->pid )
+			pmeta->zone.min_pid = pbit->pid;
+		if( pmeta->zone.max_pid < pbit->pid )
+			pmeta->zone.max_pid = pbit->pid;
+		if( pbit->action == BLK_TN_PROCESS )
+			pmeta->zone.has_process = true;
+		if( !add_pid_block(pw, pbit->pid, pw->nr_blocks) )
+			return false;
+	}
+
+	if( !write_all(pw->fd, pw->enc, p - pw->enc) )
+		return false;
+	pw->offset += p - pw->enc;
+	pw->nr_blocks++;
+	pblk->nr_bits = 0;
+	pblk->pdu_len = 0;
+	return true;
+}
+
+bool dio_col_writer_add(struct dio_col_writer* pw, const struct blk_io_trace* pbit, const void* pdu){
+	struct dio_col_block* pblk = &pw->blk;
+	uint8_t* buf = (uint8_t*)pblk->pdu;
+	size_t size = pblk->pdu_size;
+
+	if( !reserve(&buf, &size, (size_t)pblk->pdu_len + pbit->pdu_len) )
+		return false;
+	pblk->pdu = (char*)buf;
+	pblk->pdu_size = (uint32_t)size;
+
+	pblk->bits[pblk->nr_bits] = *pbit;
+	pblk->pdu_off[pblk->nr_bits] = pblk->pdu_len;
+	memcpy(pblk->pdu + pblk->pdu_len, pdu, pbit->pdu_len);
+	pblk->pdu_len += pbit->pdu_len;
+
+	if( ++pblk->nr_bits == DIO_COL_BLOCK_BITS )
+		return flush_block(pw);
+	return true;
+}
+
+static bool write_footer(struct dio_col_writer* pw){
+	struct dio_col_meta* pmeta;
+	struct dio_col_pidlist* pl;
+	size_t need;
+	uint8_t* p;
+	uint8_t trailer[DIO_COL_TRAILER_LEN];
+	uint32_t i, j, prev;
+	int col;
+
+	need = DIO_COL_MAX_VARINT * (2 + (size_t)pw->nr_blocks * (DIO_COL_NR + 9));
+	for(i=0; i<pw->pids.size; i++){
+		pl = (struct dio_col_pidlist*)pw->pids.tbl[i].val;
+		if( pl != NULL )
+			need += DIO_COL_MAX_VARINT * (2 + (size_t)pl->cnt);
+	}
+	if( !reserve(&pw->enc, &pw->enc_size, need) )
+		return false;
+
+	p = pw->enc;
+	p = put_varint(p, pw->nr_blocks);
+	for(i=0; i<pw->nr_blocks; i++){
+		pmeta = &pw->metas[i];
+		p = put_varint(p, pmeta->offset);
+		p = put_varint(p, pmeta->nr_bits);
+		for(col=0; col<DIO_COL_NR; col++)
+			p = put_varint(p, pmeta->col_len[col]);
+		p = put_varint(p, pmeta->zone.min_time);
+		p = put_varint(p, pmeta->zone.max_time - pmeta->zone.min_time);
+		p = put_varint(p, pmeta->zone.min_sector);
+		p = put_varint(p, pmeta->zone.max_sector - pmeta->zone.min_sector);
+		p = put_varint(p, pmeta->zone.min_pid);
+		p = put_varint(p, pmeta->zone.max_pid - pmeta->zone.min_pid);
+		p = put_varint(p, pmeta->zone.has_process);
+	}
+
+	p = put_varint(p, pw->pids.cnt);
+	for(i=0; i<pw->pids.size; i++){
+		pl = (struct dio_col_pidlist*)pw->pids.tbl[i].val;
+		if( pl == NULL )
+			continue;
+		p = put_varint(p, pw->pids.tbl[i].key);
+		p = put_varint(p, pl->cnt);
+		for(j=0, prev=0; j<pl->cnt; j++){
+			p = put_varint(p, pl->blocks[j] - prev);
+			prev = pl->blocks[j];
+		}
+	}
+
+	for(i=0; i<8; i++)
+		trailer[i] = (uint8_t)(pw->offset >> (i * 8));
+	memcpy(trailer + 8, DIO_COL_MAGIC, DIO_COL_MAGIC_LEN);
+
+	return write_all(pw->fd, pw->enc, p - pw->enc) &&
+		write_all(pw->fd, trailer, DIO_COL_TRAILER_LEN);
+}
+
+bool dio_col_writer_close(struct dio_col_writer* pw){
+	bool ret;
+
+	ret = flush_block(pw) && write_footer(pw);
+	if( close(pw->fd) < 0 )
+		ret = false;
+	pw->fd = -1;
+
+	free(pw->blk.bits);
+	free(pw->blk.pdu_off);
+	free(pw->blk.pdu);
+	free(pw->metas);
+	free(pw->enc);
+	free_pidlists(&pw->pids);
+	return ret;
+}
+
+/*--------------	reader	------------------*/
+bool dio_col_probe(int fd){
+	char magic[DIO_COL_MAGIC_LEN];
+
+	if( pread(fd, magic, DIO_COL_MAGIC_LEN, 0) != DIO_COL_MAGIC_LEN )
+		return false;
+	return memcmp(magic, DIO_COL_MAGIC, DIO_COL_MAGIC_LEN) == 0;
+}
+
+static bool read_footer(struct dio_col_reader* pr, const uint8_t* p, const uint8_t* end){
+	struct dio_col_meta* pmeta;
+	struct dio_col_pidlist* pl;
+	uint64_t v[8];
+	uint64_t nr_pids, i, j;
+	int col;
+
+#define GET(x)	do{ if( (p = get_varint(p, end, &(x))) == NULL ) return false; }while(0)
+	GET(v[0]);
+	pr->nr_blocks = (uint32_t)v[0];
+	pr->metas = (struct dio_col_meta*)calloc(pr->nr_blocks + 1, sizeof(struct dio_col_meta));
+	if( pr->metas == NULL )
+		return false;
+
+	for(i=0; i<pr->nr_blocks; i++){
+		pmeta = &pr->metas[i];
+		GET(pmeta->offset);
+		GET(v[0]);
+		if( v[0] > DIO_COL_BLOCK_BITS )
+			return false;
+		pmeta->nr_bits = (uint32_t)v[0];
+		for(col=0; col<DIO_COL_NR; col++){
+			GET(v[0]);
+			pmeta->col_len[col] = (uint32_t)v[0];
+		}
+		for(j=0; j<7; j++)
+			GET(v[j]);
+		pmeta->zone.min_time = v[0];
+		pmeta->zone.max_time = v[0] + v[1];
+		pmeta->zone.min_sector = v[2];
+		pmeta->zone.max_sector = v[2] + v[3];
+		pmeta->zone.min_pid = (uint32_t)v[4];
+		pmeta->zone.max_pid = (uint32_t)(v[4] + v[5]);
+		pmeta->zone.has_process = v[6] != 0;
+	}
+
+	GET(nr_pids);
+	for(i=0; i<nr_pids; i++){
+		GET(v[0]);
+		GET(v[1]);
+		if( v[1] > pr->nr_blocks )
+			return false;
+		pl = (struct dio_col_pidlist*)calloc(1, sizeof(struct dio_col_pidlist));
+		if( pl == NULL )
+			return false;
+		pl->blocks = (uint32_t*)malloc(sizeof(uint32_t) * (v[1] + 1));
+		if( pl->blocks == NULL || !dio_hash_insert(&pr->pids, v[0], pl) ){
+			free(pl->blocks);
+			free(pl);
+			return false;
+		}
+		pl->cnt = pl->size = (uint32_t)v[1];
+		for(j=0, v[2]=0; j<pl->cnt; j++){
+			GET(v[3]);
+			v[2] += v[3];
+			pl->blocks[j] = (uint32_t)v[2];
+		}
+	}
+#undef GET
+	return true;
+}
+
+bool dio_col_reader_open(struct dio_col_reader* pr, int fd){
+	struct stat st;
+	uint8_t trailer[DIO_COL_TRAILER_LEN];
+	uint8_t* footer = NULL;
+	uint64_t footer_off = 0;
+	int i;
+
+	memset(pr, 0, sizeof(struct dio_col_reader));
+	pr->fd = fd;
+
+	if( fstat(fd, &st) < 0 )
+		return false;
+	if( st.st_size < DIO_COL_MAGIC_LEN + DIO_COL_TRAILER_LEN ||
+		!pread_all(fd, trailer, DIO_COL_TRAILER_LEN, st.st_size - DIO_COL_TRAILER_LEN) ||
+		memcmp(trailer + 8, DIO_COL_MAGIC, DIO_COL_MAGIC_LEN) != 0 ){
+		errno = EINVAL;
+		return false;
+	}
+	for(i=0; i<8; i++)
+		footer_off |= (uint64_t)trailer[i] << (i * 8);
+	if( footer_off < DIO_COL_MAGIC_LEN || footer_off > (uint64_t)st.st_size - DIO_COL_TRAILER_LEN ){
+		errno = EINVAL;
+		return false;
+	}
+
+	footer = (uint8_t*)malloc(st.st_size - DIO_COL_TRAILER_LEN - footer_off + 1);
+	if( footer == NULL || !dio_hash_init(&pr->pids, INIT_PID_INDEX_SIZE) || !alloc_block(&pr->blk) ){
+		free(footer);
+		return false;
+	}
+	if( !pread_all(fd, footer, st.st_size - DIO_COL_TRAILER_LEN - footer_off, footer_off) ){
+		free(footer);
+		return false;
+	}
+	if( !read_footer(pr, footer, footer + (st.st_size - DIO_COL_TRAILER_LEN - footer_off)) ){
+		free(footer);
+		errno = EINVAL;
+		return false;
+	}
+	free(footer);
+	return true;
+}
+
+void dio_col_reader_close(struct dio_col_reader* pr){
+	if( pr->fd >= 0 )
+		close(pr->fd);
+	pr->fd = -1;
+	free(pr->metas);
+	free(pr->blk.bits);
+	free(pr->blk.pdu_off);
+	free(pr->raw);
+	free_pidlists(&pr->pids);
+	pr->metas = NULL;
+	pr->blk.bits = NULL;
+	pr->blk.pdu_off = NULL;
+	pr->raw = NULL;
+}
+
+void dio_col_reader_set_filter(struct dio_col_reader* pr, const struct dio_col_filter* pfilter){
+	pr->filter = *pfilter;
+	pr->has_filter = true;
+	pr->pid_pos = 0;
+}
+
+// is the block of 'idx' possibly matched with the filter?
+static bool block_wanted(struct dio_col_reader* pr, uint32_t idx){
+	struct dio_col_zone* pz = &pr->metas[idx].zone;
+	struct dio_col_filter* pf = &pr->filter;
+	struct dio_col_pidlist* pl;
+
+	//process names are needed for all pids and times
+	if( !pr->has_filter || pz->has_process )
+		return true;
+
+	if( pz->max_time < pf->time_start || pz->min_time > pf->time_end )
+		return false;
+	if( pz->max_sector < pf->sector_start || pz->min_sector > pf->sector_end )
+		return false;
+	if( pf->pid == (uint64_t)(-1) )
+		return true;
+	if( pf->pid < pz->min_pid || pf->pid > pz->max_pid )
+		return false;
+
+	pl = (struct dio_col_pidlist*)dio_hash_lookup(&pr->pids, pf->pid);
+	if( pl == NULL )
+		return false;
+	while( pr->pid_pos < pl->cnt && pl->blocks[pr->pid_pos] < idx )
+		pr->pid_pos++;
+	return pr->pid_pos < pl->cnt && pl->blocks[pr->pid_pos] == idx;
+}
+
+static bool load_block(struct dio_col_reader* pr, uint32_t idx){
+	struct dio_col_meta* pmeta = &pr->metas[idx];
+	struct dio_col_block* pblk = &pr->blk;
+	struct blk_io_trace* pbit;
+	const uint8_t* p;
+	const uint8_t* end;
+	uint64_t len = 0;
+	uint64_t v, prev;
+	uint32_t i;
+	int col;
+
+	for(col=0; col<DIO_COL_NR; col++)
+		len += pmeta->col_len[col];
+	if( !reserve(&pr->raw, &pr->raw_size, len) ||
+		!pread_all(pr->fd, pr->raw, len, pmeta->offset) )
+		return false;
+
+	memset(pblk->bits, 0, sizeof(struct blk_io_trace) * pmeta->nr_bits);
+	p = pr->raw;
+	for(col=0; col<DIO_COL_NR; col++){
+		end = p + pmeta->col_len[col];
+		prev = 0;
+		for(i=0; i<pmeta->nr_bits; i++){
+			pbit = &pblk->bits[i];
+			if( (p = get_varint(p, end, &v)) == NULL )
+				goto corrupted;
+			switch(col){
+			case DIO_COL_MAGIC_NR:
+				pbit->magic = (__u32)(prev = unzigzag(v, prev));
+				break;
+			case DIO_COL_SEQUENCE:
+				pbit->sequence = (__u32)(prev = unzigzag(v, prev));
+				break;
+			case DIO_COL_TIME:
+				pbit->time = prev = unzigzag(v, prev);
+				break;
+			case DIO_COL_SECTOR:
+				pbit->sector = prev = unzigzag(v, prev);
+				break;
+			case DIO_COL_BYTES:
+				pbit->bytes = (__u32)v;
+				break;
+			case DIO_COL_ACTION:
+				pbit->action = (__u32)v;
+				break;
+			case DIO_COL_PID:
+				pbit->pid = (__u32)v;
+				break;
+			case DIO_COL_DEVICE:
+				pbit->device = (__u32)v;
+				break;
+			case DIO_COL_CPU:
+				pbit->cpu = (__u32)v;
+				break;
+			case DIO_COL_ERROR:
+				pbit->error = (__u16)v;
+				break;
+			case DIO_COL_PDU:
+				if( v > (uint64_t)(end - p) )
+					goto corrupted;
+				pbit->pdu_len = (__u16)v;
+				pblk->pdu_off[i] = (uint32_t)(p - pr->raw);
+				p += v;
+				break;
+			}
+		}
+		if( p != end )
+			goto corrupted;
+	}
+
+	pblk->pdu = (char*)pr->raw;
+	pblk->nr_bits = pmeta->nr_bits;
+	pr->pos = 0;
+	return true;
+
+corrupted:
+	errno = EINVAL;
+	return false;
+}
+
+int dio_col_reader_next(struct dio_col_reader* pr, struct blk_io_trace* pbit, void* pdu, int pdusz){
+	struct dio_col_block* pblk = &pr->blk;
+
+	while( pr->pos >= pblk->nr_bits ){
+		while( pr->next_block < pr->nr_blocks && !block_wanted(pr, pr->next_block) ){
+			pr->next_block++;
+			pr->nr_skipped++;
+		}
+		if( pr->next_block >= pr->nr_blocks )
+			return 0;
+		if( !load_block(pr, pr->next_block++) )
+			return -1;
+	}
+
+	*pbit = pblk->bits[pr->pos];
+	if( pdu != NULL ){
+		memset(pdu, 0, pdusz);
+		if( pdusz > pbit->pdu_len )
+			pdusz = pbit->pdu_len;
+		memcpy(pdu, pblk->pdu + pblk->pdu_off[pr->pos], pdusz);
+	}
+	pr->pos++;
+	return 1;
+}
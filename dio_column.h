@@ -0,0 +1,138 @@
+/*
+	dio_column.h
+	Columnar trace format of dioparse.
+
+	The bits are stored on blocks of DIO_COL_BLOCK_BITS bits, and each
+	field of bits is stored as a column of the block. Columns are encoded
+	with varint, and time, sector and the other increasing fields are
+	encoded as the zigzag delta from the previous bit.
+	The footer has the zone map (min/max of time, sector and pid) of each
+	block and the inverted index of pid to blocks, so the reader can skip
+	the blocks which are never matched with the filter.
+
+	file layout
+		header	: DIO_COL_MAGIC
+		blocks	: columns of block 0, block 1, ...
+		footer	: block metas and pid index (varint)
+		trailer	: file offset of footer (8 bytes, little endian), DIO_COL_MAGIC
+*/
+
+#ifndef DIO_COLUMN_H
+#define DIO_COLUMN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "blktrace_api.h"
+#include "dio_index.h"
+
+#define DIO_COL_MAGIC		"DIOCOL01"
+#define DIO_COL_MAGIC_LEN	8
+#define DIO_COL_BLOCK_BITS	16384
+
+// columns of block in order
+enum{
+	DIO_COL_MAGIC_NR = 0,
+	DIO_COL_SEQUENCE,
+	DIO_COL_TIME,
+	DIO_COL_SECTOR,
+	DIO_COL_BYTES,
+	DIO_COL_ACTION,
+	DIO_COL_PID,
+	DIO_COL_DEVICE,
+	DIO_COL_CPU,
+	DIO_COL_ERROR,
+	DIO_COL_PDU,		//pdu_len and pdu data
+	DIO_COL_NR
+};
+
+// zone map of block
+struct dio_col_zone{
+	uint64_t min_time;
+	uint64_t max_time;
+	uint64_t min_sector;
+	uint64_t max_sector;
+	uint32_t min_pid;
+	uint32_t max_pid;
+	bool has_process;	//has process notify bit. it is never skipped
+};
+
+struct dio_col_meta{
+	uint64_t offset;	//file offset of block
+	uint32_t nr_bits;
+	uint32_t col_len[DIO_COL_NR];
+	struct dio_col_zone zone;
+};
+
+// bits which are read by filter should be matched with it, but the bits
+// which aren't matched can be read too (block is the unit of skipping)
+struct dio_col_filter{
+	uint64_t time_start;
+	uint64_t time_end;
+	uint64_t sector_start;
+	uint64_t sector_end;
+	uint64_t pid;		//(uint64_t)(-1) means all pids
+};
+
+// bits of a block and the pdu data of them
+struct dio_col_block{
+	struct blk_io_trace* bits;
+	uint32_t* pdu_off;	//offset of pdu of bits[i] in pdu
+	char* pdu;
+	uint32_t nr_bits;
+	uint32_t pdu_len;
+	uint32_t pdu_size;
+};
+
+/*--------------	writer	------------------*/
+struct dio_col_writer{
+	int fd;
+	uint64_t offset;		//file offset of next block
+	struct dio_col_block blk;	//bits of current block
+	struct dio_col_meta* metas;
+	uint32_t nr_blocks;
+	uint32_t metas_size;
+	struct dio_hash pids;		//struct dio_col_pidlist by pid
+	uint8_t* enc;			//encoding buffer
+	size_t enc_size;
+};
+
+bool dio_col_writer_open(struct dio_col_writer* pw, const char* path);
+
+// add a bit and its pdu (pdu_len bytes)
+bool dio_col_writer_add(struct dio_col_writer* pw, const struct blk_io_trace* pbit, const void* pdu);
+
+// write the remained bits and footer, and close the file
+bool dio_col_writer_close(struct dio_col_writer* pw);
+
+/*--------------	reader	------------------*/
+struct dio_col_reader{
+	int fd;
+	struct dio_col_meta* metas;
+	uint32_t nr_blocks;
+	struct dio_hash pids;		//struct dio_col_pidlist by pid
+	struct dio_col_filter filter;
+	bool has_filter;
+
+	uint32_t next_block;		//index of block to be read
+	uint32_t pid_pos;		//position on block list of filter pid
+	struct dio_col_block blk;	//bits of block being read
+	uint32_t pos;			//position of next bit in blk
+	uint8_t* raw;			//encoded block
+	size_t raw_size;
+	uint32_t nr_skipped;		//count of skipped blocks
+};
+
+// return true if the file of fd is columnar format
+bool dio_col_probe(int fd);
+
+// open the reader on columnar file. fd is owned by reader after that
+bool dio_col_reader_open(struct dio_col_reader* pr, int fd);
+void dio_col_reader_close(struct dio_col_reader* pr);
+
+// skip the blocks which can't be matched with the filter from now on
+void dio_col_reader_set_filter(struct dio_col_reader* pr, const struct dio_col_filter* pfilter);
+
+// same as dio_reader_next()
+int dio_col_reader_next(struct dio_col_reader* pr, struct blk_io_trace* pbit, void* pdu, int pdusz);
+
+#endif
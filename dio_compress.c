@@ -0,0 +1,132 @@
+/*
+	dio_compress.c
+	Compressed input of dioparse.
+
+	This source is free on GNU General Public License.
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "dio_compress.h"
+
+#define COMP_MAGIC_LEN	4
+
+// decompressors of each format in order of preference.
+// they decompress stdin to stdout
+static const char* const gzip_cmds[][3] = {
+	{ "pigz", "-dc", NULL },
+	{ "gzip", "-dc", NULL },
+	{ NULL }
+};
+static const char* const zstd_cmds[][3] = {
+	{ "pzstd", "-dc", NULL },
+	{ "zstd", "-dc", NULL },
+	{ NULL }
+};
+static const char* const lz4_cmds[][3] = {
+	{ "lz4", "-dc", NULL },
+	{ NULL }
+};
+
+int dio_comp_probe(int fd){
+	unsigned char magic[COMP_MAGIC_LEN];
+	uint32_t le;
+
+	if( pread(fd, magic, COMP_MAGIC_LEN, 0) != COMP_MAGIC_LEN )
+		return DIO_COMP_NONE;
+	le = magic[0] | magic[1] << 8 | magic[2] << 16 | (uint32_t)magic[3] << 24;
+
+	if( magic[0] == 0x1F && magic[1] == 0x8B )
+		return DIO_COMP_GZIP;
+	//zstd frame, or skippable frame which pzstd writes at first
+	if( le == 0xFD2FB528 || (le & 0xFFFFFFF0) == 0x184D2A50 )
+		return DIO_COMP_ZSTD;
+	//lz4 frame and legacy frame
+	if( le == 0x184D2204 || le == 0x184C2102 )
+		return DIO_COMP_LZ4;
+	return DIO_COMP_NONE;
+}
+
+bool dio_decomp_open(struct dio_decomp* pdc, int fd, int type){
+	const char* const (*cmds)[3];
+	int pipefd[2];
+	int i;
+
+	memset(pdc, 0, sizeof(struct dio_decomp));
+	pdc->fd = -1;
+	switch( type ){
+	case DIO_COMP_GZIP:
+		cmds = gzip_cmds;
+		break;
+	case DIO_COMP_ZSTD:
+		cmds = zstd_cmds;
+		break;
+	case DIO_COMP_LZ4:
+		cmds = lz4_cmds;
+		break;
+	default:
+		return false;
+	}
+
+	if( lseek(fd, 0, SEEK_SET) < 0 || pipe(pipefd) < 0 )
+		return false;
+
+	pdc->pid = fork();
+	if( pdc->pid < 0 ){
+		close(pipefd[0]);
+		close(pipefd[1]);
+		return false;
+	}
+
+	if( pdc->pid == 0 ){
+		//decompressor process
+		signal(SIGINT, SIG_IGN);	//follow mode stops with SIGINT
+		if( dup2(fd, STDIN_FILENO) < 0 || dup2(pipefd[1], STDOUT_FILENO) < 0 )
+			_exit(127);
+		close(pipefd[0]);
+		close(pipefd[1]);
+		for(i=0; cmds[i][0] != NULL; i++)
+			execvp(cmds[i][0], (char* const*)cmds[i]);
+
+		//the reader gets only the end of data, so the reason is told here
+		fprintf(stderr, "no decompressor is found on PATH (");
+		for(i=0; cmds[i][0] != NULL; i++)
+			fprintf(stderr, "%s%s", i ? ", " : "", cmds[i][0]);
+		fprintf(stderr, ")\n");
+		_exit(127);
+	}
+
+	close(pipefd[1]);
+	pdc->type = type;
+	pdc->fd = pipefd[0];
+	return true;
+}
+
+bool dio_decomp_close(struct dio_decomp* pdc){
+	int status;
+
+	if( pdc->fd >= 0 )
+		close(pdc->fd);
+	pdc->fd = -1;
+	if( pdc->pid <= 0 )
+		return true;
+
+	while( waitpid(pdc->pid, &status, 0) < 0 ){
+		if( errno != EINTR )
+			return false;
+	}
+	pdc->pid = 0;
+
+	//the reader can stop before the end of data
+	if( WIFSIGNALED(status) && WTERMSIG(status) == SIGPIPE )
+		return true;
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
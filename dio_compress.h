@@ -0,0 +1,46 @@
+/*
+	dio_compress.h
+	Compressed input of dioparse.
+
+	The compression format of input file is detected from its magic bytes.
+	The file is decompressed by the decompressor process (gzip, zstd or lz4)
+	and its output is read through a pipe, so the bits are decoded while
+	the file is being decompressed, without a temporary file.
+	The parallel decompressors (pigz, pzstd) are preferred if installed.
+	pzstd decompresses the independently framed blocks of the files written
+	by pzstd on several threads. The other files are decompressed on one
+	thread, pigz decompresses only a little faster than gzip.
+	If no decompressor is found, the decompressor process tells it on stderr.
+*/
+
+#ifndef DIO_COMPRESS_H
+#define DIO_COMPRESS_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+// compression formats
+#define DIO_COMP_NONE	0
+#define DIO_COMP_GZIP	1
+#define DIO_COMP_ZSTD	2
+#define DIO_COMP_LZ4	3
+
+struct dio_decomp{
+	int type;	//DIO_COMP_*
+	pid_t pid;	//decompressor process
+	int fd;		//read end of pipe
+};
+
+// return the compression format of file
+int dio_comp_probe(int fd);
+
+// start the decompressor of 'type' which reads fd from its start.
+// fd is not owned by pdc, it can be closed after that.
+// the decompressed data can be read from pdc->fd
+bool dio_decomp_open(struct dio_decomp* pdc, int fd, int type);
+
+// close the pipe and wait for the decompressor.
+// return false if the decompressor failed
+bool dio_decomp_close(struct dio_decomp* pdc);
+
+#endif
@@ -0,0 +1,214 @@
+/*
+	dio_decode.c
+	Batch decoding of the raw bits of dioparse.
+
+	This source is free on GNU General Public License.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "dio_decode.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DIO_DECODE_SSSE3
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define BIT_SIZE	sizeof(struct blk_io_trace)
+
+static inline bool magic_valid(uint32_t magic){
+	return (magic & 0xFFFFFF00) == BLK_IO_TRACE_MAGIC &&
+		(magic & 0xFF) == BLK_IO_TRACE_VERSION;
+}
+
+int dio_decode_order(const struct blk_io_trace* pbit){
+	if( magic_valid(pbit->magic) )
+		return DIO_ORDER_NATIVE;
+	if( magic_valid(__builtin_bswap32(pbit->magic)) )
+		return DIO_ORDER_SWAPPED;
+	return DIO_ORDER_UNKNOWN;
+}
+
+static inline bool header_valid(uint32_t magic, uint32_t cpu, uint16_t pdu_len){
+	return magic_valid(magic) && cpu < DIO_DECODE_MAX_CPU && pdu_len <= DIO_DECODE_MAX_PDU;
+}
+
+bool dio_decode_valid(const struct blk_io_trace* pbit){
+	return header_valid(pbit->magic, pbit->cpu, pbit->pdu_len);
+}
+
+void dio_decode_swap(struct blk_io_trace* pbit){
+	pbit->magic	= __builtin_bswap32(pbit->magic);
+	pbit->sequence	= __builtin_bswap32(pbit->sequence);
+	pbit->time	= __builtin_bswap64(pbit->time);
+	pbit->sector	= __builtin_bswap64(pbit->sector);
+	pbit->bytes	= __builtin_bswap32(pbit->bytes);
+	pbit->action	= __builtin_bswap32(pbit->action);
+	pbit->pid	= __builtin_bswap32(pbit->pid);
+	pbit->device	= __builtin_bswap32(pbit->device);
+	pbit->cpu	= __builtin_bswap32(pbit->cpu);
+	pbit->error	= __builtin_bswap16(pbit->error);
+	pbit->pdu_len	= __builtin_bswap16(pbit->pdu_len);
+}
+
+// return the length of the bit at p if it is complete and valid, or 0.
+// the bit is not changed, so it can be decoded again when it's completed
+static inline size_t decode_peek(const char* p, size_t len, bool swap, bool* invalid){
+	uint32_t magic, cpu;
+	uint16_t pdu_len;
+
+	if( len < BIT_SIZE )
+		return 0;
+
+	//bits can be on any offset of buffer
+	memcpy(&magic, p + offsetof(struct blk_io_trace, magic), sizeof(magic));
+	memcpy(&cpu, p + offsetof(struct blk_io_trace, cpu), sizeof(cpu));
+	memcpy(&pdu_len, p + offsetof(struct blk_io_trace, pdu_len), sizeof(pdu_len));
+	if( swap ){
+		magic = __builtin_bswap32(magic);
+		cpu = __builtin_bswap32(cpu);
+		pdu_len = __builtin_bswap16(pdu_len);
+	}
+	if( !header_valid(magic, cpu, pdu_len) ){
+		*invalid = true;
+		return 0;
+	}
+	if( len < BIT_SIZE + pdu_len )
+		return 0;
+	return BIT_SIZE + pdu_len;
+}
+
+static size_t decode_bits_scalar(char* buf, size_t len, bool swap, bool* invalid){
+	struct blk_io_trace bit;
+	size_t pos = 0, reclen;
+
+	while( (reclen = decode_peek(buf + pos, len - pos, swap, invalid)) > 0 ){
+		if( swap ){
+			memcpy(&bit, buf + pos, BIT_SIZE);
+			dio_decode_swap(&bit);
+			memcpy(buf + pos, &bit, BIT_SIZE);
+		}
+		pos += reclen;
+	}
+	return pos;
+}
+
+#ifdef DIO_DECODE_SSSE3
+// a header is 3 lanes of 16 bytes, and each lane has its own shuffle.
+//	lane 0 : magic(4) sequence(4) time(8)
+//	lane 1 : sector(8) bytes(4) action(4)
+//	lane 2 : pid(4) device(4) cpu(4) error(2) pdu_len(2)
+__attribute__((target("ssse3")))
+static size_t decode_bits_ssse3(char* buf, size_t len, bool swap, bool* invalid){
+	const __m128i shuf0 = _mm_setr_epi8(3,2,1,0, 7,6,5,4, 15,14,13,12,11,10,9,8);
+	const __m128i shuf1 = _mm_setr_epi8(7,6,5,4,3,2,1,0, 11,10,9,8, 15,14,13,12);
+	const __m128i shuf2 = _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 13,12, 15,14);
+	__m128i* p;
+	size_t pos = 0, reclen;
+
+	if( !swap )
+		return decode_bits_scalar(buf, len, false, invalid);
+
+	while( (reclen = decode_peek(buf + pos, len - pos, true, invalid)) > 0 ){
+		p = (__m128i*)(buf + pos);
+		_mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), shuf0));
+		_mm_storeu_si128(p + 1, _mm_shuffle_epi8(_mm_loadu_si128(p + 1), shuf1));
+		_mm_storeu_si128(p + 2, _mm_shuffle_epi8(_mm_loadu_si128(p + 2), shuf2));
+		pos += reclen;
+	}
+	return pos;
+}
+#endif
+
+typedef size_t(*decode_bits_func)(char*, size_t, bool, bool*);
+
+// the implementation is chosen at the first call
+static decode_bits_func select_decode_bits(void){
+#ifdef DIO_DECODE_SSSE3
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports("ssse3") )
+		return decode_bits_ssse3;
+#endif
+	return decode_bits_scalar;
+}
+
+size_t dio_decode_bits(char* buf, size_t len, bool swap, bool* invalid){
+	static decode_bits_func decode = NULL;
+
+	if( decode == NULL )
+		decode = select_decode_bits();
+	*invalid = false;
+	return decode(buf, len, swap, invalid);
+}
+
+// is there a valid bit at p, and is the bit after it valid too?
+static bool scan_check(const char* p, size_t len, bool swap){
+	bool invalid = false;
+	size_t reclen;
+
+	reclen = decode_peek(p, len, swap, &invalid);
+	if( reclen == 0 ){
+		//the bit is valid but its pdu is not on buf
+		return !invalid && len >= BIT_SIZE;
+	}
+	invalid = false;
+	decode_peek(p + reclen, len - reclen, swap, &invalid);
+	return !invalid;
+}
+
+size_t dio_decode_scan(const char* buf, size_t len, bool swap){
+	uint32_t magic = BLK_IO_TRACE_MAGIC | BLK_IO_TRACE_VERSION;
+	unsigned char pat[4];
+	size_t pos = 0;
+	const char* p;
+
+	//the magic as it is on file
+	if( swap )
+		magic = __builtin_bswap32(magic);
+	memcpy(pat, &magic, sizeof(pat));
+
+#ifdef __SSE2__
+	//compare 16 positions at once. a position matches if 4 bytes from it
+	//are the magic, so the 4 loads are shifted by a byte
+	const __m128i b0 = _mm_set1_epi8(pat[0]);
+	const __m128i b1 = _mm_set1_epi8(pat[1]);
+	const __m128i b2 = _mm_set1_epi8(pat[2]);
+	const __m128i b3 = _mm_set1_epi8(pat[3]);
+	__m128i eq;
+	unsigned int mask;
+
+	while( pos + 16 + 3 <= len ){
+		p = buf + pos;
+		eq = _mm_and_si128(
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), b0),
+				_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 1)), b1)),
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 2)), b2),
+				_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 3)), b3)));
+		mask = (unsigned int)_mm_movemask_epi8(eq);
+		while( mask != 0 ){
+			size_t off = pos + __builtin_ctz(mask);
+
+			if( scan_check(buf + off, len - off, swap) )
+				return off;
+			mask &= mask - 1;
+		}
+		pos += 16;
+	}
+#endif
+
+	//the rest which is shorter than a vector
+	while( pos + sizeof(pat) <= len ){
+		p = (const char*)memchr(buf + pos, pat[0], len - pos - sizeof(pat) + 1);
+		if( p == NULL )
+			break;
+		pos = p - buf;
+		if( memcmp(p, pat, sizeof(pat)) == 0 && scan_check(p, len - pos, swap) )
+			return pos;
+		pos++;
+	}
+	return len;
+}
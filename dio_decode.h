@@ -0,0 +1,53 @@
+/*
+	dio_decode.h
+	Batch decoding of the raw bits of dioparse.
+
+	blktrace writes the bits in the byte order of the traced host.
+	The byte order is detected once per file from the magic of the first
+	bit, and the headers of bits are validated and converted to the host
+	byte order as a batch on the read buffer.
+	The conversion uses SSSE3 shuffles if the cpu supports them,
+	otherwise it is done with scalar byte swaps.
+	On a damaged trace, the next bit can be found by scanning the magic
+	and checking the plausibility of its header.
+*/
+
+#ifndef DIO_DECODE_H
+#define DIO_DECODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "blktrace_api.h"
+
+// byte order of file
+#define DIO_ORDER_UNKNOWN	0
+#define DIO_ORDER_NATIVE	1
+#define DIO_ORDER_SWAPPED	2
+
+// the bits over these are invalid even if they have right magic
+#define DIO_DECODE_MAX_CPU	8192
+#define DIO_DECODE_MAX_PDU	4096
+
+// return the byte order of the bit, or DIO_ORDER_UNKNOWN if its magic
+// or version is wrong in both byte orders
+int dio_decode_order(const struct blk_io_trace* pbit);
+
+// return true if the bit (in host byte order) is valid
+bool dio_decode_valid(const struct blk_io_trace* pbit);
+
+// convert a header of bit to host byte order
+void dio_decode_swap(struct blk_io_trace* pbit);
+
+// decode the bits at the front of buf in place. the headers are converted
+// if 'swap' is true, and validated.
+// return the length of the decoded bits. it stops before the incomplete bit
+// at the end of buf, or before the invalid bit (then *invalid is set true)
+size_t dio_decode_bits(char* buf, size_t len, bool swap, bool* invalid);
+
+// return the offset of the first bit on buf which looks valid. the bit
+// after it should be valid too if its header is on buf.
+// return len if there isn't such bit
+size_t dio_decode_scan(const char* buf, size_t len, bool swap);
+
+#endif
@@ -0,0 +1,649 @@
+/*
+	dio_filter.c
+	Filter expressions of dioparse.
+
+	This source is free on GNU General Public License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+
+#include "dio_filter.h"
+
+#define MAX_WORD_LEN	64
+#define SMALL_SET_SIZE	8
+#define ACTION_CHARS	"QMFGSRDCPUTIXBAad"	/* from __BLK_TA_QUEUE */
+
+static const char* const field_names[DIO_FF_NR] = {
+	[DIO_FF_TIME]	= "time",
+	[DIO_FF_SECTOR]	= "sector",
+	[DIO_FF_BYTES]	= "bytes",
+	[DIO_FF_PID]	= "pid",
+	[DIO_FF_CPU]	= "cpu",
+	[DIO_FF_DEVICE]	= "device",
+	[DIO_FF_ERROR]	= "error",
+	[DIO_FF_ACTION]	= "action",
+	[DIO_FF_RW]	= "rw",
+};
+
+/*--------------	parser	------------------*/
+#define NODE_COND	0
+#define NODE_AND	1
+#define NODE_OR		2
+#define NODE_NOT	3
+
+// syntax tree of expression. children are indices of nodes
+struct filter_node{
+	int type;
+	int left;
+	int right;
+	int size;	//count of tests in this tree
+	struct dio_filter_ins cond;
+};
+
+struct filter_parser{
+	const char* expr;
+	const char* p;
+	char* err;
+	size_t errlen;
+	bool failed;
+
+	struct filter_node* nodes;
+	int nr_nodes;
+	int nodes_size;
+	struct dio_filter* pf;	//owner of sets
+};
+
+static int parse_expr(struct filter_parser* ps);
+
+static void parse_error(struct filter_parser* ps, const char* msg){
+	if( ps->failed )
+		return;
+	ps->failed = true;
+	snprintf(ps->err, ps->errlen, "%s at column %d", msg, (int)(ps->p - ps->expr) + 1);
+}
+
+static void skip_space(struct filter_parser* ps){
+	while( isspace((unsigned char)*ps->p) )
+		ps->p++;
+}
+
+// consume the token if it is next
+static bool parse_accept(struct filter_parser* ps, const char* tok){
+	size_t len = strlen(tok);
+
+	skip_space(ps);
+	if( strncmp(ps->p, tok, len) != 0 )
+		return false;
+	ps->p += len;
+	return true;
+}
+
+static void parse_expect(struct filter_parser* ps, const char* tok){
+	char msg[32];
+
+	if( !parse_accept(ps, tok) ){
+		snprintf(msg, sizeof(msg), "'%s' is expected", tok);
+		parse_error(ps, msg);
+	}
+}
+
+// names and values are words of [A-Za-z0-9._:]
+static bool parse_word(struct filter_parser* ps, char* word){
+	int len = 0;
+
+	skip_space(ps);
+	while( isalnum((unsigned char)*ps->p) || *ps->p == '.' || *ps->p == '_' || *ps->p == ':' ){
+		if( len >= MAX_WORD_LEN-1 ){
+			parse_error(ps, "too long word");
+			return false;
+		}
+		word[len++] = *ps->p++;
+	}
+	word[len] = '\0';
+	if( len == 0 ){
+		parse_error(ps, "word is expected");
+		return false;
+	}
+	return true;
+}
+
+static int new_node(struct filter_parser* ps, int type, int left, int right){
+	struct filter_node* pnode;
+
+	if( ps->nr_nodes >= ps->nodes_size ){
+		int size = ps->nodes_size ? ps->nodes_size * 2 : 16;
+		pnode = (struct filter_node*)realloc(ps->nodes, sizeof(struct filter_node) * size);
+		if( pnode == NULL ){
+			parse_error(ps, "out of memory");
+			return -1;
+		}
+		ps->nodes = pnode;
+		ps->nodes_size = size;
+	}
+
+	pnode = &ps->nodes[ps->nr_nodes];
+	memset(pnode, 0, sizeof(struct filter_node));
+	pnode->type = type;
+	pnode->left = left;
+	pnode->right = right;
+	if( type == NODE_COND )
+		pnode->size = 1;
+	else if( type == NODE_NOT )
+		pnode->size = ps->nodes[left].size;
+	else
+		pnode->size = ps->nodes[left].size + ps->nodes[right].size;
+	return ps->nr_nodes++;
+}
+
+static bool parse_value(struct filter_parser* ps, int field, uint64_t* pval){
+	char word[MAX_WORD_LEN];
+	char* end = NULL;
+	const char* pc;
+	double dval;
+	uint64_t mult = 1;
+
+	if( !parse_word(ps, word) )
+		return false;
+
+	switch( field ){
+	case DIO_FF_TIME:
+		dval = strtod(word, &end);
+		if( end == word )
+			break;
+		if( *end == '\0' || !strcmp(end, "s") )
+			mult = 1000000000;
+		else if( !strcmp(end, "ms") )
+			mult = 1000000;
+		else if( !strcmp(end, "us") )
+			mult = 1000;
+		else if( !strcmp(end, "ns") )
+			mult = 1;
+		else
+			break;
+		if( dval < 0 )
+			break;
+		*pval = (uint64_t)(dval * mult + 0.5);
+		return true;
+
+	case DIO_FF_SECTOR:
+	case DIO_FF_BYTES:
+		*pval = strtoull(word, &end, 0);
+		if( end == word )
+			break;
+		if( field == DIO_FF_BYTES && *end != '\0' && end[1] == '\0' ){
+			switch( tolower((unsigned char)*end) ){
+			case 'g':
+				mult *= 1024;
+				//fall through
+			case 'm':
+				mult *= 1024;
+				//fall through
+			case 'k':
+				mult *= 1024;
+				end++;
+				break;
+			}
+			*pval *= mult;
+		}
+		if( *end != '\0' )
+			break;
+		return true;
+
+	case DIO_FF_DEVICE:
+		//same as MKDEV of blktrace
+		*pval = strtoull(word, &end, 0);
+		if( end == word )
+			break;
+		if( *end == ':' ){
+			pc = end + 1;
+			*pval = (*pval << 20) | strtoull(pc, &end, 0);
+			if( end == pc )
+				break;
+		}
+		if( *end != '\0' )
+			break;
+		return true;
+
+	case DIO_FF_ACTION:
+		if( word[1] == '\0' && (pc = strchr(ACTION_CHARS, word[0])) != NULL ){
+			*pval = (pc - ACTION_CHARS) + 1;
+			return true;
+		}
+		*pval = strtoull(word, &end, 0);
+		if( end == word || *end != '\0' )
+			break;
+		return true;
+
+	case DIO_FF_RW:
+		if( !strcmp(word, "R") ){
+			*pval = BLK_TC_READ;
+			return true;
+		}
+		if( !strcmp(word, "W") ){
+			*pval = BLK_TC_WRITE;
+			return true;
+		}
+		break;
+
+	default:
+		*pval = strtoull(word, &end, 0);
+		if( end == word || *end != '\0' )
+			break;
+		return true;
+	}
+
+	parse_error(ps, "wrong value");
+	return false;
+}
+
+static int compare_u64(const void* a, const void* b){
+	uint64_t va = *(const uint64_t*)a;
+	uint64_t vb = *(const uint64_t*)b;
+
+	return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+// values of 'in {}' are appended to sets of filter
+static bool parse_set(struct filter_parser* ps, struct dio_filter_ins* pins){
+	struct dio_filter* pf = ps->pf;
+	uint64_t* sets;
+	uint64_t val;
+	int first = pf->nr_sets;
+	int i, nr = 0;
+
+	do{
+		if( !parse_value(ps, pins->field, &val) )
+			return false;
+		sets = (uint64_t*)realloc(pf->sets, sizeof(uint64_t) * (pf->nr_sets + 1));
+		if( sets == NULL ){
+			parse_error(ps, "out of memory");
+			return false;
+		}
+		pf->sets = sets;
+		pf->sets[pf->nr_sets++] = val;
+	}while( parse_accept(ps, ",") );
+	parse_expect(ps, "}");
+
+	//sorted and unique for binary search
+	qsort(pf->sets + first, pf->nr_sets - first, sizeof(uint64_t), compare_u64);
+	for(i=0; i<pf->nr_sets - first; i++){
+		if( nr == 0 || pf->sets[first + nr - 1] != pf->sets[first + i] )
+			pf->sets[first + nr++] = pf->sets[first + i];
+	}
+	pf->nr_sets = first + nr;
+
+	pins->op = DIO_FOP_SET;
+	pins->a = first;
+	pins->b = nr;
+	return !ps->failed;
+}
+
+static int parse_cond(struct filter_parser* ps){
+	static const struct{
+		const char* tok;
+		int op;
+	} ops[] = {
+		{ "==", DIO_FOP_EQ }, { "!=", DIO_FOP_NE },
+		{ "<=", DIO_FOP_LE }, { ">=", DIO_FOP_GE },
+		{ "<", DIO_FOP_LT }, { ">", DIO_FOP_GT },
+	};
+	struct dio_filter_ins ins;
+	char word[MAX_WORD_LEN];
+	int node, i;
+
+	if( !parse_word(ps, word) )
+		return -1;
+	memset(&ins, 0, sizeof(ins));
+	for(i=0; i<DIO_FF_NR; i++){
+		if( !strcmp(word, field_names[i]) )
+			break;
+	}
+	if( i == DIO_FF_NR ){
+		parse_error(ps, "unknown field");
+		return -1;
+	}
+	ins.field = i;
+
+	if( parse_accept(ps, "in") ){
+		if( parse_accept(ps, "{") ){
+			if( !parse_set(ps, &ins) )
+				return -1;
+		}
+		else if( parse_accept(ps, "[") ){
+			ins.op = DIO_FOP_RANGE;
+			if( !parse_value(ps, ins.field, &ins.a) )
+				return -1;
+			parse_expect(ps, ",");
+			if( ps->failed || !parse_value(ps, ins.field, &ins.b) )
+				return -1;
+			parse_expect(ps, "]");
+		}
+		else
+			parse_error(ps, "'{' or '[' is expected");
+	}
+	else{
+		for(i=0; i<(int)(sizeof(ops)/sizeof(ops[0])); i++){
+			if( parse_accept(ps, ops[i].tok) )
+				break;
+		}
+		if( i == (int)(sizeof(ops)/sizeof(ops[0])) ){
+			parse_error(ps, "operator is expected");
+			return -1;
+		}
+		ins.op = ops[i].op;
+		if( !parse_value(ps, ins.field, &ins.a) )
+			return -1;
+	}
+	if( ps->failed )
+		return -1;
+
+	node = new_node(ps, NODE_COND, -1, -1);
+	if( node >= 0 )
+		ps->nodes[node].cond = ins;
+	return node;
+}
+
+static int parse_factor(struct filter_parser* ps){
+	int node;
+
+	if( parse_accept(ps, "!") ){
+		node = parse_factor(ps);
+		return node < 0 ? -1 : new_node(ps, NODE_NOT, node, -1);
+	}
+	if( parse_accept(ps, "(") ){
+		node = parse_expr(ps);
+		parse_expect(ps, ")");
+		return ps->failed ? -1 : node;
+	}
+	return parse_cond(ps);
+}
+
+static int parse_term(struct filter_parser* ps){
+	int left, right;
+
+	left = parse_factor(ps);
+	while( left >= 0 && parse_accept(ps, "&&") ){
+		right = parse_factor(ps);
+		if( right < 0 )
+			return -1;
+		left = new_node(ps, NODE_AND, left, right);
+	}
+	return left;
+}
+
+int parse_expr(struct filter_parser* ps){
+	int left, right;
+
+	left = parse_term(ps);
+	while( left >= 0 && parse_accept(ps, "||") ){
+		right = parse_term(ps);
+		if( right < 0 )
+			return -1;
+		left = new_node(ps, NODE_OR, left, right);
+	}
+	return left;
+}
+
+/*--------------	code generation	------------------*/
+// comparisons are compiled into the range test, so a test is one compare
+static void compile_cond(struct dio_filter_ins* pins){
+	uint64_t lo = 0, hi = (uint64_t)(-1);
+	int tmp;
+
+	switch( pins->op ){
+	case DIO_FOP_NE:
+		//'!=' is '==' with swapped jumps
+		tmp = pins->jt;
+		pins->jt = pins->jf;
+		pins->jf = tmp;
+		//fall through
+	case DIO_FOP_EQ:
+		lo = hi = pins->a;
+		break;
+	case DIO_FOP_LT:
+		if( pins->a == 0 )
+			pins->jt = pins->jf;	//never true
+		hi = pins->a - 1;
+		break;
+	case DIO_FOP_LE:
+		hi = pins->a;
+		break;
+	case DIO_FOP_GT:
+		if( pins->a == (uint64_t)(-1) )
+			pins->jt = pins->jf;
+		lo = pins->a + 1;
+		break;
+	case DIO_FOP_GE:
+		lo = pins->a;
+		break;
+	case DIO_FOP_RANGE:
+		lo = pins->a;
+		hi = pins->b;
+		if( lo > hi )
+			pins->jt = pins->jf;
+		break;
+	default:
+		return;
+	}
+
+	pins->op = DIO_FOP_RANGE;
+	pins->a = lo;
+	pins->b = lo > hi ? 0 : hi - lo;
+}
+
+// emit the tests of node from pf->ins[pf->nr_ins].
+// the program goes to 'jt' if node is true, or 'jf'
+static void emit_node(struct dio_filter* pf, struct filter_node* nodes, int node, int jt, int jf){
+	struct filter_node* pnode = &nodes[node];
+	struct dio_filter_ins* pins;
+
+	switch( pnode->type ){
+	case NODE_COND:
+		pins = &pf->ins[pf->nr_ins++];
+		*pins = pnode->cond;
+		pins->jt = jt;
+		pins->jf = jf;
+		compile_cond(pins);
+		break;
+	case NODE_AND:
+		//right side starts after the tests of left side
+		emit_node(pf, nodes, pnode->left, pf->nr_ins + nodes[pnode->left].size, jf);
+		emit_node(pf, nodes, pnode->right, jt, jf);
+		break;
+	case NODE_OR:
+		emit_node(pf, nodes, pnode->left, jt, pf->nr_ins + nodes[pnode->left].size);
+		emit_node(pf, nodes, pnode->right, jt, jf);
+		break;
+	case NODE_NOT:
+		emit_node(pf, nodes, pnode->left, jf, jt);
+		break;
+	}
+}
+
+// let the program go to the new tests from nr_ins when it accepts
+static bool grow_program(struct dio_filter* pf, int nr){
+	struct dio_filter_ins* ins;
+	int i;
+
+	ins = (struct dio_filter_ins*)realloc(pf->ins, sizeof(struct dio_filter_ins) * (pf->nr_ins + nr));
+	if( ins == NULL )
+		return false;
+	pf->ins = ins;
+
+	for(i=0; i<pf->nr_ins; i++){
+		if( ins[i].jt == DIO_FILTER_ACCEPT )
+			ins[i].jt = pf->nr_ins;
+		if( ins[i].jf == DIO_FILTER_ACCEPT )
+			ins[i].jf = pf->nr_ins;
+	}
+	return true;
+}
+
+void dio_filter_init(struct dio_filter* pf){
+	memset(pf, 0, sizeof(struct dio_filter));
+}
+
+void dio_filter_free(struct dio_filter* pf){
+	free(pf->ins);
+	free(pf->sets);
+	memset(pf, 0, sizeof(struct dio_filter));
+}
+
+bool dio_filter_compile(struct dio_filter* pf, const char* expr, char* err, size_t errlen){
+	struct filter_parser ps;
+	int root;
+
+	memset(&ps, 0, sizeof(ps));
+	ps.expr = ps.p = expr;
+	ps.err = err;
+	ps.errlen = errlen;
+	ps.pf = pf;
+
+	root = parse_expr(&ps);
+	skip_space(&ps);
+	if( root >= 0 && *ps.p != '\0' )
+		parse_error(&ps, "unexpected word");
+	if( root >= 0 && !ps.failed ){
+		if( grow_program(pf, ps.nodes[root].size) )
+			emit_node(pf, ps.nodes, root, DIO_FILTER_ACCEPT, DIO_FILTER_REJECT);
+		else
+			parse_error(&ps, "out of memory");
+	}
+
+	free(ps.nodes);
+	return !ps.failed;
+}
+
+bool dio_filter_add_range(struct dio_filter* pf, int field, uint64_t lo, uint64_t hi){
+	struct dio_filter_ins* pins;
+
+	if( !grow_program(pf, 1) )
+		return false;
+	pins = &pf->ins[pf->nr_ins++];
+	memset(pins, 0, sizeof(struct dio_filter_ins));
+	pins->field = field;
+	pins->op = DIO_FOP_RANGE;
+	pins->a = lo;
+	pins->b = hi;
+	pins->jt = DIO_FILTER_ACCEPT;
+	pins->jf = DIO_FILTER_REJECT;
+	compile_cond(pins);
+	return true;
+}
+
+/*--------------	execution	------------------*/
+static inline uint64_t field_value(const struct blk_io_trace* pbit, int field){
+	switch( field ){
+	case DIO_FF_TIME:	return pbit->time;
+	case DIO_FF_SECTOR:	return pbit->sector;
+	case DIO_FF_BYTES:	return pbit->bytes;
+	case DIO_FF_PID:	return pbit->pid;
+	case DIO_FF_CPU:	return pbit->cpu;
+	case DIO_FF_DEVICE:	return pbit->device;
+	case DIO_FF_ERROR:	return pbit->error;
+	case DIO_FF_ACTION:	return pbit->action & 0xFFFF;
+	case DIO_FF_RW:		return (pbit->action >> BLK_TC_SHIFT) & (BLK_TC_READ | BLK_TC_WRITE);
+	}
+	return 0;
+}
+
+static inline bool in_set(const uint64_t* set, int nr, uint64_t val){
+	int lo = 0, hi = nr - 1, mid;
+	bool ret = false;
+
+	//small set is compared without branch
+	if( nr <= SMALL_SET_SIZE ){
+		for(mid=0; mid<nr; mid++)
+			ret |= set[mid] == val;
+		return ret;
+	}
+
+	while( lo <= hi ){
+		mid = (lo + hi) / 2;
+		if( set[mid] == val )
+			return true;
+		if( set[mid] < val )
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return false;
+}
+
+// run the program from the test of 'pc'
+static inline bool run_program(const struct dio_filter* pf, const struct blk_io_trace* pbit, int pc){
+	const struct dio_filter_ins* pins;
+	uint64_t val;
+	bool ret;
+
+	while( pc >= 0 ){
+		pins = &pf->ins[pc];
+		val = field_value(pbit, pins->field);
+		if( pins->op == DIO_FOP_RANGE )
+			ret = val - pins->a <= pins->b;
+		else
+			ret = in_set(pf->sets + pins->a, (int)pins->b, val);
+		pc = ret ? pins->jt : pins->jf;
+	}
+	return pc == DIO_FILTER_ACCEPT;
+}
+
+bool dio_filter_match(const struct dio_filter* pf, const struct blk_io_trace* pbit){
+	if( pf->nr_ins == 0 )
+		return true;
+	return run_program(pf, pbit, 0);
+}
+
+// the first test is run on all bits of batch without branch, and the bits
+// which are not finished by it go on from their next test one by one.
+// the first test usually finishes the most of bits (ex. time range)
+#define FIRST_LOOP(value)						\
+	for(j=0; j<nr; j++){							\
+		val = (value);							\
+		pc[j] = val - pins->a <= pins->b ? pins->jt : pins->jf;	\
+	}
+
+static void run_batch(const struct dio_filter* pf, struct blk_io_trace* const* bits, int nr, bool* match){
+	const struct dio_filter_ins* pins = &pf->ins[0];
+	int pc[DIO_FILTER_BATCH];
+	uint64_t val;
+	int j;
+
+	if( pins->op == DIO_FOP_RANGE ){
+		//the loop is made for each field
+		switch( pins->field ){
+		case DIO_FF_TIME:	FIRST_LOOP(bits[j]->time);	break;
+		case DIO_FF_SECTOR:	FIRST_LOOP(bits[j]->sector);	break;
+		case DIO_FF_BYTES:	FIRST_LOOP(bits[j]->bytes);	break;
+		case DIO_FF_PID:	FIRST_LOOP(bits[j]->pid);	break;
+		case DIO_FF_CPU:	FIRST_LOOP(bits[j]->cpu);	break;
+		case DIO_FF_DEVICE:	FIRST_LOOP(bits[j]->device);	break;
+		case DIO_FF_ERROR:	FIRST_LOOP(bits[j]->error);	break;
+		case DIO_FF_ACTION:	FIRST_LOOP(field_value(bits[j], DIO_FF_ACTION));	break;
+		case DIO_FF_RW:		FIRST_LOOP(field_value(bits[j], DIO_FF_RW));	break;
+		}
+	}
+	else{
+		for(j=0; j<nr; j++){
+			val = field_value(bits[j], pins->field);
+			pc[j] = in_set(pf->sets + pins->a, (int)pins->b, val) ? pins->jt : pins->jf;
+		}
+	}
+
+	for(j=0; j<nr; j++)
+		match[j] = pc[j] >= 0 ? run_program(pf, bits[j], pc[j]) : pc[j] == DIO_FILTER_ACCEPT;
+}
+
+void dio_filter_batch(const struct dio_filter* pf, struct blk_io_trace* const* bits, int nr, bool* match){
+	int i;
+
+	if( pf->nr_ins == 0 ){
+		memset(match, true, sizeof(bool) * nr);
+		return;
+	}
+	for(i=0; i<nr; i+=DIO_FILTER_BATCH)
+		run_batch(pf, bits + i, nr - i < DIO_FILTER_BATCH ? nr - i : DIO_FILTER_BATCH, match + i);
+}
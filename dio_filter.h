@@ -0,0 +1,102 @@
+/*
+	dio_filter.h
+	Filter expressions of dioparse.
+
+	An expression is compiled once into a small program of tests. Each test
+	compares a field of bit and jumps to the next test by its result, so
+	'&&', '||' and '!' are short-circuited without a stack.
+	The program is run over a batch of bits at once.
+
+	expression
+		expr	: term ( '||' term )*
+		term	: factor ( '&&' factor )*
+		factor	: '!' factor | '(' expr ')' | cond
+		cond	: field op value
+			| field 'in' '{' value ( ',' value )* '}'
+			| field 'in' '[' value ',' value ']'
+		op	: '==' | '!=' | '<' | '<=' | '>' | '>='
+
+	fields and values
+		time	: seconds, or with unit 's', 'ms', 'us', 'ns' (ex. 1.5s, 200ms)
+		sector, bytes	: number, bytes can have unit 'k', 'm', 'g'
+		pid, cpu, error	: number
+		device	: 'major:minor' or number
+		action	: Q M F G S R D C P U T I X B A a d (see blktrace_api.h)
+		rw	: R or W
+*/
+
+#ifndef DIO_FILTER_H
+#define DIO_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "blktrace_api.h"
+
+// fields of bit
+enum{
+	DIO_FF_TIME = 0,
+	DIO_FF_SECTOR,
+	DIO_FF_BYTES,
+	DIO_FF_PID,
+	DIO_FF_CPU,
+	DIO_FF_DEVICE,
+	DIO_FF_ERROR,
+	DIO_FF_ACTION,
+	DIO_FF_RW,
+	DIO_FF_NR
+};
+
+// test operations
+enum{
+	DIO_FOP_EQ = 0,
+	DIO_FOP_NE,
+	DIO_FOP_LT,
+	DIO_FOP_LE,
+	DIO_FOP_GT,
+	DIO_FOP_GE,
+	DIO_FOP_RANGE,	//a <= field <= a+b
+	DIO_FOP_SET,	//field is one of sets[a] ~ sets[a+b-1] (sorted)
+};
+// the compiled program has only RANGE and SET tests.
+// the comparisons are compiled into RANGE, and '!=' swaps the jumps
+
+// bits are run as the batch of this size
+#define DIO_FILTER_BATCH	64
+
+// jump targets which end the program
+#define DIO_FILTER_ACCEPT	(-1)
+#define DIO_FILTER_REJECT	(-2)
+
+struct dio_filter_ins{
+	uint8_t field;
+	uint8_t op;
+	int jt;		//next test if it's true
+	int jf;		//next test if it's false
+	uint64_t a;
+	uint64_t b;
+};
+
+struct dio_filter{
+	struct dio_filter_ins* ins;	//an empty program accepts all
+	int nr_ins;
+	uint64_t* sets;			//values of 'in {}'
+	int nr_sets;
+};
+
+void dio_filter_init(struct dio_filter* pf);
+void dio_filter_free(struct dio_filter* pf);
+
+// compile the expression, and it's ANDed with the program of pf.
+// return false with the message on 'err' if it has a syntax error
+bool dio_filter_compile(struct dio_filter* pf, const char* expr, char* err, size_t errlen);
+
+// AND the condition 'lo <= field <= hi' with the program of pf
+bool dio_filter_add_range(struct dio_filter* pf, int field, uint64_t lo, uint64_t hi);
+
+bool dio_filter_match(const struct dio_filter* pf, const struct blk_io_trace* pbit);
+
+// match[i] is set whether bits[i] is matched with the filter
+void dio_filter_batch(const struct dio_filter* pf, struct blk_io_trace* const* bits, int nr, bool* match);
+
+#endif
@@ -0,0 +1,167 @@
+/*
+	dio_format.c
+	Fast text formatting of dioparse.
+
+	This source is free on GNU General Public License.
+*/
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "dio_format.h"
+
+// two digits of 00 ~ 99
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+bool dio_fmt_open(struct dio_fmtbuf* pfb, FILE* stream){
+	pfb->stream = stream;
+	pfb->len = 0;
+	pfb->buf = (char*)malloc(DIO_FMT_BUF_SIZE);
+	return pfb->buf != NULL;
+}
+
+void dio_fmt_close(struct dio_fmtbuf* pfb){
+	dio_fmt_flush(pfb);
+	free(pfb->buf);
+	pfb->buf = NULL;
+}
+
+bool dio_fmt_flush(struct dio_fmtbuf* pfb){
+	const char* p = pfb->buf;
+	size_t len = pfb->len;
+	ssize_t wrsz;
+	int fd;
+
+	if( len == 0 )
+		return true;
+	pfb->len = 0;
+
+	//the text on stream is earlier than this buffer
+	if( fflush(pfb->stream) != 0 )
+		return false;
+	fd = fileno(pfb->stream);
+	while( len > 0 ){
+		wrsz = write(fd, p, len);
+		if( wrsz < 0 ){
+			if( errno == EINTR )
+				continue;
+			return false;
+		}
+		p += wrsz;
+		len -= wrsz;
+	}
+	return true;
+}
+
+// write 'digits' digits of v which is less than 10^digits
+static inline char* put_digits(char* p, uint64_t v, int digits){
+	char* end = p + digits;
+	char* q = end;
+
+	while( q - p >= 2 ){
+		q -= 2;
+		memcpy(q, digit_pairs + (v % 100) * 2, 2);
+		v /= 100;
+	}
+	if( q > p )
+		*--q = (char)('0' + v % 10);
+	return end;
+}
+
+static inline int count_digits(uint64_t v){
+	int n = 1;
+
+	while( v >= 10000 ){
+		v /= 10000;
+		n += 4;
+	}
+	if( v >= 1000 )
+		return n + 3;
+	if( v >= 100 )
+		return n + 2;
+	if( v >= 10 )
+		return n + 1;
+	return n;
+}
+
+char* dio_fmt_u64(char* p, uint64_t v){
+	return put_digits(p, v, count_digits(v));
+}
+
+char* dio_fmt_int(char* p, int v){
+	if( v < 0 ){
+		*p++ = '-';
+		return dio_fmt_u64(p, (uint64_t)(-(int64_t)v));
+	}
+	return dio_fmt_u64(p, (uint64_t)v);
+}
+
+char* dio_fmt_seconds(char* p, uint64_t ns){
+	int sec = (int)(ns / 1000000000);
+	int n;
+
+	//seconds are right aligned on 5 columns
+	if( sec >= 0 ){
+		n = count_digits((uint64_t)sec);
+		for(; n < 5; n++)
+			*p++ = ' ';
+		p = dio_fmt_u64(p, (uint64_t)sec);
+	}
+	else{
+		n = count_digits((uint64_t)(-(int64_t)sec)) + 1;
+		for(; n < 5; n++)
+			*p++ = ' ';
+		p = dio_fmt_int(p, sec);
+	}
+	*p++ = '.';
+	return put_digits(p, ns % 1000000000, 9);
+}
+
+char* dio_fmt_csv_str(char* p, const char* str){
+	if( strpbrk(str, ",\"\r\n") == NULL )
+		return dio_fmt_str(p, str);
+
+	*p++ = '"';
+	for(; *str; str++){
+		if( *str == '"' )
+			*p++ = '"';
+		*p++ = *str;
+	}
+	*p++ = '"';
+	return p;
+}
+
+char* dio_fmt_json_str(char* p, const char* str){
+	static const char hex[] = "0123456789abcdef";
+	unsigned char c;
+
+	*p++ = '"';
+	for(; *str; str++){
+		c = (unsigned char)*str;
+		if( c == '"' || c == '\\' ){
+			*p++ = '\\';
+			*p++ = c;
+		}
+		else if( c < 0x20 ){
+			p = dio_fmt_str(p, "\\u00");
+			*p++ = hex[c >> 4];
+			*p++ = hex[c & 0xf];
+		}
+		else
+			*p++ = c;
+	}
+	*p++ = '"';
+	return p;
+}
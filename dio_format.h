@@ -0,0 +1,73 @@
+/*
+	dio_format.h
+	Fast text formatting of dioparse.
+
+	The records are rendered into a large buffer with the table driven
+	integer conversion instead of parsing the format of printf for each
+	field, and the buffer is written with a single write().
+	The text is same as the printf format written on each function.
+*/
+
+#ifndef DIO_FORMAT_H
+#define DIO_FORMAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DIO_FMT_BUF_SIZE	(1024*1024)
+#define DIO_FMT_MAX_FIELD	32	/* enough for any field of this file */
+
+struct dio_fmtbuf{
+	FILE* stream;
+	char* buf;
+	size_t len;
+};
+
+bool dio_fmt_open(struct dio_fmtbuf* pfb, FILE* stream);
+void dio_fmt_close(struct dio_fmtbuf* pfb);
+
+// write the buffered text after the text which is buffered on stream.
+// return false on error
+bool dio_fmt_flush(struct dio_fmtbuf* pfb);
+
+// return the position to put a record of 'len' bytes at most
+static inline char* dio_fmt_reserve(struct dio_fmtbuf* pfb, size_t len){
+	if( pfb->len + len > DIO_FMT_BUF_SIZE )
+		dio_fmt_flush(pfb);
+	return pfb->buf + pfb->len;
+}
+
+// the record which is put from dio_fmt_reserve() ends at p
+static inline void dio_fmt_commit(struct dio_fmtbuf* pfb, char* p){
+	pfb->len = p - pfb->buf;
+}
+
+// "%"PRIu64
+char* dio_fmt_u64(char* p, uint64_t v);
+
+// "%d"
+char* dio_fmt_int(char* p, int v);
+
+// "%5d.%09lu" of seconds and nanoseconds
+char* dio_fmt_seconds(char* p, uint64_t ns);
+
+static inline char* dio_fmt_char(char* p, char c){
+	*p++ = c;
+	return p;
+}
+
+static inline char* dio_fmt_str(char* p, const char* str){
+	while( *str )
+		*p++ = *str++;
+	return p;
+}
+
+// field of CSV. it is quoted if it has comma, quote or line break.
+// it takes (2 * strlen(str) + 2) bytes at most
+char* dio_fmt_csv_str(char* p, const char* str);
+
+// quoted string of JSON. it takes (6 * strlen(str) + 2) bytes at most
+char* dio_fmt_json_str(char* p, const char* str);
+
+#endif
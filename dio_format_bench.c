@@ -0,0 +1,117 @@
+/*
+	dio_format_bench.c
+	Benchmark of dio_format against fprintf on the records of print_time().
+
+	usage : dio_format_bench [ <count of records> ]
+	Both are written to /dev/null, and the texts are compared before that.
+
+	This source is free on GNU General Public License.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "blktrace_api.h"
+#include "dio_format.h"
+
+#define DEFAULT_RECORDS 10000000
+#define NR_SAMPLES 4096
+
+static void fill_bits(struct blk_io_trace* bits, int cnt){
+	uint64_t time = 0;
+	int i;
+
+	srand(1);
+	for(i=0; i<cnt; i++){
+		time += rand() % 400000;
+		bits[i].time = time + (i % 7 == 0 ? (uint64_t)(rand() % 100000) * 1000000000ULL : 0);
+		bits[i].sector = ((uint64_t)rand() << 20) ^ rand();
+		bits[i].pid = rand() % 70000;
+		bits[i].bytes = (rand() % 256) * 512;
+	}
+}
+
+static void print_fprintf(FILE* stream, struct blk_io_trace* pbit){
+	fprintf(stream,"%5d.%09lu\t", (int)(pbit->time / 1000000000), (unsigned long)(pbit->time % 1000000000));
+	fprintf(stream,"%llu\t",pbit->sector);
+	fprintf(stream,"%u\t",pbit->pid);
+	fprintf(stream,"%u\n",pbit->bytes/8);
+}
+
+static char* print_fmt(char* p, struct blk_io_trace* pbit){
+	p = dio_fmt_seconds(p, pbit->time);
+	p = dio_fmt_char(p, '\t');
+	p = dio_fmt_u64(p, pbit->sector);
+	p = dio_fmt_char(p, '\t');
+	p = dio_fmt_u64(p, pbit->pid);
+	p = dio_fmt_char(p, '\t');
+	p = dio_fmt_u64(p, pbit->bytes/8);
+	return dio_fmt_char(p, '\n');
+}
+
+static double now(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv){
+	struct blk_io_trace bits[NR_SAMPLES];
+	struct dio_fmtbuf fb;
+	char expect[4 * DIO_FMT_MAX_FIELD];
+	char got[4 * DIO_FMT_MAX_FIELD];
+	FILE* stream = NULL;
+	FILE* mem = NULL;
+	long cnt = argc > 1 ? atol(argv[1]) : DEFAULT_RECORDS;
+	double t0, t_printf, t_fmt;
+	long i;
+	char* p;
+
+	fill_bits(bits, NR_SAMPLES);
+
+	//texts should be same
+	for(i=0; i<NR_SAMPLES; i++){
+		memset(expect, 0, sizeof(expect));
+		mem = fmemopen(expect, sizeof(expect), "w");
+		print_fprintf(mem, &bits[i]);
+		fclose(mem);
+		p = print_fmt(got, &bits[i]);
+		if( (size_t)(p - got) != strlen(expect) || memcmp(expect, got, p - got) != 0 ){
+			fprintf(stderr, "text mismatch at %ld\n%s%.*s", i, expect, (int)(p - got), got);
+			return 1;
+		}
+	}
+
+	stream = fopen("/dev/null", "w");
+	if( stream == NULL || !dio_fmt_open(&fb, stream) ){
+		perror("failed to open /dev/null");
+		return 1;
+	}
+
+	t0 = now();
+	for(i=0; i<cnt; i++)
+		print_fprintf(stream, &bits[i % NR_SAMPLES]);
+	fflush(stream);
+	t_printf = now() - t0;
+
+	t0 = now();
+	for(i=0; i<cnt; i++){
+		p = dio_fmt_reserve(&fb, 4 * DIO_FMT_MAX_FIELD);
+		dio_fmt_commit(&fb, print_fmt(p, &bits[i % NR_SAMPLES]));
+	}
+	dio_fmt_flush(&fb);
+	t_fmt = now() - t0;
+
+	printf("%ld records\n", cnt);
+	printf("%10s %10.3f sec %12.0f records/sec\n", "fprintf", t_printf, cnt / t_printf);
+	printf("%10s %10.3f sec %12.0f records/sec\n", "dio_fmt", t_fmt, cnt / t_fmt);
+	printf("%10s %10.2fx\n", "speedup", t_printf / t_fmt);
+
+	dio_fmt_close(&fb);
+	fclose(stream);
+	return 0;
+}
@@ -0,0 +1,88 @@
+/*
+	dio_hist.c
+	Log-linear latency histogram of dioparse.
+
+	This source is free on GNU General Public License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dio_hist.h"
+
+#define DIO_HIST_MAX_VALUE	((1ULL << DIO_HIST_MAX_BITS) - 1)
+
+static inline int dio_hist_index(uint64_t value){
+	int msb;
+
+	if( value > DIO_HIST_MAX_VALUE )
+		value = DIO_HIST_MAX_VALUE;
+	if( value < DIO_HIST_SUB_BUCKETS )
+		return (int)value;
+
+	//group of value is its most significant bit,
+	//and the following SUB_BITS bits select the bucket in group
+	msb = 63 - __builtin_clzll(value);
+	return ((msb - DIO_HIST_SUB_BITS + 1) << DIO_HIST_SUB_BITS) +
+		(int)((value >> (msb - DIO_HIST_SUB_BITS)) & (DIO_HIST_SUB_BUCKETS - 1));
+}
+
+// the biggest value of bucket
+static inline uint64_t dio_hist_upper(int idx){
+	int group = idx >> DIO_HIST_SUB_BITS;
+	uint64_t sub = idx & (DIO_HIST_SUB_BUCKETS - 1);
+
+	if( group == 0 )
+		return sub;
+	return ((DIO_HIST_SUB_BUCKETS + sub + 1) << (group - 1)) - 1;
+}
+
+struct dio_hist* dio_hist_create(void){
+	return (struct dio_hist*)calloc(1, sizeof(struct dio_hist));
+}
+
+void dio_hist_destroy(struct dio_hist* phist){
+	free(phist);
+}
+
+void dio_hist_record(struct dio_hist* phist, uint64_t value){
+	phist->buckets[dio_hist_index(value)]++;
+	phist->count++;
+	if( phist->max < value )
+		phist->max = value;
+}
+
+void dio_hist_merge(struct dio_hist* dst, const struct dio_hist* src){
+	int i;
+
+	for(i=0; i<DIO_HIST_NR_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	if( dst->max < src->max )
+		dst->max = src->max;
+}
+
+uint64_t dio_hist_percentile(const struct dio_hist* phist, double percentile){
+	uint64_t rank, sum = 0;
+	uint64_t upper;
+	int i;
+
+	if( phist == NULL || phist->count == 0 )
+		return 0;
+
+	//rank of the value, 1 ~ count
+	rank = (uint64_t)(percentile / 100.0 * phist->count + 0.5);
+	if( rank < 1 )
+		rank = 1;
+	if( rank > phist->count )
+		rank = phist->count;
+
+	for(i=0; i<DIO_HIST_NR_BUCKETS; i++){
+		sum += phist->buckets[i];
+		if( sum >= rank )
+			break;
+	}
+
+	upper = dio_hist_upper(i < DIO_HIST_NR_BUCKETS ? i : DIO_HIST_NR_BUCKETS - 1);
+	return upper < phist->max ? upper : phist->max;
+}
@@ -0,0 +1,41 @@
+/*
+	dio_hist.h
+	Log-linear latency histogram of dioparse.
+
+	Values are grouped by power of 2, and each group is divided into
+	DIO_HIST_SUB_BUCKETS linear buckets. So the bucket of a value is
+	found with a few bit operations, and the relative error of the
+	percentile is less than 1/DIO_HIST_SUB_BUCKETS.
+	Histograms of the same layout can be merged by adding the buckets.
+*/
+
+#ifndef DIO_HIST_H
+#define DIO_HIST_H
+
+#include <stdint.h>
+
+#define DIO_HIST_SUB_BITS	5
+#define DIO_HIST_SUB_BUCKETS	(1 << DIO_HIST_SUB_BITS)
+#define DIO_HIST_MAX_BITS	44	/* values over 2^44 ns (about 4.8 hours) are saturated */
+#define DIO_HIST_NR_BUCKETS	((DIO_HIST_MAX_BITS - DIO_HIST_SUB_BITS + 1) << DIO_HIST_SUB_BITS)
+
+struct dio_hist{
+	uint64_t count;
+	uint64_t max;
+	uint64_t buckets[DIO_HIST_NR_BUCKETS];
+};
+
+// return new zero filled histogram, or NULL if it couldn't be allocated
+struct dio_hist* dio_hist_create(void);
+void dio_hist_destroy(struct dio_hist* phist);
+
+void dio_hist_record(struct dio_hist* phist, uint64_t value);
+
+// add all values of src into dst
+void dio_hist_merge(struct dio_hist* dst, const struct dio_hist* src);
+
+// return the value at percentile (0 ~ 100).
+// it is the upper bound of the bucket, but never bigger than max.
+uint64_t dio_hist_percentile(const struct dio_hist* phist, double percentile);
+
+#endif
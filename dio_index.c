@@ -0,0 +1,217 @@
+/*
+	dio_index.c
+	Index structures for the active nuggets of dioparse.
+
+	This source is free on GNU General Public License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dio_index.h"
+
+/*--------------	hash table	------------------*/
+#define HASH_GOLDEN_RATIO	0x9E3779B97F4A7C15ULL
+
+static inline unsigned int hash_slot(struct dio_hash* ph, uint64_t key){
+	return (unsigned int)((key * HASH_GOLDEN_RATIO) >> 32) & (ph->size - 1);
+}
+
+bool dio_hash_init(struct dio_hash* ph, unsigned int size){
+	unsigned int sz = 16;
+
+	while( sz < size )
+		sz <<= 1;
+
+	ph->tbl = (struct dio_hash_entry*)calloc(sz, sizeof(struct dio_hash_entry));
+	if( ph->tbl == NULL )
+		return false;
+	ph->size = sz;
+	ph->cnt = 0;
+	return true;
+}
+
+void dio_hash_destroy(struct dio_hash* ph){
+	free(ph->tbl);
+	ph->tbl = NULL;
+	ph->size = ph->cnt = 0;
+}
+
+void* dio_hash_lookup(struct dio_hash* ph, uint64_t key){
+	unsigned int i = hash_slot(ph, key);
+
+	while( ph->tbl[i].val != NULL ){
+		if( ph->tbl[i].key == key )
+			return ph->tbl[i].val;
+		i = (i + 1) & (ph->size - 1);
+	}
+	return NULL;
+}
+
+static bool dio_hash_grow(struct dio_hash* ph){
+	struct dio_hash old = *ph;
+	unsigned int i;
+
+	if( !dio_hash_init(ph, old.size << 1) ){
+		*ph = old;
+		return false;
+	}
+	for(i=0; i<old.size; i++){
+		if( old.tbl[i].val != NULL )
+			dio_hash_insert(ph, old.tbl[i].key, old.tbl[i].val);
+	}
+	free(old.tbl);
+	return true;
+}
+
+bool dio_hash_insert(struct dio_hash* ph, uint64_t key, void* val){
+	unsigned int i;
+
+	//keep the load factor under 1/2 to make the probe short
+	if( (ph->cnt + 1) * 2 > ph->size && !dio_hash_grow(ph) )
+		return false;
+
+	i = hash_slot(ph, key);
+	while( ph->tbl[i].val != NULL ){
+		if( ph->tbl[i].key == key ){
+			ph->tbl[i].val = val;
+			return true;
+		}
+		i = (i + 1) & (ph->size - 1);
+	}
+	ph->tbl[i].key = key;
+	ph->tbl[i].val = val;
+	ph->cnt++;
+	return true;
+}
+
+void* dio_hash_remove(struct dio_hash* ph, uint64_t key){
+	unsigned int mask = ph->size - 1;
+	unsigned int i = hash_slot(ph, key);
+	unsigned int j, home;
+	void* val;
+
+	while( ph->tbl[i].val != NULL && ph->tbl[i].key != key )
+		i = (i + 1) & mask;
+	if( ph->tbl[i].val == NULL )
+		return NULL;
+
+	val = ph->tbl[i].val;
+	ph->cnt--;
+
+	//shift the following entries back instead of leaving a tombstone
+	j = i;
+	while(1){
+		j = (j + 1) & mask;
+		if( ph->tbl[j].val == NULL )
+			break;
+		home = hash_slot(ph, ph->tbl[j].key);
+		if( ((j - home) & mask) < ((j - i) & mask) )
+			continue;
+		ph->tbl[i] = ph->tbl[j];
+		i = j;
+	}
+	ph->tbl[i].val = NULL;
+	return val;
+}
+
+/*--------------	interval tree	------------------*/
+#define ival_entry(node)	rb_entry(node, struct dio_interval, rblink)
+
+static void itree_augment(struct rb_node* node, void* data __attribute__((unused))){
+	struct dio_interval* pival = ival_entry(node);
+	uint64_t max = pival->last;
+
+	if( node->rb_left && ival_entry(node->rb_left)->max_last > max )
+		max = ival_entry(node->rb_left)->max_last;
+	if( node->rb_right && ival_entry(node->rb_right)->max_last > max )
+		max = ival_entry(node->rb_right)->max_last;
+	pival->max_last = max;
+}
+
+void itree_insert(struct rb_root* root, struct dio_interval* pival){
+	struct rb_node** p = &root->rb_node;
+	struct rb_node* parent = NULL;
+
+	pival->max_last = pival->last;
+	while(*p){
+		parent = *p;
+		if( pival->start < ival_entry(parent)->start )
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	rb_link_node(&pival->rblink, parent, p);
+	rb_insert_color(&pival->rblink, root);
+	rb_augment_insert(&pival->rblink, itree_augment, NULL);
+}
+
+void itree_erase(struct rb_root* root, struct dio_interval* pival){
+	struct rb_node* deepest = rb_augment_erase_begin(&pival->rblink);
+
+	rb_erase(&pival->rblink, root);
+	rb_augment_erase_end(deepest, itree_augment, NULL);
+}
+
+static struct dio_interval* itree_subtree_search(struct dio_interval* pival,
+						uint64_t start, uint64_t last){
+	while(1){
+		if( pival->rblink.rb_left ){
+			struct dio_interval* left = ival_entry(pival->rblink.rb_left);
+			if( start <= left->max_last ){
+				pival = left;
+				continue;
+			}
+		}
+		if( pival->start <= last ){
+			if( start <= pival->last )
+				return pival;
+			if( pival->rblink.rb_right ){
+				pival = ival_entry(pival->rblink.rb_right);
+				if( start <= pival->max_last )
+					continue;
+			}
+		}
+		return NULL;
+	}
+}
+
+struct dio_interval* itree_first(struct rb_root* root, uint64_t start, uint64_t last){
+	struct dio_interval* pival;
+
+	if( root->rb_node == NULL )
+		return NULL;
+	pival = ival_entry(root->rb_node);
+	if( pival->max_last < start )
+		return NULL;
+	return itree_subtree_search(pival, start, last);
+}
+
+struct dio_interval* itree_next(struct dio_interval* pival, uint64_t start, uint64_t last){
+	struct rb_node* rb = pival->rblink.rb_right;
+	struct rb_node* prev;
+
+	while(1){
+		if( rb ){
+			struct dio_interval* right = ival_entry(rb);
+			if( start <= right->max_last )
+				return itree_subtree_search(right, start, last);
+		}
+
+		//move up the tree until we come from a node's left child
+		do{
+			rb = rb_parent(&pival->rblink);
+			if( rb == NULL )
+				return NULL;
+			prev = &pival->rblink;
+			pival = ival_entry(rb);
+			rb = pival->rblink.rb_right;
+		}while( prev == rb );
+
+		if( last < pival->start )
+			return NULL;
+		else if( start <= pival->last )
+			return pival;
+	}
+}
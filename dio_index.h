@@ -0,0 +1,60 @@
+/*
+	dio_index.h
+	Index structures for the active nuggets of dioparse.
+
+	dio_hash is an open addressing hash table which maps a sector number
+	to an active nugget, dio_interval is an interval tree node which is
+	augmented on the rbtree for searching the overlapped sector ranges.
+*/
+
+#ifndef DIO_INDEX_H
+#define DIO_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbtree.h"
+
+/*--------------	hash table	------------------*/
+struct dio_hash_entry{
+	uint64_t key;
+	void* val;		//NULL means empty slot
+};
+
+struct dio_hash{
+	struct dio_hash_entry* tbl;
+	unsigned int size;	//always power of 2
+	unsigned int cnt;
+};
+
+bool dio_hash_init(struct dio_hash* ph, unsigned int size);
+void dio_hash_destroy(struct dio_hash* ph);
+
+// return NULL if there isn't the key
+void* dio_hash_lookup(struct dio_hash* ph, uint64_t key);
+
+// insert or replace the value of key
+bool dio_hash_insert(struct dio_hash* ph, uint64_t key, void* val);
+
+// remove the key and return its value
+void* dio_hash_remove(struct dio_hash* ph, uint64_t key);
+
+/*--------------	interval tree	------------------*/
+// closed interval [start, last] on the rbtree ordered by start.
+// max_last is the biggest 'last' in the subtree of this node.
+struct dio_interval{
+	struct rb_node rblink;
+	uint64_t start;
+	uint64_t last;
+	uint64_t max_last;
+};
+
+void itree_insert(struct rb_root* root, struct dio_interval* pival);
+void itree_erase(struct rb_root* root, struct dio_interval* pival);
+
+// the first (lowest start) interval which overlaps [start, last]
+struct dio_interval* itree_first(struct rb_root* root, uint64_t start, uint64_t last);
+
+// the next interval of pival which overlaps [start, last]
+struct dio_interval* itree_next(struct dio_interval* pival, uint64_t start, uint64_t last);
+
+#endif
@@ -13,24 +13,32 @@
 #include <errno.h>
 #include <signal.h>
 #include <string.h>
+#include <ctype.h>
 #include <fcntl.h>
 #include <stdarg.h>
 #include <getopt.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <time.h>
 
 #include "dio_shark.h"
 #include "list.h"
 #include "rbtree.h"
 #include "blktrace_api.h"
+#include "dio_index.h"
+#include "dio_reader.h"
+#include "dio_parse.h"
+#include "dio_hist.h"
+#include "dio_format.h"
+#include "dio_filter.h"
 
 /*--------------	struct and defines	------------------*/
 #define SECONDS(x)              ((unsigned long long)(x) / 1000000000)
 #define NANO_SECONDS(x)         ((unsigned long long)(x) % 1000000000)
 #define DOUBLE_TO_NANO_ULL(d)   ((unsigned long long)((d) * 1000000000))
 
-#define BLK_ACTION_STRING		"QMFGSRDCPUTIXBAad"
-#define GET_ACTION_CHAR(x)      (0<(x&0xffff) && (x&0xffff)<sizeof(BLK_ACTION_STRING))?BLK_ACTION_STRING[(x & 0xffff) - 1]:'?'
 
 #define BE_TO_LE16(word) \
 	(((word)>>8 & 0x00FF) | ((word)<<8 & 0xFF00))
@@ -59,66 +67,55 @@
 	(bit).pdu_len	= BE_TO_LE16((bit).pdu_len)
 
 
-// dio_rbentity used for handling nuggets as sector order
-struct dio_rbentity{
-	struct rb_node rblink;		//red black tree link
-	struct list_head nghead;	//head of nugget list
-	uint64_t sector;
-};
-
-// dio_nugget is a treated data of bit
-// it will be linked at dio_rbentity 's nghead
-#define MAX_ELEMENT_SIZE 50
-#define NG_ACTIVE	1
-#define NG_BACKMERGE	2
-#define NG_FRONTMERGE	3
-#define NG_COMPLETE	4
-struct dio_nugget{
-	struct list_head nglink;	//link of dio_nugget datatype
-
-	//real nugget data
-	int elemidx;	//element index. (elemidx-1) is count of nugget states
-	int category;
-	char states[MAX_ELEMENT_SIZE];	//action
-	uint64_t times[MAX_ELEMENT_SIZE];	//states[elemidx] is occured at times[elemidx]
-	int size;	//size of nugget
-	uint64_t sector;	//sector number of bit who was requested. is it really need?
-	uint32_t pid;
-	struct dio_nugget* mlink;	//if it was merged, than mlink points the other nugget
-	int ngflag;
-	int idxCPU;
-};
-
 // list node of blk_io_trace
 // it just maintain the time ordered bits
+#define MAX_PDU_SIZE 16		//enough for remap, split and process name
 struct bit_entity{
 	struct list_head link;
 	
 	struct blk_io_trace bit;
+	char pdu[MAX_PDU_SIZE];		//the front of pdu data
+};
+
+// lifecycle engine
+// the handler of each action is found by (action & 0xffff) on lifecycle table.
+// handler returns the nugget which got the bit, or NULL if bit is not 
+// a part of any nugget (ex. plug, unplug)
+typedef struct dio_nugget*(*lifecycle_func)(struct bit_entity*);
+
+#define LC_PROPAGATE	1	//the event is given to the merged nuggets too
+#define LC_FINISH	2	//the event finishes the nugget
+struct lifecycle_entry{
+	char actc;
+	lifecycle_func handler;
+	int flags;
 };
 
 struct data_time
 {
-	unsigned int total_time;
-	unsigned int count;
-	unsigned int average_time;
+	uint64_t total_time;
+	uint64_t count;
+	uint64_t average_time;
+
+	uint64_t min_time;
+	uint64_t max_time;
 
-	unsigned int min_time;
-	unsigned int max_time;
+	struct dio_hist* hist;	//latency histogram, allocated at the first time
 };
 
 struct dio_nugget_path
 {
 	struct list_head link;
 
+	int pathid;
 	int elemidx;
 	char states[MAX_ELEMENT_SIZE];
 
 	struct data_time data_time_read;
 	struct data_time data_time_write;
 
-	struct data_time* data_time_interval_read;
-	struct data_time* data_time_interval_write;
+	struct data_time data_time_interval_read[MAX_ELEMENT_SIZE];
+	struct data_time data_time_interval_write[MAX_ELEMENT_SIZE];
 };
 
 struct dio_cpu
@@ -127,26 +124,81 @@ struct dio_cpu
 	int w_cnt;
 };
 
-// statistic initialize function.
-typedef void(*statistic_init_func)(void);
+struct dio_cpu_time
+{
+	struct data_time data_time_read;
+	struct data_time data_time_write;
+};
+
+// classes of requests by their category bits (see blktrace_api.h).
+// a request can be in several classes, and 'Plain' has none of them
+#define NR_CLASSES	7
+#define CLASS_PLAIN	(NR_CLASSES - 1)
+#define CLASS_MASK	(BLK_TC_FLUSH | BLK_TC_FUA | BLK_TC_SYNC | BLK_TC_DISCARD |\
+			BLK_TC_META | BLK_TC_AHEAD)
+static const struct{
+	const char* name;
+	uint32_t mask;
+} class_table[NR_CLASSES] = {
+	{ "Flush",	BLK_TC_FLUSH },
+	{ "FUA",	BLK_TC_FUA },
+	{ "Sync",	BLK_TC_SYNC },
+	{ "Discard",	BLK_TC_DISCARD },
+	{ "Meta",	BLK_TC_META },
+	{ "Ahead",	BLK_TC_AHEAD },
+	{ "Plain",	0 },
+};
+
+struct dio_class_time
+{
+	struct data_time data_time_read;
+	struct data_time data_time_write;
+	uint64_t bytes_read;
+	uint64_t bytes_write;
+};
+
+// statistic data of a worker thread.
+// each worker fills its own shard from its partition of data, and shards
+// are merged into the first shard in order of partitions at the end.
+// so the result is the same as single thread.
+struct stat_shard
+{
+	//type statistic
+	int r_cnt;
+	int w_cnt;
+	int x_cnt;
+	int class_cnt[NR_CLASSES];	//bits of each class
+
+	//path statistic
+	struct list_head nugget_path_head;	//paths in order of first appearance
+	struct dio_nugget_path** paths;		//paths indexed by path id
+	int paths_size;
 
-// statistic traveling function. 
-// rb traveling function will be given the each nugget as a parameter
-typedef void(*statistic_travel_func)(struct dio_nugget*);
+	//pid statistic
+	struct rb_root psd_root;
 
-// statistic iterating function.
-// list iterating function will be given the each bit as a parameter
-typedef void(*statistic_itr_func)(struct blk_io_trace*);
+	//cpu statistic
+	struct dio_cpu* diocpu;
+	int maxCPU;
+	struct dio_cpu_time* cputime;
+	int maxCPUTime;
 
-// data process function.
-typedef void(*statistic_process_func)(int);
+	//class statistic
+	struct dio_class_time classtime[NR_CLASSES];
 
-#define MAX_STATISTIC_FUNCTION 10
+	//stack statistic, indexed by device index of nugget key
+	struct dio_stack_dev* stackdev;
+	int nr_stackdev;
+};
+
+#define MAX_PERCENTILES 8
+#define DEFAULT_PERCENTILES "50,99,99.9"
 
 /*--------------	function interfaces	-----------------------*/
 /* function for option handling */
 bool parse_args(int argc, char** argv);
 void check_stat_opt(char *str);
+bool parse_percentiles(char* str);
 
 /* function for bit list */
 // insert bit_entity data into rbiten_head order by time
@@ -155,126 +207,581 @@ static void insert_proper_pos(struct bit_entity* pbiten);
 /* function for rbentity */
 //initialize dio_rbentity
 static void init_rbentity(struct dio_rbentity* prben);
-static struct dio_rbentity* rb_search_entity(uint64_t sector);
-static struct dio_rbentity* rb_search_end(uint64_t sec_t);
+static struct dio_rbentity* rb_search_entity(uint64_t key);
 static struct dio_rbentity* __rb_insert_entity(struct dio_rbentity* prben);
 static struct dio_rbentity* rb_insert_entity(struct dio_rbentity* prben);
 
 /* function for nugget */
 static void init_nugget(struct dio_nugget* pdng);
-static void copy_nugget(struct dio_nugget* destng, struct dio_nugget* srcng);
-static struct dio_nugget* FRONT_NUGGET(struct list_head* png_head);
 
-// it return a valid nugget point even if inserted 'sector' doesn't existed in rbtree
+// nuggets are found by the key of device and sector (see DEV_KEY)
+// it return a valid nugget point even if inserted 'key' doesn't existed in rbtree
 // if NULL value is returned, reason is a problem of inserting the new rbentity 
 // or memory allocating the new nugget 
-static struct dio_nugget* get_nugget_at(uint64_t sector);
+static struct dio_nugget* get_nugget_at(uint64_t key);
 
 // create active nugget on rbtree
-// if there isn't rbentity of sector number 'sector', than it create rbentity automatically
+// if there isn't rbentity of key 'key', than it create rbentity automatically
 // and return the pointer of created nugget
-static struct dio_nugget* create_nugget_at(uint64_t sector);
-
-// delete active nugget from rbtree
-static void delete_nugget_at(uint64_t sector);
-
-static void extract_nugget(struct blk_io_trace* pbit, struct dio_nugget* pdngbuf);
-static void handle_action(uint32_t act, struct dio_nugget* pdng);
-
-// add the statistic callback functions
-static void add_nugget_stat_func(statistic_init_func stat_init_fn, 
-					statistic_travel_func stat_trv_fn,
-					statistic_process_func stat_proc_fn);
-static void add_bit_stat_func(statistic_init_func stat_init_fn,
-					statistic_itr_func stat_itr_fn,
-					statistic_process_func stat_proc_fn);
-
-// traveling the rb tree with execution the added statistic functions
+static struct dio_nugget* create_nugget_at(uint64_t key);
+
+// move the nugget to the rbentity of 'key' (front merge, remap)
+static bool move_nugget_to(struct dio_nugget* pdng, uint64_t key);
+
+// return the index of device on the key, it's registered at the first time
+static int device_index(uint32_t device);
+// return the index of device if it's registered, or -1
+static int find_device(uint32_t device);
+static inline uint64_t bit_key(struct blk_io_trace* pbit);
+
+/* function for active nugget index */
+// active nuggets are found by sector on hash table, and by sector range
+// on interval tree. index_nugget() should be called again if the sector
+// range of nugget is changed.
+static void index_nugget(struct dio_nugget* pdng);
+static void unindex_nugget(struct dio_nugget* pdng);
+
+// search the active nugget which ends at 'key' (back merge target)
+static struct dio_nugget* search_backmerge_nugget(uint64_t key);
+// search the active nugget which starts at 'key' (front merge target)
+static struct dio_nugget* search_active_nugget(uint64_t key);
+
+// record the state of bit on the nugget
+static void extract_nugget(struct blk_io_trace* pbit, char actc, struct dio_nugget* pdngbuf);
+
+// failed requests are kept out of the latency statistics, because the
+// retries after errors look like huge latency. error statistic reports them
+static inline bool is_failed_nugget(struct dio_nugget* pdng);
+
+/* function for path trie */
+// return the id of path which is 'pathid' followed by 'actc'.
+// return -1 if it couldn't be interned
+static int path_trie_child(int pathid, char actc);
+
+/* function for lifecycle engine */
+// give the bit to its lifecycle handler and return the nugget which got it
+static struct dio_nugget* handle_bit(struct bit_entity* pbiten);
+// give the event of nugget to statistic event callbacks
+static inline void run_evt_fns(struct dio_nugget* pdng, char actc, uint64_t time);
+static void link_merged_nugget(struct dio_nugget* parent, struct dio_nugget* child, int ngflag);
+
+static struct dio_nugget* lc_append(struct bit_entity* pbiten);
+static struct dio_nugget* lc_queue(struct bit_entity* pbiten);
+static struct dio_nugget* lc_backmerge(struct bit_entity* pbiten);
+static struct dio_nugget* lc_frontmerge(struct bit_entity* pbiten);
+static struct dio_nugget* lc_split(struct bit_entity* pbiten);
+static struct dio_nugget* lc_remap(struct bit_entity* pbiten);
+// give the latency of completed nugget to the nugget of upper device
+static void complete_lower_nugget(struct dio_nugget* pdng);
+
+/* function for input files */
+// open all input files. return false on error
+static bool open_inputs(void);
+static void close_inputs(void);
+// read the oldest bit of input files into *ppbiten. the bit entity can be
+// swapped with the one which is kept on the input.
+// return 1 if a bit is read, 0 if all files are at the end, -1 on error
+static int read_inputs(struct bit_entity** ppbiten);
+// read the files again which were at the end (follow mode)
+static void rewind_inputs(void);
+
+/* function for decode stage */
+// read the bits and give the filtered bits to 'consume'
+// return false on error
+static bool decode_bits(void (*consume)(struct bit_entity*));
+// filter the bits of batch and give the matched bits to 'consume'.
+// the unmatched bits are kept on 'spare' to be reused
+static void consume_batch(struct bit_entity** batch, int nr, struct bit_entity** spare, int* nr_spare,
+	void (*consume)(struct bit_entity*));
+// run decode_bits() on a decode thread and consume the bits on this thread
+static bool decode_bits_parallel(void (*consume)(struct bit_entity*));
+static void consume_bit(struct bit_entity* pbiten);
+// write all bits of reader into the columnar file. return false on error
+static bool convert_bits(struct dio_reader* prd, const char* path);
+// keep the command name of process notify bit
+static void record_comm(struct blk_io_trace* pbit, const char* pdu);
+// return the command name of pid, or NULL if it is unknown
+static const char* lookup_comm(uint32_t pid);
+
+/* function for statistic registry */
+// load the statistic module and call its init function
+static bool load_stat_module(const char* path);
+
+// build the callback arrays of each pass from the registered statistics.
+// it should be called after all statistics are registered
+static bool statistic_prepare();
+
+// run the lifecycle engine and the bit statistics on one pass over bit list
+static void statistic_bit_pass();
+
+// traveling the rb tree with execution the nugget statistics
 static void statistic_rb_traveling();
 
-// statistic for each list entity
-static void statistic_list_for_each();
+// call the init, process functions of all statistics
+static void statistic_init_all();
+static void statistic_process_all(int bit_cnt, int ng_cnt);
+
+/* function for stream mode */
+// push the bit into reorder window and process the bits which are out of window
+static void stream_push_bit(struct bit_entity* pbiten);
+// process the bits in reorder window which are not later than 'time'
+static void stream_process_until(uint64_t time);
+// follow mode ages the reorder window by wall clock while the input is idle
+static void stream_idle(void);
+// process the all remained bits and nuggets at the end of trace
+static void stream_finish();
+static void stream_process_bit(struct bit_entity* pbiten);
+// hand the nugget to statistic callbacks and free it
+static void retire_nugget(struct dio_nugget* pdng);
+// free the nugget which was not completed within evict timeout
+static void evict_stale_nuggets(uint64_t now);
+static void free_nugget(struct dio_nugget* pdng);
+
+// data_time functions
+static void init_data_time(struct data_time* pdata_time);
+static void add_data_time(struct data_time* pdata_time, uint64_t time);
+// src is merged into dst. histogram of src is moved or freed
+static void merge_data_time(struct data_time* dst, struct data_time* src);
+// calculate the average time and fix up the min time
+static void finish_data_time(struct data_time* pdata_time);
+static void clear_data_time(struct data_time* pdata_time);
 
 // print functions
+void print_data_time_header(FILE* stream);
 void print_data_time_statistic(FILE* stream, struct data_time* pdata_time);
 
-void print_time();
-void print_sector();
+void print_time(struct blk_io_trace* pbit);
+void print_sector(struct dio_nugget* pdng);
+
+// exporters of bits and nuggets (-x csv, jsonl)
+void init_export_time(void);
+void export_time(struct blk_io_trace* pbit);
+void init_export_sector(void);
+void export_sector(struct dio_nugget* pdng);
+
+// statistic shard functions
+static void init_stat_shard(struct stat_shard* pshard);
+static void merge_stat_shards(bool is_bit);
 
 // disk I/O type statistic (just count)
 void init_type_statistic();
-void itr_type_statistic(struct blk_io_trace* pbit);
+void batch_type_statistic(const struct dio_bit_batch* pbat);
 void process_type_statistic(int bit_cnt);
+void merge_type_statistic(struct stat_shard* dst, struct stat_shard* src);
 
 // path statistic functions
 int instr(const char* str1, const char* str2);
-struct dio_nugget_path* find_nugget_path(struct list_head* nugget_path_head, char* states);
+static struct dio_nugget_path** path_slot(struct stat_shard* pshard, int pathid);
 void init_path_statistic(void);
 void travel_path_statistic(struct dio_nugget* pdng);
 void process_path_statistic(int ng_cnt);
+void merge_path_statistic(struct stat_shard* dst, struct stat_shard* src);
 void print_path_statistic_graphic(struct dio_nugget_path* pnugget_path);
 void print_path_statistic_text(struct dio_nugget_path* pnugget_path);
 
 // cpu statistic functions
-void create_diocpu(void);
+void create_diocpu(struct stat_shard* pshard);
 void init_cpu_statistic(void);
-void itr_cpu_statistic(struct blk_io_trace* pbit);
+void batch_cpu_statistic(const struct dio_bit_batch* pbat);
 void process_cpu_statistic(int bit_cnt);
+void merge_cpu_statistic(struct stat_shard* dst, struct stat_shard* src);
 void print_cpu_statistic_graphic(void);
 void print_cpu_statistic_text(int bit_cnt);
+void create_cputime(struct stat_shard* pshard, int cpu);
+void travel_cpu_time_statistic(struct dio_nugget* pdng);
+void process_cpu_time_statistic(int ng_cnt);
+void merge_cpu_time_statistic(struct stat_shard* dst, struct stat_shard* src);
 
 // pid statistic functions
 struct pid_stat_data{
 	struct rb_node link;
 
 	uint32_t pid;
+	unsigned int nr_pids;	//count of pids grouped into this (see -c)
         struct data_time data_time_read;
         struct data_time data_time_write;
 };
-static struct rb_root psd_root = RB_ROOT;	//pid stat data root
 
-static struct pid_stat_data* rb_search_psd(uint32_t pid);
-static struct pid_stat_data* __rb_insert_psd(struct pid_stat_data* newpsd);
-static struct pid_stat_data* rb_insert_psd(struct pid_stat_data* newpsd);
+static struct pid_stat_data* rb_search_psd(struct rb_root* root, uint32_t pid);
+static struct pid_stat_data* __rb_insert_psd(struct rb_root* root, struct pid_stat_data* newpsd);
+static struct pid_stat_data* rb_insert_psd(struct rb_root* root, struct pid_stat_data* newpsd);
 static void __clear_pid_stat(struct rb_node* p);
 void init_pid_statistic();
 void travel_pid_statistic(struct dio_nugget* pdng);
 void process_pid_statistic(int ng_cnt);
-void print_pid_statistic_graphic(struct pid_stat_data* ppsd);
-void print_pid_statistic_text(struct pid_stat_data* ppsd);
+void merge_pid_statistic(struct stat_shard* dst, struct stat_shard* src);
+void print_pid_statistic_graphic(const char* name, struct pid_stat_data* ppsd);
+void print_pid_statistic_text(const char* name, const char* comm, struct pid_stat_data* ppsd);
+// fold the pid stats of same command name into a group of its first pid
+static void group_pid_statistic(struct rb_root* root);
+
+// series statistic functions
+// completed requests are accumulated on the ring of interval buckets.
+// the oldest bucket is closed into a row when an event goes over the ring.
+#define DEFAULT_SERIES_INTERVAL 100	/* in milliseconds */
+#define SERIES_RING_SIZE 64
+struct series_bucket{
+	uint64_t ios[2];	//read, write
+	uint64_t bytes[2];
+	uint64_t total_time;
+	struct dio_hist* hist;
+};
+
+struct series_row{
+	uint64_t ios[2];
+	uint64_t bytes[2];
+	uint64_t total_time;
+	uint64_t pct_time[MAX_PERCENTILES];
+};
+
+void init_series_statistic(void);
+void event_series_statistic(struct dio_nugget* pdng, char actc, uint64_t time);
+void process_series_statistic(int ng_cnt);
+static void close_series_bucket(void);
+static struct series_row* series_row_at(uint64_t idx);
+
+// queue depth statistic functions
+// queued requests are counted from Q to C, and in-flight requests are
+// counted from D to C (or R) of request. the time spent on each depth
+// is accumulated on log2 depth ranges.
+#define QD_HIST_SIZE 9		/* 0, 1, 2-3, 4-7, ... , 128- */
+struct qd_track{
+	int depth;
+	int max_depth;
+	uint64_t last_time;
+	uint64_t area;			//sum of depth * time
+	uint64_t hist[QD_HIST_SIZE];	//time spent on each depth range
+};
+
+struct qd_data{
+	uint32_t pid;
+	struct qd_track queued;
+	struct qd_track inflight;
+};
+
+void init_depth_statistic(void);
+void event_depth_statistic(struct dio_nugget* pdng, char actc, uint64_t time);
+void process_depth_statistic(int ng_cnt);
+static struct qd_data* get_qd_data(uint32_t pid);
+static void update_qd_track(struct qd_track* ptrack, uint64_t time, int delta);
+static void print_qd_track(const char* name, const char* type, struct qd_track* ptrack);
+
+// follow statistic functions
+// requests completed since the last report are kept on follow window
+struct follow_window{
+	uint64_t ios[2];	//read, write
+	uint64_t bytes[2];
+	uint64_t start_time;	//trace time of the last report
+	uint64_t last_time;	//trace time of the last completion
+	uint64_t print_time;	//time of the last printed window
+	struct data_time latency;
+};
+
+void init_follow_statistic(void);
+void event_follow_statistic(struct dio_nugget* pdng, char actc, uint64_t time);
+void process_follow_statistic(int ng_cnt);
+// print the window if interval is passed. 'idle' waits for the new bits
+static void follow_tick(bool idle);
+static uint64_t follow_clock(void);
+static void follow_signal(int sig);
+static void report_follow_window(void);
+
+// top statistic functions
+// top view is a follow mode which redraws the dashboard of the last interval.
+// pids are counted on the fixed table, and the pids over it are counted on
+// 'other' slot. so memory is not grown with the count of pids.
+#define TOP_MAX_PIDS	128
+#define TOP_MAX_CPUS	128	/* same as the limit of idxCPU */
+#define TOP_ROWS	20
+struct top_pid{
+	uint32_t pid;
+	bool used;
+	uint64_t ios[2];	//read, write
+	uint64_t bytes[2];
+	struct dio_hist latency;
+};
+
+struct top_view{
+	struct top_pid pids[TOP_MAX_PIDS+1];	//the last one is 'other'
+	int nr_pids;
+	uint64_t submit[TOP_MAX_CPUS];		//Q of each cpu
+	uint64_t complete[TOP_MAX_CPUS];	//C of each cpu
+	struct qd_track queued;		//depth is kept across the windows
+	struct qd_track inflight;
+	uint64_t start_time;	//trace time of the last report
+	uint64_t last_time;	//trace time of the last event
+	uint64_t print_time;	//time of the last drawn view
+	uint64_t nr_events;	//events since the last report
+};
+
+void init_top_statistic(void);
+void event_top_statistic(struct dio_nugget* pdng, char actc, uint64_t time);
+void process_top_statistic(int ng_cnt);
+static void report_top_view(void);
+
+// lba statistic functions
+// requests are counted on the heatmap of (time interval, LBA region) at Q.
+// and each pid is checked whether its next request starts at the end of
+// previous one (sequential) or how far it seeks.
+#define DEFAULT_LBA_REGION 1024		/* in MB */
+#define SEEK_HIST_SIZE 7		/* 0, <4K, <64K, <1M, <128M, <1G, 1G- */
+struct lba_row{
+	uint32_t* cells;	//count of requests per region
+	int ncell;
+};
+
+struct lba_seq{
+	uint32_t pid;
+	bool has_prev;
+	uint64_t next_sector;	//end of previous request
+	uint64_t ios;
+	uint64_t seq_ios;
+	uint64_t streams;	//runs of sequential requests
+	uint64_t run;		//length of current run
+	uint64_t seek_hist[SEEK_HIST_SIZE];
+};
+
+void init_lba_statistic(void);
+void event_lba_statistic(struct dio_nugget* pdng, char actc, uint64_t time);
+void process_lba_statistic(int ng_cnt);
+static void update_lba_seq(struct lba_seq* pseq, uint64_t sector, int size);
+static void print_lba_seq(const char* name, struct lba_seq* pseq);
+
+// stack statistic functions
+// the latency of requests on each device, and the latency which is added by
+// the device over its lower devices (dm, md). a request which is remapped
+// to several lower devices waits the longest one of them.
+struct dio_stack_dev{
+	struct data_time latency;	//completed requests of the device
+	struct data_time lower;		//latency of lower devices of the remapped requests
+	struct data_time added;		//latency - lower
+};
+
+void create_stackdev(struct stat_shard* pshard, int idx);
+void init_stack_statistic(void);
+void travel_stack_statistic(struct dio_nugget* pdng);
+void process_stack_statistic(int ng_cnt);
+void merge_stack_statistic(struct stat_shard* dst, struct stat_shard* src);
+
+// class statistic functions
+// count, bytes and latency of requests of each class (flush, fua, ...)
+void init_class_time(struct stat_shard* pshard);
+void travel_class_statistic(struct dio_nugget* pdng);
+void process_class_statistic(int ng_cnt);
+void merge_class_statistic(struct stat_shard* dst, struct stat_shard* src);
+
+// error statistic functions
+// failed requests are counted at their completion by errno, pid,
+// lba region (-R) and time interval (-I)
+#define INIT_ERR_HASH_SIZE 64
+#define ERR_BY_ERRNO	0
+#define ERR_BY_PID	1
+#define ERR_BY_REGION	2
+#define ERR_BY_TIME	3
+#define NR_ERR_GROUPS	4
+struct err_count{
+	uint64_t key;
+	uint64_t ios;
+	uint64_t bytes;
+	struct data_time latency;	//time until the failure, only by errno
+};
+
+void init_error_statistic(void);
+void event_error_statistic(struct dio_nugget* pdng, char actc, uint64_t time);
+void process_error_statistic(int ng_cnt);
+static struct err_count* get_err_count(int group, uint64_t key);
 
 /*--------------	global variables	-----------------------*/
 #define MAX_FILEPATH_LEN 255
 #define PRINT_TYPE_TIME 0
 #define PRINT_TYPE_SECTOR 1
 
-static char respath[MAX_FILEPATH_LEN];	//result file path
+#define DEFAULT_INPUT "dioshark.output"
+static char convpath[MAX_FILEPATH_LEN];	//columnar file path to be converted into
+static bool is_resync;			//skip the damaged bytes of input
+
+// several input files are read as one stream of bits in time order.
+// each input keeps its next bit, and the oldest one of them is given first
+#define MAX_INPUTS 32
+struct input{
+	struct dio_reader reader;
+	struct bit_entity* next;	//the next bit of file
+	bool has_next;
+	bool is_eof;
+};
+static char* input_paths[MAX_INPUTS];	//result files of dio-shark
+static int nr_inputs = 0;
+static struct input inputs[MAX_INPUTS];
 static int print_type;
 static FILE *output;
+static struct dio_fmtbuf fmtbuf;	//buffer of printed bits and nuggets on output
+#define EXPORT_TYPE_TEXT 0
+#define EXPORT_TYPE_CSV 1
+#define EXPORT_TYPE_JSONL 2
+static int export_type;			//format of printed bits and nuggets
 static uint64_t time_start;		/* in nanoseconds */
 static uint64_t time_end;
 static uint64_t sector_start;
 static uint64_t sector_end;
 static uint64_t filter_pid;
+static struct dio_filter bit_filter;	//-F, -T, -S and -P are compiled into it
+#define FILTER_BATCH_SIZE 64		/* bits are filtered as a batch of it */
 static bool is_graphic;
 static bool is_path;
 static bool is_pid;
+static bool is_series;
+static bool is_depth;
+static bool is_lba;
+static bool is_stack;
+static bool is_class;
+static bool is_error;
+static bool is_group_comm;
+static uint64_t lba_region;		/* in sectors */
+static uint64_t series_interval;	/* in nanoseconds */
 static bool is_cpu;
+static bool is_stream;
+static uint64_t evict_timeout;		/* in nanoseconds */
+
+static double percentiles[MAX_PERCENTILES];	//percentiles of latency to print
+static int nr_percentiles;
 
 
 static struct rb_root rben_root;	//root of rbentity tree
 static struct list_head biten_head;
 
-static statistic_init_func stat_init_fns[MAX_STATISTIC_FUNCTION];
-static statistic_travel_func stat_trv_fns[MAX_STATISTIC_FUNCTION];
-static statistic_itr_func stat_itr_fns[MAX_STATISTIC_FUNCTION];
-static statistic_process_func stat_proc_fns[MAX_STATISTIC_FUNCTION];
-static int stat_fn_cnt = 0;		//statistic callback functions iterated on tree
-static int stat_fn_list_cnt = 0;	//statistic callback functions iterated on list.
-					//callback function for list is filled from the 
-					//last index of callback table
+#define INIT_ACTNG_HASH_SIZE 1024
+static struct dio_hash actng_hash;	//active nuggets by key
+static struct rb_root actng_itree;	//active nuggets by key range
+
+// the traces of several devices are handled together, so nuggets are indexed
+// by the key of device and sector. the device is given a small index on
+// the upper bits of key, and the sectors of a device keep their order.
+#define MAX_DEVICES	256
+#define DEV_KEY_SHIFT	56
+#define DEV_KEY(idx, sector)	(((uint64_t)(idx) << DEV_KEY_SHIFT) | ((sector) & KEY_SECTOR_MASK))
+#define KEY_SECTOR_MASK	((1ULL << DEV_KEY_SHIFT) - 1)
+#define KEY_SECTOR(key)	((key) & KEY_SECTOR_MASK)
+#define KEY_DEVICE(key)	(devices[(key) >> DEV_KEY_SHIFT])
+static uint32_t devices[MAX_DEVICES];	//devices by index
+static int device_uppers[MAX_DEVICES];	//index of the upper device, -1 on the top
+static int nr_devices = 0;		//not over MAX_DEVICES
+static bool is_device_overflow = false;	//devices over MAX_DEVICES are the last one
+
+// path trie interns the states of nuggets as integer path id.
+// a node is the path from root, and the child of node for a state is found
+// on hash table by (node id, state). node 0 is the empty path.
+#define INIT_PATH_TRIE_SIZE 256
+#define PATH_TRIE_KEY(id, actc)	(((uint64_t)(id) << 8) | (unsigned char)(actc))
+static struct dio_hash path_trie;
+static int path_node_cnt = 1;
+
+static int biten_cnt = 0;		//count of bits on biten_head (batch mode)
+
+// command names of pids from process notify bits.
+// it is filled by the consumer of decoded bits, before the later bits
+#define INIT_COMM_HASH_SIZE 64
+#define MAX_COMM_SIZE MAX_PDU_SIZE
+static struct dio_hash comm_hash;	//command name by pid
+
+// registered statistics in order of registration
+#define INIT_STAT_OPS_SIZE 8
+static struct dio_stat_ops* stat_ops = NULL;
+static int stat_ops_cnt = 0;
+static int stat_ops_size = 0;
+
+// callbacks of a pass, without NULL entries.
+// 'all' has every callback in order of registration for single thread,
+// 'seq' has the callbacks which run on main thread (no merge function) and
+// 'par' has the callbacks which run on the workers.
+struct stat_pass{
+	statistic_itr_func* itr;
+	int itr_cnt;
+	statistic_batch_func* bat;
+	int bat_cnt;
+	statistic_travel_func* trv;
+	int trv_cnt;
+	statistic_event_func* evt;
+	int evt_cnt;
+};
+static struct stat_pass pass_all, pass_seq, pass_par;
+
+// bits are gathered for batch functions on each thread, and the batch is
+// given when it's full or at the end of pass
+#define STAT_BATCH_SIZE 64
+struct stat_batch{
+	struct blk_io_trace bits[STAT_BATCH_SIZE];
+	uint32_t action[STAT_BATCH_SIZE];
+	uint32_t cpu[STAT_BATCH_SIZE];
+	int nr;
+};
+static struct stat_batch main_batch;	//batch of main thread
+
+#define MAX_STAT_MODULES 16
+static char* stat_modules[MAX_STAT_MODULES];	//paths of statistic modules
+static int stat_module_cnt = 0;
+
+// stream mode keeps only the bits in reorder window and the active nuggets.
+// bits are processed when they get older than the newest bit by reorder window,
+// because the bits of each cpu are not written in time order.
+#define STREAM_REORDER_WINDOW	1000000000ULL	/* 1 second */
+#define DEFAULT_EVICT_TIMEOUT	30000		/* in milliseconds */
+static struct list_head actng_head;	//active nuggets ordered by recent update time
+					//merged nuggets are not on it, they follow their mlink
+static uint64_t stream_newest_time;
+static int stream_bit_cnt = 0;
+static int stream_ng_cnt = 0;
+static int stream_evict_cnt = 0;
+static uint64_t stream_idle_newest;	//newest time when the input got idle
+static uint64_t stream_idle_since;	//wall clock of it
+
+// follow mode waits for the bits which are being written at the end of file,
+// and prints the requests completed in each interval until SIGINT.
+#define FOLLOW_POLL_MSEC	100
+#define FOLLOW_CHECK_BITS	1024	/* clock is checked every this bits */
+static bool is_follow;
+static uint64_t follow_interval;	/* in nanoseconds of wall clock */
+static volatile sig_atomic_t follow_stop = 0;
+static void (*follow_report)(void) = report_follow_window;
+
+// top view is run as diotop or with '-t'
+#define DEFAULT_TOP_INTERVAL 1000
+static bool is_top;
+
+// worker threads of the statistic stage. 
+// main thread works on the first shard
+#define MAX_JOBS 64
+static int nr_jobs;
+static struct stat_shard shards[MAX_JOBS];
+static __thread struct stat_shard* cur_shard = &shards[0];
+
+struct stat_worker{
+	pthread_t td;
+	struct stat_shard* shard;
+
+	struct list_head* first;	//the first bit of partition
+	int bit_cnt;
+	struct dio_rbentity** prbens;	//rbentities of partition
+	int rben_cnt;
+	int ng_cnt;
+};
 
-#define ARG_OPTS "i:o:p:T:S:P:s:g:h"
+// decode thread gives the bits to main thread in batch.
+// decode thread waits if the queue is full, so the memory is bounded
+#define DECODE_BATCH_SIZE 4096
+#define DECODE_MAX_QUEUED 8
+struct decode_batch{
+	struct list_head link;
+	struct list_head bits;
+};
+static struct list_head decode_queue;
+static int decode_queued;
+static pthread_mutex_t decode_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t decode_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t decode_space_cond = PTHREAD_COND_INITIALIZER;
+static bool decode_done;
+static bool decode_failed;
+
+#define ARG_OPTS "i:o:C:kp:x:T:S:P:F:s:cgrf:te:j:l:q:I:R:h"
 static struct option arg_opts[] = {
 	{	
 		.name = "resfile",
@@ -324,6 +831,90 @@ static struct option arg_opts[] = {
 		.flag = NULL,
 		.val = 'g'
 	},
+	{
+		.name = "stream",
+		.has_arg = no_argument,
+		.flag = NULL,
+		.val = 'r'
+	},
+	{
+		.name = "evict",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'e'
+	},
+	{
+		.name = "jobs",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'j'
+	},
+	{
+		.name = "load",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'l'
+	},
+	{
+		.name = "percentile",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'q'
+	},
+	{
+		.name = "interval",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'I'
+	},
+	{
+		.name = "region",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'R'
+	},
+	{
+		.name = "comm",
+		.has_arg = no_argument,
+		.flag = NULL,
+		.val = 'c'
+	},
+	{
+		.name = "convert",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'C'
+	},
+	{
+		.name = "filter",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'F'
+	},
+	{
+		.name = "resync",
+		.has_arg = no_argument,
+		.flag = NULL,
+		.val = 'k'
+	},
+	{
+		.name = "export",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'x'
+	},
+	{
+		.name = "follow",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'f'
+	},
+	{
+		.name = "top",
+		.has_arg = no_argument,
+		.flag = NULL,
+		.val = 't'
+	},
 	{
 		.name = "help",
 		.has_arg = no_argument,
@@ -334,158 +925,662 @@ static struct option arg_opts[] = {
 
 static char opt_detail[] = "\n"\
 			"\t-i : The input file name which has the raw tracing data.\n"\
+			"\t     It can be compressed with gzip, zstd or lz4, and is decompressed by their command\n"\
+			"\t     on PATH while it's parsed. Only the files written by pzstd are decompressed\n"\
+			"\t     in parallel (if pzstd is installed), the others are decompressed on one thread.\n"\
+			"\t     It can be given several times (ex. the traces of stacked devices),\n"\
+			"\t     then the bits of the files are parsed together in time order.\n"\
 			"\t-o : The output file name of dioparse.\n"\
+			"\t-C : Convert the input file into columnar format file and exit.\n"\
+			"\t     The columnar file can be given to -i, and -T, -S and -P read only the blocks they need.\n"\
+			"\t-k : Resync mode. Damaged bytes of the input file are skipped to the next valid bit,\n"\
+			"\t     and reported on stderr.\n"\
 			"\t-p : Print option. It can have two suboptions \'sector\' , \'time\'\n"\
+			"\t-x : Format of -p. It can be \'text\'(default), \'csv\' or \'jsonl\'\n"\
 			"\t-T : Time filter option\n"\
 			"\t-S : Sector filter option\n"\
 			"\t-P : Pid filter option\n"\
-			"\t-s : Statistic option. It can have three suboptions \'path\', \'pid\' and \'cpu\'\n"\
-			"\t-g : Show statistic results graphically.\n\n";
+			"\t-F : Filter expression. ex) 'pid in {12,34} && bytes >= 64k && action == D && time in [1.5s, 3.2s]'\n"\
+			"\t     Fields are time, sector, bytes, pid, cpu, device, error, action and rw (see dio_filter.h).\n"\
+			"\t-s : Statistic option. It can have suboptions \'path\', \'pid\', \'cpu\', \'series\', \'depth\', \'lba\', \'stack\'\n"\
+			"\t     \'class\' and \'error\'. 'class' shows the requests of each class (flush, fua, sync, discard, meta, readahead).\n"\
+			"\t     'error' shows the failed requests by errno, pid, region and interval.\n"\
+			"\t     Failed requests are not counted on the latency of the other statistics.\n"\
+			"\t     'stack' shows the latency which each device of stack (dm, md) adds over its lower devices.\n"\
+			"\t-c : Group the \'pid\' statistic by command name\n"\
+			"\t-g : Show statistic results graphically.\n"\
+			"\t-r : Stream mode. Nuggets are given to statistics as soon as they are completed.\n"\
+			"\t     \'-p sector\' prints the nuggets in completion order on this mode.\n"\
+			"\t-e : Evict timeout of uncompleted nuggets in stream mode (msec, default 30000)\n"\
+			"\t-f : Follow mode. Wait for the bits written to the input file on stream mode, and print\n"\
+			"\t     the requests completed in each interval (msec). SIGINT stops and prints the statistics.\n"\
+			"\t     Bits are reordered within 1 second, so the requests are printed 1 second later\n"\
+			"\t     of trace time, or of wall clock when the input is idle.\n"\
+			"\t-t : Top view. Follow mode which redraws the top pids, cpus, queue depth and read/write mix\n"\
+			"\t     of each interval (default 1000 msec, or -f). It is the default of diotop.\n"\
+			"\t-j : Number of threads. Bits are decoded on a thread and statistics are\n"\
+			"\t     computed by the other threads. (default 1)\n"\
+			"\t-l : Load the statistic module (shared object). It can be given several times.\n"\
+			"\t-q : Percentiles of latency, separated by comma (default "DEFAULT_PERCENTILES")\n"\
+			"\t-I : Interval of \'series\', \'lba\' and \'error\' statistic (msec, default 100)\n"\
+			"\t-R : LBA region size of \'lba\' and \'error\' statistic (MB, default 1024)\n\n";
 
 /*--------------	function implementations	---------------*/
 int main(int argc, char** argv){
 	INIT_LIST_HEAD(&biten_head);
+	INIT_LIST_HEAD(&actng_head);
 	rben_root = RB_ROOT;
+	actng_itree = RB_ROOT;
+	if( !dio_hash_init(&actng_hash, INIT_ACTNG_HASH_SIZE) ||
+		!dio_hash_init(&path_trie, INIT_PATH_TRIE_SIZE) ||
+		!dio_hash_init(&comm_hash, INIT_COMM_HASH_SIZE) ){
+		perror("failed to allocate hash table");
+		return 0;
+	}
 
 	print_type = PRINT_TYPE_TIME;
+	export_type = EXPORT_TYPE_TEXT;
 	time_start = 0;
 	time_end = (uint64_t)(-1);
 	sector_start = 0;
 	sector_end = (uint64_t)(-1);
 	filter_pid = (uint64_t)(-1);
+	dio_filter_init(&bit_filter);
 	is_graphic = false;
 	is_path = false;
 	is_cpu = false;
 	is_pid = false;
+	is_series = false;
+	is_depth = false;
+	is_lba = false;
+	is_stack = false;
+	is_class = false;
+	is_error = false;
+	is_group_comm = false;
+	lba_region = (uint64_t)DEFAULT_LBA_REGION * 1024 * 1024 / 512;
+	series_interval = (uint64_t)DEFAULT_SERIES_INTERVAL * 1000000;
+	is_stream = false;
+	evict_timeout = (uint64_t)DEFAULT_EVICT_TIMEOUT * 1000000;
+	nr_jobs = 1;
+	is_follow = false;
+	is_top = false;
+	is_resync = false;
+
+	struct dio_col_filter filter;
+	char pctbuf[] = DEFAULT_PERCENTILES;
+	uint64_t skip_bytes = 0;
+	uint32_t nr_skips = 0;
+	bool ret = false;
+	int i = 0;
 
+	parse_percentiles(pctbuf);
+
+	parse_args(argc, argv);
+	if( nr_inputs == 0 )
+		input_paths[nr_inputs++] = DEFAULT_INPUT;
+	//the failures of input are given to the exit status for scripts
+	if( !open_inputs() )
+		return 1;
+
+	if( convpath[0] != '\0' ){
+		if( nr_inputs > 1 )
+			fprintf(stderr, "-C converts only one input file\n");
+		else{
+			ret = convert_bits(&inputs[0].reader, convpath);
+			if( !ret )
+				perror("failed to convert");
+		}
+		close_inputs();
+		return ret ? 0 : 1;
+	}
 
-	int ifd = -1;
-	int rdsz = 0;
-	char pdubuf[256];
+	//columnar file skips the blocks out of filter
+	filter.time_start = time_start;
+	filter.time_end = time_end;
+	filter.sector_start = sector_start;
+	filter.sector_end = sector_end;
+	filter.pid = filter_pid;
+	for(i=0; i<nr_inputs; i++)
+		dio_reader_set_filter(&inputs[i].reader, &filter);
 
-	strncpy(respath, "dioshark.output", MAX_FILEPATH_LEN);
+	for(i=0; i<nr_jobs; i++)
+		init_stat_shard(&shards[i]);
 
-	parse_args(argc, argv);
-	ifd = open(respath, O_RDONLY);
-	if( ifd < 0 ){
-		perror("failed to open result file");
-		goto err;
+	if(output==NULL) {
+		output = stdout;
+	}
+
+	if( !dio_fmt_open(&fmtbuf, output) ){
+		perror("failed to allocate memory");
+		return 0;
+	}
+
+	//printing is not sharded to keep the order
+	//top view is the only output of diotop
+	if(is_top) {
+	} else if(print_type == PRINT_TYPE_TIME) {
+		struct dio_stat_ops ops = { .name = "time", .itr = print_time };
+		if(export_type != EXPORT_TYPE_TEXT) {
+			ops.init = init_export_time;
+			ops.itr = export_time;
+		}
+		dio_register_statistic(&ops);
+	} else if(print_type == PRINT_TYPE_SECTOR) {
+		struct dio_stat_ops ops = { .name = "sector", .trv = print_sector };
+		if(export_type != EXPORT_TYPE_TEXT) {
+			ops.init = init_export_sector;
+			ops.trv = export_sector;
+		}
+		dio_register_statistic(&ops);
+	}
+
+	//statistics
+	struct dio_stat_ops type_ops = {
+		.name = "type",
+		.init = init_type_statistic,
+		.batch = batch_type_statistic,
+		.proc = process_type_statistic,
+		.merge = merge_type_statistic
+	};
+	//exported records are not mixed with the summary of types
+	if(export_type == EXPORT_TYPE_TEXT && !is_top)
+		dio_register_statistic(&type_ops);
+
+	if(is_path){
+		struct dio_stat_ops ops = {
+			.name = "path",
+			.init = init_path_statistic,
+			.trv = travel_path_statistic,
+			.proc = process_path_statistic,
+			.merge = merge_path_statistic
+		};
+		dio_register_statistic(&ops);
+	}
+	if(is_cpu){
+		struct dio_stat_ops ops = {
+			.name = "cpu",
+			.init = init_cpu_statistic,
+			.batch = batch_cpu_statistic,
+			.proc = process_cpu_statistic,
+			.merge = merge_cpu_statistic
+		};
+		struct dio_stat_ops time_ops = {
+			.name = "cpu latency",
+			.trv = travel_cpu_time_statistic,
+			.proc = process_cpu_time_statistic,
+			.merge = merge_cpu_time_statistic
+		};
+		dio_register_statistic(&ops);
+		dio_register_statistic(&time_ops);
+	}
+	if(is_pid){
+		struct dio_stat_ops ops = {
+			.name = "pid",
+			.init = init_pid_statistic,
+			.trv = travel_pid_statistic,
+			.proc = process_pid_statistic,
+			.merge = merge_pid_statistic
+		};
+		dio_register_statistic(&ops);
+	}
+
+	if(is_series){
+		struct dio_stat_ops ops = {
+			.name = "series",
+			.init = init_series_statistic,
+			.evt = event_series_statistic,
+			.proc = process_series_statistic
+		};
+		dio_register_statistic(&ops);
 	}
+
+	if(is_depth){
+		struct dio_stat_ops ops = {
+			.name = "depth",
+			.init = init_depth_statistic,
+			.evt = event_depth_statistic,
+			.proc = process_depth_statistic
+		};
+		dio_register_statistic(&ops);
+	}
+
+	if(is_follow){
+		struct dio_stat_ops ops = {
+			.name = "follow",
+			.init = init_follow_statistic,
+			.evt = event_follow_statistic,
+			.proc = process_follow_statistic
+		};
+		if(is_top){
+			ops.name = "top";
+			ops.init = init_top_statistic;
+			ops.evt = event_top_statistic;
+			ops.proc = process_top_statistic;
+			follow_report = report_top_view;
+		}
+		dio_register_statistic(&ops);
+		signal(SIGINT, follow_signal);
+		signal(SIGTERM, follow_signal);
+	}
+
+	if(is_lba){
+		struct dio_stat_ops ops = {
+			.name = "lba",
+			.init = init_lba_statistic,
+			.evt = event_lba_statistic,
+			.proc = process_lba_statistic
+		};
+		dio_register_statistic(&ops);
+	}
+
+	if(is_error){
+		struct dio_stat_ops ops = {
+			.name = "error",
+			.init = init_error_statistic,
+			.evt = event_error_statistic,
+			.proc = process_error_statistic
+		};
+		dio_register_statistic(&ops);
+	}
+
+	if(is_class){
+		struct dio_stat_ops ops = {
+			.name = "class",
+			.trv = travel_class_statistic,
+			.proc = process_class_statistic,
+			.merge = merge_class_statistic
+		};
+		dio_register_statistic(&ops);
+	}
+
+	if(is_stack){
+		struct dio_stat_ops ops = {
+			.name = "stack",
+			.init = init_stack_statistic,
+			.trv = travel_stack_statistic,
+			.proc = process_stack_statistic,
+			.merge = merge_stack_statistic
+		};
+		dio_register_statistic(&ops);
+	}
+
+	for(i=0; i<stat_module_cnt; i++){
+		if( !load_stat_module(stat_modules[i]) )
+			return 0;
+	}
+	if( !statistic_prepare() )
+		return 0;
+
+	statistic_init_all();
 	
+	//follow mode waits for the bits on the consumer thread
+	if( nr_jobs > 1 && !is_follow )
+		ret = decode_bits_parallel(consume_bit);
+	else
+		ret = decode_bits(consume_bit);
+	for(i=0; i<nr_inputs; i++){
+		nr_skips += inputs[i].reader.nr_skips;
+		skip_bytes += inputs[i].reader.skip_bytes;
+	}
+	close_inputs();
+	if( nr_skips > 0 )
+		fprintf(stderr, "resync : %u damaged ranges, %llu bytes are skipped\n",
+			nr_skips, (unsigned long long)skip_bytes);
+	if( !ret )
+		return 1;
+
+	if( is_stream ){
+		stream_finish();
+		goto out;
+	}
+
+	//build up the rbtree order by number of sector
+	statistic_bit_pass();
+	statistic_rb_traveling();
+
+out:
+	dio_fmt_close(&fmtbuf);
+
+	//clean all list entities
+	if(output!=stdout){
+		fclose(output);
+	}
+
+	return 0;
+}
+
+void consume_batch(struct bit_entity** batch, int nr, struct bit_entity** spare, int* nr_spare,
+	void (*consume)(struct bit_entity*)){
+	struct blk_io_trace* bits[FILTER_BATCH_SIZE] = { NULL };
+	bool match[FILTER_BATCH_SIZE];
+	int i;
+
+	for(i=0; i<nr; i++)
+		bits[i] = &batch[i]->bit;
+	dio_filter_batch(&bit_filter, bits, nr, match);
+
+	for(i=0; i<nr; i++){
+		//process names are kept for all pids, so they skip the filter
+		if( batch[i]->bit.action == BLK_TN_PROCESS ||
+			(match[i] && (batch[i]->bit.action >> BLK_TC_SHIFT) != BLK_TC_NOTIFY) )
+			consume(batch[i]);
+		else
+			spare[(*nr_spare)++] = batch[i];
+	}
+}
+
+bool open_inputs(){
+	int i;
+
+	for(i=0; i<nr_inputs; i++){
+		memset(&inputs[i], 0, sizeof(struct input));
+		if( !dio_reader_open(&inputs[i].reader, input_paths[i]) ){
+			fprintf(stderr, "failed to open %s : %s\n", input_paths[i], strerror(errno));
+			while( --i >= 0 )
+				dio_reader_close(&inputs[i].reader);
+			return false;
+		}
+		dio_reader_set_resync(&inputs[i].reader, is_resync);
+	}
+	return true;
+}
+
+void close_inputs(){
+	int i;
+
+	for(i=0; i<nr_inputs; i++){
+		dio_reader_close(&inputs[i].reader);
+		free(inputs[i].next);
+		inputs[i].next = NULL;
+	}
+}
+
+int read_inputs(struct bit_entity** ppbiten){
+	struct input* pin = NULL;
+	struct input* oldest = NULL;
+	struct bit_entity* tmp = NULL;
+	int i, ret;
+
+	//the front of pdu is kept for lifecycle handlers
+	if( nr_inputs == 1 )
+		return dio_reader_next(&inputs[0].reader, &(*ppbiten)->bit, (*ppbiten)->pdu, MAX_PDU_SIZE);
+
+	for(i=0; i<nr_inputs; i++){
+		pin = &inputs[i];
+		if( !pin->has_next && !pin->is_eof ){
+			if( pin->next == NULL ){
+				pin->next = (struct bit_entity*)malloc(sizeof(struct bit_entity));
+				if( pin->next == NULL )
+					return -1;
+			}
+			ret = dio_reader_next(&pin->reader, &pin->next->bit, pin->next->pdu, MAX_PDU_SIZE);
+			if( ret < 0 )
+				return -1;
+			pin->has_next = ret > 0;
+			pin->is_eof = ret == 0;
+		}
+		if( pin->has_next && (oldest == NULL || pin->next->bit.time < oldest->next->bit.time) )
+			oldest = pin;
+	}
+	if( oldest == NULL )
+		return 0;
+
+	tmp = *ppbiten;
+	*ppbiten = oldest->next;
+	oldest->next = tmp;
+	oldest->has_next = false;
+	return 1;
+}
+
+void rewind_inputs(){
+	int i;
+
+	for(i=0; i<nr_inputs; i++)
+		inputs[i].is_eof = false;
+}
+
+bool decode_bits(void (*consume)(struct bit_entity*)){
+	struct bit_entity* batch[FILTER_BATCH_SIZE];
+	struct bit_entity* spare[FILTER_BATCH_SIZE];
 	struct bit_entity* pbiten = NULL;
-	struct dio_nugget* pdng = NULL;
+	unsigned int cnt = 0;
+	int nr = 0, nr_spare = 0;
+	int ret = 0;
+	bool ok = true;
 
-	int i = 0;
 	while(1){
-		if( pbiten == NULL ){
+		if( nr_spare > 0 )
+			pbiten = spare[--nr_spare];
+		else{
 			pbiten = (struct bit_entity*)malloc(sizeof(struct bit_entity));
 			if( pbiten == NULL ){
 				perror("failed to allocate memory");
-				goto err;
+				ok = false;
+				break;
 			}
 		}
 
-		rdsz = read(ifd, &(pbiten->bit), sizeof(struct blk_io_trace));
-		if( rdsz < 0 ){
+		ret = read_inputs(&pbiten);
+		if( ret < 0 ){
 			perror("failed to read");
-			goto err;
+			spare[nr_spare++] = pbiten;
+			ok = false;
+			break;
 		}
-		else if( rdsz == 0 ){
+		else if( ret == 0 ){
+			spare[nr_spare++] = pbiten;
+
+			//the read bits are given before waiting
+			consume_batch(batch, nr, spare, &nr_spare, consume);
+			nr = 0;
+
+			//partial record at the end is kept on reader until it's written
+			if( is_follow && !follow_stop ){
+				stream_idle();
+				follow_tick(true);
+				rewind_inputs();
+				continue;
+			}
 			break;
 		}
 
-		//BE_TO_LE_BIT(pbiten->bit);
+		batch[nr++] = pbiten;
+		if( nr == FILTER_BATCH_SIZE ){
+			consume_batch(batch, nr, spare, &nr_spare, consume);
+			nr = 0;
+		}
 
-		//DBGOUT(">pdu_len : %d\n", pbiten->bit.pdu_len);
-		if( pbiten->bit.pdu_len > 0 ){
-			//rdsz = read(ifd, pdubuf, pbiten->bit.pdu_len);
-			//pdubuf[rdsz] = '\0';
-			//DBGOUT(">pdu data : %s\n", pdubuf);
-			lseek(ifd, pbiten->bit.pdu_len, SEEK_CUR);
+		//a file which was at the end can have new bits
+		if( is_follow && (++cnt % FOLLOW_CHECK_BITS) == 0 ){
+			follow_tick(false);
+			rewind_inputs();
 		}
-		
-		//filter
-		if( (time_start > pbiten->bit.time || time_end < pbiten->bit.time) ||
-			(sector_start > pbiten->bit.sector || sector_end < pbiten->bit.sector) )
-			continue;
-		if( filter_pid !=(uint64_t)(-1) && filter_pid != pbiten->bit.pid )
-			continue;
+	}
 
-		if( (pbiten->bit.action >> BLK_TC_SHIFT) == BLK_TC_NOTIFY )
-			continue;
-			
-		//insert into list order by time
-		insert_proper_pos(pbiten);
+	while( nr > 0 )
+		free(batch[--nr]);
+	while( nr_spare > 0 )
+		free(spare[--nr_spare]);
+	return ok;
+}
 
-		pbiten = NULL;
+bool convert_bits(struct dio_reader* prd, const char* path){
+	struct dio_col_writer writer;
+	struct blk_io_trace bit;
+	char* pdu = NULL;
+	int ret = 0;
+
+	//whole pdu is kept on columnar file
+	pdu = (char*)malloc(UINT16_MAX + 1);
+	if( pdu == NULL )
+		return false;
+	if( !dio_col_writer_open(&writer, path) ){
+		free(pdu);
+		return false;
 	}
 
-	//build up the rbtree order by number of sector
-	struct bit_entity* p = NULL;
-	uint64_t recentsect = 0;
-	list_for_each_entry(p, &biten_head, link){
-#if 0
-		if( p->bit.sector != 0 )
-			recentsect = p->bit.sector;
-#endif
-		
-		pdng = get_nugget_at(p->bit.sector);
+	while( (ret = dio_reader_next(prd, &bit, pdu, UINT16_MAX + 1)) > 0 ){
+		if( !dio_col_writer_add(&writer, &bit, pdu) )
+			break;
+	}
 
-		if( pdng == NULL ){
-			DBGOUT(">failed to get nugget at sector %llu\n", p->bit.sector);
-			goto err;
-		}
-		extract_nugget(&p->bit, pdng);
+	free(pdu);
+	if( !dio_col_writer_close(&writer) || ret != 0 )
+		return false;
+	return true;
+}
+
+void record_comm(struct blk_io_trace* pbit, const char* pdu){
+	char* comm = NULL;
+	int len = pbit->pdu_len < MAX_COMM_SIZE ? pbit->pdu_len : MAX_COMM_SIZE;
+
+	comm = (char*)malloc(MAX_COMM_SIZE + 1);
+	if( comm == NULL ){
+		perror("failed to allocate memory");
+		return;
 	}
+	memcpy(comm, pdu, len);
+	comm[len] = '\0';
 
+	//the pid can be reused by other process, so the last name is kept
+	free(dio_hash_remove(&comm_hash, pbit->pid));
+	if( comm[0] == '\0' || !dio_hash_insert(&comm_hash, pbit->pid, comm) )
+		free(comm);
+}
 
+const char* lookup_comm(uint32_t pid){
+	return (const char*)dio_hash_lookup(&comm_hash, pid);
+}
 
-	if(output==NULL) {
-		output = stdout;
+void consume_bit(struct bit_entity* pbiten){
+	if( pbiten->bit.action == BLK_TN_PROCESS ){
+		record_comm(&pbiten->bit, pbiten->pdu);
+		free(pbiten);
+		return;
 	}
 
-	if(print_type == PRINT_TYPE_TIME) {
-		add_bit_stat_func(NULL, NULL, print_time);
-	} else if(print_type == PRINT_TYPE_SECTOR) {
-		add_nugget_stat_func(NULL, NULL, print_sector);
+	if( is_stream ){
+		//process the bits as soon as they get out of reorder window
+		stream_push_bit(pbiten);
+		return;
 	}
 
-	//statistics
-	add_bit_stat_func(init_type_statistic, itr_type_statistic, process_type_statistic);
+	//insert into list order by time
+	insert_proper_pos(pbiten);
+	biten_cnt++;
+}
 
-	if(is_path)
-		add_nugget_stat_func(init_path_statistic, travel_path_statistic, process_path_statistic);
-	if(is_cpu)
-		add_bit_stat_func(init_cpu_statistic, itr_cpu_statistic, process_cpu_statistic);
-	if(is_pid)
-		add_nugget_stat_func(init_pid_statistic, travel_pid_statistic, process_pid_statistic);
+static struct decode_batch* decode_cur_batch;
+static int decode_cur_cnt;
 
-	statistic_list_for_each();
-	statistic_rb_traveling();
+static void decode_flush_batch(){
+	if( decode_cur_batch == NULL )
+		return;
 
-	//clean all list entities
-	if(output!=stdout){
-		fclose(output);
+	pthread_mutex_lock(&decode_mutex);
+	while( decode_queued >= DECODE_MAX_QUEUED )
+		pthread_cond_wait(&decode_space_cond, &decode_mutex);
+	list_add_tail(&decode_cur_batch->link, &decode_queue);
+	decode_queued++;
+	pthread_cond_signal(&decode_cond);
+	pthread_mutex_unlock(&decode_mutex);
+
+	decode_cur_batch = NULL;
+	decode_cur_cnt = 0;
+}
+
+static void decode_enqueue_bit(struct bit_entity* pbiten){
+	if( decode_cur_batch == NULL ){
+		decode_cur_batch = (struct decode_batch*)malloc(sizeof(struct decode_batch));
+		if( decode_cur_batch == NULL ){
+			perror("failed to allocate memory");
+			free(pbiten);
+			return;
+		}
+		INIT_LIST_HEAD(&decode_cur_batch->bits);
 	}
 
-	return 0;
-err:
-	if( ifd < 0 )
-		close(ifd);
-	if( pbiten != NULL )
-		free(pbiten);
-	return 0;
+	list_add_tail(&pbiten->link, &decode_cur_batch->bits);
+	if( ++decode_cur_cnt >= DECODE_BATCH_SIZE )
+		decode_flush_batch();
 }
 
-bool parse_args(int argc, char** argv){
-	char tok;
-	char *p;
-	
-	while( (tok = getopt_long(argc, argv, ARG_OPTS, arg_opts, NULL)) >= 0){
-	switch(tok){
+static void* decode_body(void* param){
+	bool ret;
+
+	ret = decode_bits(decode_enqueue_bit);
+	decode_flush_batch();
+
+	pthread_mutex_lock(&decode_mutex);
+	decode_failed = !ret;
+	decode_done = true;
+	pthread_cond_signal(&decode_cond);
+	pthread_mutex_unlock(&decode_mutex);
+	return NULL;
+}
+
+bool decode_bits_parallel(void (*consume)(struct bit_entity*)){
+	pthread_t td;
+	struct decode_batch* pbatch = NULL;
+	struct bit_entity* pbiten = NULL;
+	struct bit_entity* tmp = NULL;
+
+	INIT_LIST_HEAD(&decode_queue);
+	decode_queued = 0;
+	decode_done = false;
+	decode_failed = false;
+	if( pthread_create(&td, NULL, decode_body, NULL) ){
+		perror("failed to create decode thread");
+		return false;
+	}
+
+	while(1){
+		pthread_mutex_lock(&decode_mutex);
+		while( list_empty(&decode_queue) && !decode_done )
+			pthread_cond_wait(&decode_cond, &decode_mutex);
+		if( list_empty(&decode_queue) ){
+			pthread_mutex_unlock(&decode_mutex);
+			break;
+		}
+		pbatch = list_entry(decode_queue.next, struct decode_batch, link);
+		list_del(&pbatch->link);
+		decode_queued--;
+		pthread_cond_signal(&decode_space_cond);
+		pthread_mutex_unlock(&decode_mutex);
+
+		list_for_each_entry_safe(pbiten, tmp, &pbatch->bits, link){
+			list_del(&pbiten->link);
+			consume(pbiten);
+		}
+		free(pbatch);
+	}
+
+	pthread_join(td, NULL);
+	return !decode_failed;
+}
+
+bool parse_args(int argc, char** argv){
+	char tok;
+	char *p;
+	char errmsg[128];
+	const char* prog = strrchr(argv[0], '/');
+
+	//diotop is the link of dioparse
+	prog = prog ? prog + 1 : argv[0];
+	if( !strcmp(prog, "diotop") ){
+		is_top = true;
+		is_follow = true;
+		is_stream = true;
+	}
+	
+	while( (tok = getopt_long(argc, argv, ARG_OPTS, arg_opts, NULL)) >= 0){
+	switch(tok){
 	case 'i':
-		memset(respath,0,sizeof(char)*MAX_FILEPATH_LEN);
-		strcpy(respath,optarg);
+		if( nr_inputs >= MAX_INPUTS ){
+			printf("-i Option Error : too many input files\n");
+			exit(1);
+		}
+		input_paths[nr_inputs++] = optarg;
 		break;
 	case 'p':
 		if(!strcmp("sector",optarg)) {
@@ -497,6 +1592,25 @@ bool parse_args(int argc, char** argv){
 			exit(1);
 		}
                 break;
+	case 'x':
+		if(!strcmp("text",optarg)) {
+			export_type = EXPORT_TYPE_TEXT;
+		} else if(!strcmp("csv",optarg)) {
+			export_type = EXPORT_TYPE_CSV;
+		} else if(!strcmp("jsonl",optarg)) {
+			export_type = EXPORT_TYPE_JSONL;
+		} else {
+			printf("Export Type Error\n");
+			exit(1);
+		}
+		break;
+	case 'C':
+		memset(convpath,0,sizeof(char)*MAX_FILEPATH_LEN);
+		strncpy(convpath,optarg,MAX_FILEPATH_LEN-1);
+		break;
+	case 'k':
+		is_resync = true;
+		break;
 	case 'o':
 		output = fopen(optarg,"w");
 		if(output==NULL) {
@@ -506,9 +1620,9 @@ bool parse_args(int argc, char** argv){
                 break;
 	case 'T':
 		p = strtok(optarg,",");
-		time_start = (uint64_t)atoi(p) * 1000000000;
+		time_start = (uint64_t)(atof(p) * 1000000000);
 		p = strtok(NULL,",");
-		time_end = (uint64_t)atoi(p) * 1000000000;
+		time_end = (uint64_t)(atof(p) * 1000000000);
 		break;
 	case 'S':
 		p = strtok(optarg,",");
@@ -519,6 +1633,12 @@ bool parse_args(int argc, char** argv){
 	case 'P':
 		filter_pid = (uint64_t)atoi(optarg);
 		break;
+	case 'F':
+		if( !dio_filter_compile(&bit_filter, optarg, errmsg, sizeof(errmsg)) ){
+			printf("-F Option Error : %s\n", errmsg);
+			exit(1);
+		}
+		break;
 	case 's':
 		p = strtok(optarg,",");
 		check_stat_opt(optarg);
@@ -529,16 +1649,87 @@ bool parse_args(int argc, char** argv){
 		}
 		//path, pid, cpu	
 		break;
+	case 'c':
+		is_group_comm = true;
+		break;
 	case 'g':
 		is_graphic = true;
 		break;
+	case 'r':
+		is_stream = true;
+		break;
+	case 'f':
+		is_follow = true;
+		is_stream = true;
+		follow_interval = (uint64_t)atoll(optarg) * 1000000;
+		if( follow_interval == 0 ){
+			printf("-f Option Error\n");
+			exit(1);
+		}
+		break;
+	case 't':
+		is_top = true;
+		is_follow = true;
+		is_stream = true;
+		break;
+	case 'e':
+		evict_timeout = (uint64_t)atoll(optarg) * 1000000;
+		break;
+	case 'I':
+		series_interval = (uint64_t)atoll(optarg) * 1000000;
+		if( series_interval == 0 ){
+			printf("-I Option Error\n");
+			exit(1);
+		}
+		break;
+	case 'R':
+		lba_region = (uint64_t)atoll(optarg) * 1024 * 1024 / 512;
+		if( lba_region == 0 ){
+			printf("-R Option Error\n");
+			exit(1);
+		}
+		break;
+	case 'q':
+		if( !parse_percentiles(optarg) ){
+			printf("-q Option Error\n");
+			exit(1);
+		}
+		break;
+	case 'l':
+		if( stat_module_cnt >= MAX_STAT_MODULES ){
+			printf("-l Option Error\n");
+			exit(1);
+		}
+		stat_modules[stat_module_cnt++] = optarg;
+		break;
+	case 'j':
+		nr_jobs = atoi(optarg);
+		if( nr_jobs < 1 || nr_jobs > MAX_JOBS ){
+			printf("-j Option Error\n");
+			exit(1);
+		}
+		break;
 	case 'h':
-		printf("USAGE : %s [ -i <input> ] [ -o <output> ] [-p <print> ] [ -T <time filter> ] [ -S <sector filter> ] [ -P <pid filter> ] [ -s <statistic> ] [ -g ]\n", argv[0]);
+		printf("USAGE : %s [ -i <input> ] [ -o <output> ] [ -C <columnar output> ] [ -k ] [-p <print> [ -x <format> ] ] [ -T <time filter> ] [ -S <sector filter> ] [ -P <pid filter> ] [ -F <filter expression> ] [ -s <statistic> [ -c ] ] [ -g ] [ -r [ -e <evict timeout> ] ] [ -f <interval> ] [ -t ] [ -j <threads> ] [ -l <module> ] [ -q <percentiles> ] [ -I <interval> ] [ -R <region> ]\n", argv[0]);
 		printf("%s", opt_detail);
 		exit(1);
 		break;
         };
     }
+
+    if( is_top && follow_interval == 0 )
+	follow_interval = (uint64_t)DEFAULT_TOP_INTERVAL * 1000000;
+
+    //the filter options are tests of the filter program too
+    if( (time_start > 0 || time_end != (uint64_t)(-1)) &&
+	!dio_filter_add_range(&bit_filter, DIO_FF_TIME, time_start, time_end) )
+	return false;
+    if( (sector_start > 0 || sector_end != (uint64_t)(-1)) &&
+	!dio_filter_add_range(&bit_filter, DIO_FF_SECTOR, sector_start, sector_end) )
+	return false;
+    if( filter_pid != (uint64_t)(-1) &&
+	!dio_filter_add_range(&bit_filter, DIO_FF_PID, filter_pid, filter_pid) )
+	return false;
     return true;
 }
 void check_stat_opt(char *str) {
@@ -548,12 +1739,43 @@ void check_stat_opt(char *str) {
 		is_path = true;
 	else if(!strcmp(str,"pid"))
 		is_pid = true;
+	else if(!strcmp(str,"series"))
+		is_series = true;
+	else if(!strcmp(str,"depth"))
+		is_depth = true;
+	else if(!strcmp(str,"lba"))
+		is_lba = true;
+	else if(!strcmp(str,"stack"))
+		is_stack = true;
+	else if(!strcmp(str,"class"))
+		is_class = true;
+	else if(!strcmp(str,"error"))
+		is_error = true;
 	else {
 		printf("-s Option Error\n");
 		exit(1);
 	}
 
 }
+
+bool parse_percentiles(char* str){
+	char* tok = NULL;
+	char* end = NULL;
+	double pct;
+	int cnt = 0;
+
+	for(tok = strtok(str, ","); tok != NULL; tok = strtok(NULL, ",")){
+		pct = strtod(tok, &end);
+		if( end == tok || *end != '\0' || pct < 0 || pct > 100 || cnt >= MAX_PERCENTILES )
+			return false;
+		percentiles[cnt++] = pct;
+	}
+	if( cnt == 0 )
+		return false;
+
+	nr_percentiles = cnt;
+	return true;
+}
 void insert_proper_pos(struct bit_entity* pbiten){
 	struct list_head* p = NULL;
 	struct bit_entity* _pbiten = NULL;
@@ -575,40 +1797,15 @@ static void init_rbentity(struct dio_rbentity* prben){
 	prben->sector = 0;
 }
 
-static struct dio_rbentity* rb_search_entity(uint64_t sector){
-	struct rb_node* p = rben_root.rb_node;
-	struct dio_rbentity* prben = NULL;
-
-	while(p){
-		prben = rb_entry(p, struct dio_rbentity, rblink);
-		if( sector < prben->sector )
-			p = prben->rblink.rb_left;
-		else if( sector > prben->sector )
-			p = prben->rblink.rb_right;
-		else
-			return prben;
-	}
-	return NULL;
-}
-
-struct dio_rbentity* rb_search_end(uint64_t sec_t){
+static struct dio_rbentity* rb_search_entity(uint64_t key){
 	struct rb_node* p = rben_root.rb_node;
 	struct dio_rbentity* prben = NULL;
-	struct dio_nugget* actng = NULL;
-	uint64_t calcsect = 0;
 
 	while(p){
 		prben = rb_entry(p, struct dio_rbentity, rblink);
-		actng = FRONT_NUGGET(&prben->nghead);
-		if( prben->sector != actng->sector ){
-			DBGOUT("prben->sector != actng->sector\n");
-			return NULL;
-		}
-		calcsect = actng->sector + actng->size/512;
-
-		if( sec_t < calcsect )
+		if( key < prben->key )
 			p = prben->rblink.rb_left;
-		else if( sec_t > calcsect )
+		else if( key > prben->key )
 			p = prben->rblink.rb_right;
 		else
 			return prben;
@@ -616,12 +1813,6 @@ struct dio_rbentity* rb_search_end(uint64_t sec_t){
 	return NULL;
 }
 
-struct dio_nugget* FRONT_NUGGET(struct list_head* png_head){
-	if( list_empty(png_head) )
-		DBGOUT(">>>>>>>>>>>>>>>> list empty\n");
-
-	return list_entry(png_head->next, struct dio_nugget, nglink);
-}
 
 static struct dio_rbentity* __rb_insert_entity(struct dio_rbentity* prben){
 	struct rb_node** p = &rben_root.rb_node;
@@ -632,9 +1823,9 @@ static struct dio_rbentity* __rb_insert_entity(struct dio_rbentity* prben){
 		parent = *p;
 		prbenbuf = rb_entry(parent, struct dio_rbentity, rblink);
 
-		if( prben->sector < prbenbuf->sector )
+		if( prben->key < prbenbuf->key )
 			p = &(*p)->rb_left;
-		else if( prben->sector > prbenbuf->sector )
+		else if( prben->key > prbenbuf->key )
 			p = &(*p)->rb_right;
 		else
 			return prbenbuf;	//there already exists
@@ -656,69 +1847,52 @@ static struct dio_rbentity* rb_insert_entity(struct dio_rbentity* prben){
 void init_nugget(struct dio_nugget* pdng){
 	memset(pdng, 0, sizeof(struct dio_nugget));
 	//pdng->elemidx = 0;
+	INIT_LIST_HEAD(&pdng->actlink);
+	INIT_LIST_HEAD(&pdng->mghead);
+	INIT_LIST_HEAD(&pdng->mglink);
 }
 
-void copy_nugget(struct dio_nugget* destng, struct dio_nugget* srcng){
-	memcpy(destng, srcng, sizeof(struct dio_nugget));
-}
-
-struct dio_nugget* get_nugget_at(uint64_t sector){
+struct dio_nugget* get_nugget_at(uint64_t key){
 	struct dio_nugget* pdng = NULL;
-	struct dio_rbentity* prben = NULL;
-
-	prben = rb_search_entity(sector);
-	if( prben == NULL ){
-		prben = (struct dio_rbentity*)malloc(sizeof(struct dio_rbentity));
-		if( prben == NULL){
-			DBGOUT("failed to get memory\n");
-			return NULL;
-		}
-		init_rbentity(prben);
-		prben->sector = sector;
-		if( rb_insert_entity(prben) != NULL ){
-			free(prben);
-			DBGOUT(">failed to insert rbentity into rbtree\n");
-			return NULL;
-		}
-	}
 
-	//return the first item of nugget list
-	if( !list_empty(&prben->nghead) ){
-		pdng = FRONT_NUGGET(&prben->nghead);
-		if( pdng->ngflag == NG_ACTIVE ){
+	//the active nugget is found on hash table without rbtree searching
+	pdng = (struct dio_nugget*)dio_hash_lookup(&actng_hash, key);
+	if( pdng != NULL ){
+		if( pdng->ngflag == NG_ACTIVE )
 			return pdng;
-		}
-	}
-
-	//else if list is empty or first item is inactive
-	pdng = NULL;
-	pdng = (struct dio_nugget*)malloc(sizeof(struct dio_nugget));
-	if( pdng == NULL ){
-		perror("failed to allocate nugget memory");
-		return NULL;
+		unindex_nugget(pdng);
 	}
 
-	init_nugget(pdng);
-	pdng->sector = sector;
-	pdng->ngflag = NG_ACTIVE;
-	list_add(&pdng->nglink, &prben->nghead);
-
-	return pdng;
+	//there isn't any active nugget at sector
+	return create_nugget_at(key);
 }
 
-struct dio_nugget* create_nugget_at(uint64_t sector){
-	struct dio_rbentity* rben = rb_search_entity(sector);
-	if( rben == NULL ){
-		rben = (struct dio_rbentity*)malloc(sizeof(struct dio_rbentity));
-		if( rben == NULL ){
-			perror("failed to allocate rbentity memory");
-			return NULL;
-		}
-		init_rbentity(rben);
-		rben->sector = sector;
+static struct dio_rbentity* get_rbentity_at(uint64_t key){
+	struct dio_rbentity* prben = rb_search_entity(key);
+	if( prben != NULL )
+		return prben;
 
-		rb_insert_entity(rben);
+	prben = (struct dio_rbentity*)malloc(sizeof(struct dio_rbentity));
+	if( prben == NULL ){
+		perror("failed to allocate rbentity memory");
+		return NULL;
 	}
+	init_rbentity(prben);
+	prben->sector = KEY_SECTOR(key);
+	prben->device = KEY_DEVICE(key);
+	prben->key = key;
+	if( rb_insert_entity(prben) != NULL ){
+		free(prben);
+		DBGOUT(">failed to insert rbentity into rbtree\n");
+		return NULL;
+	}
+	return prben;
+}
+
+struct dio_nugget* create_nugget_at(uint64_t key){
+	struct dio_rbentity* prben = get_rbentity_at(key);
+	if( prben == NULL )
+		return NULL;
 
 	struct dio_nugget* newng = NULL;
 	newng = (struct dio_nugget*)malloc(sizeof(struct dio_nugget));
@@ -727,36 +1901,147 @@ struct dio_nugget* create_nugget_at(uint64_t sector){
 		return NULL;
 	}
 	init_nugget(newng);
-	newng->sector = sector;
+	newng->sector = prben->sector;
+	newng->device = prben->device;
+	newng->key = key;
 	newng->ngflag = NG_ACTIVE;
-	list_add(&newng->nglink, &rben->nghead);
+	newng->prben = prben;
+	list_add(&newng->nglink, &prben->nghead);
+	if( is_stream )
+		list_add_tail(&newng->actlink, &actng_head);
+	if( !dio_hash_insert(&actng_hash, key, newng) ){
+		DBGOUT(">failed to insert nugget into hash table\n");
+	}
 
 	return newng;
 }
 
-void delete_nugget_at(uint64_t sector){
-	struct dio_rbentity* prben = rb_search_entity(sector);
+bool move_nugget_to(struct dio_nugget* pdng, uint64_t key){
+	struct dio_rbentity* prben = get_rbentity_at(key);
 	if( prben == NULL )
-		return;
-	
-	if( list_empty(&prben->nghead) )
-		return;
+		return false;
+
+	unindex_nugget(pdng);
+	list_del(&pdng->nglink);
+	if( list_empty(&pdng->prben->nghead) ){
+		rb_erase(&pdng->prben->rblink, &rben_root);
+		free(pdng->prben);
+	}
+
+	pdng->sector = prben->sector;
+	pdng->device = prben->device;
+	pdng->key = key;
+	pdng->prben = prben;
+	list_add(&pdng->nglink, &prben->nghead);
+	dio_hash_insert(&actng_hash, key, pdng);
+	index_nugget(pdng);
+	return true;
+}
+
+int find_device(uint32_t device){
+	static int last = 0;
+	int i;
+
+	//bits of a device come in a row usually
+	if( nr_devices > 0 && devices[last] == device )
+		return last;
+	for(i=0; i<nr_devices; i++){
+		if( devices[i] == device )
+			return last = i;
+	}
+	return -1;
+}
+
+int device_index(uint32_t device){
+	int idx;
+
+	idx = find_device(device);
+	if( idx >= 0 )
+		return idx;
+
+	if( nr_devices >= MAX_DEVICES ){
+		if( !is_device_overflow )
+			fprintf(stderr, "too many devices, the devices over %d are handled as the last one\n", MAX_DEVICES);
+		is_device_overflow = true;
+		return MAX_DEVICES - 1;
+	}
+	devices[nr_devices] = device;
+	device_uppers[nr_devices] = -1;
+	return nr_devices++;
+}
+
+uint64_t bit_key(struct blk_io_trace* pbit){
+	return DEV_KEY(device_index(pbit->device), pbit->sector);
+}
+
+void index_nugget(struct dio_nugget* pdng){
+	uint64_t nsect = pdng->size / 512;
+
+	if( pdng->is_indexed )
+		itree_erase(&actng_itree, &pdng->ival);
+
+	//zero sized nugget takes a sector to be found by its sector
+	pdng->ival.start = pdng->key;
+	pdng->ival.last = pdng->key + (nsect > 0 ? nsect : 1) - 1;
+	itree_insert(&actng_itree, &pdng->ival);
+	pdng->is_indexed = true;
+}
+
+void unindex_nugget(struct dio_nugget* pdng){
+	if( dio_hash_lookup(&actng_hash, pdng->key) == pdng )
+		dio_hash_remove(&actng_hash, pdng->key);
+
+	if( pdng->is_indexed ){
+		itree_erase(&actng_itree, &pdng->ival);
+		pdng->is_indexed = false;
+	}
+}
+
+struct dio_nugget* search_backmerge_nugget(uint64_t key){
+	struct dio_interval* pival = NULL;
+	struct dio_nugget* pdng = NULL;
+
+	if( KEY_SECTOR(key) == 0 )
+		return NULL;
 
-	struct dio_nugget* del = FRONT_NUGGET(&prben->nghead);
-	list_del(prben->nghead.next);
-	free(del);
+	//the target covers the previous sector of 'key'
+	for(pival = itree_first(&actng_itree, key-1, key-1); pival != NULL;
+		pival = itree_next(pival, key-1, key-1)){
+		pdng = container_of(pival, struct dio_nugget, ival);
+		if( pdng->ngflag == NG_ACTIVE && pdng->key + pdng->size/512 == key )
+			return pdng;
+	}
+	return NULL;
+}
+
+struct dio_nugget* search_active_nugget(uint64_t key){
+	struct dio_nugget* pdng = NULL;
+
+	pdng = (struct dio_nugget*)dio_hash_lookup(&actng_hash, key);
+	if( pdng == NULL || pdng->ngflag != NG_ACTIVE )
+		return NULL;
+	return pdng;
 }
 
-void extract_nugget(struct blk_io_trace* pbit, struct dio_nugget* pdngbuf){
+void extract_nugget(struct blk_io_trace* pbit, char actc, struct dio_nugget* pdngbuf){
+	//states should be terminated by null character
+	if( pdngbuf->elemidx >= MAX_ELEMENT_SIZE-1 )
+		return;
+
 	pdngbuf->times[pdngbuf->elemidx] = pbit->time;
+	pdngbuf->states[pdngbuf->elemidx] = actc;
+	pdngbuf->pathid = path_trie_child(pdngbuf->pathid, actc);
 	if( pdngbuf->elemidx == 0 ){
 		pdngbuf->size = pbit->bytes;
 		pdngbuf->pid = pbit->pid;
-		pdngbuf->category = pbit->action >> BLK_TC_SHIFT;
+		index_nugget(pdngbuf);
 	}
 
-	handle_action(pbit->action, pdngbuf);
 	pdngbuf->category = pbit->action >> BLK_TC_SHIFT;
+	pdngbuf->categories |= pdngbuf->category;
+
+	//kernel writes the negative errno on 16 bits, and the old one writes positive
+	pdngbuf->error = (int16_t)pbit->error < 0 ? -(int16_t)pbit->error : pbit->error;
 	if(pbit->cpu < 128)
 	{
 		pdngbuf->idxCPU = pbit->cpu;
@@ -764,686 +2049,3397 @@ void extract_nugget(struct blk_io_trace* pbit, struct dio_nugget* pdngbuf){
 	pdngbuf->elemidx++;
 }
 
-void handle_action(uint32_t act, struct dio_nugget* pdng){
-	struct dio_nugget* ptmpng = NULL;
-	struct dio_nugget* newng = NULL;
-	struct dio_rbentity* prben = NULL;
+bool is_failed_nugget(struct dio_nugget* pdng){
+	return pdng->error != 0;
+}
 
-	char actc = GET_ACTION_CHAR(act);
-	pdng->states[pdng->elemidx] = actc;
+int path_trie_child(int pathid, char actc){
+	uint64_t key = PATH_TRIE_KEY(pathid, actc);
+	void* val = NULL;
 
-	switch(act){
-	case 'M':
-		//back merged
-		prben = rb_search_end(pdng->sector);
-		if( prben == NULL ){
-			DBGOUT("Failed to search nugget when back merging\n");
-			return;
-		}
-		ptmpng = FRONT_NUGGET(&prben->nghead);
-		
-		pdng->ngflag = NG_BACKMERGE;
-		pdng->mlink = ptmpng;
-		ptmpng->size += pdng->size;
-		break;
+	if( pathid < 0 )
+		return -1;
 
-	case 'F':
-		//front merged
-		newng = create_nugget_at(pdng->sector);
-		if( newng == NULL ){
-			DBGOUT("Failed to create nugget\n");
-			return;
-		}
-		prben = rb_search_entity(pdng->sector + pdng->size);
-		if( prben == NULL ){
-			DBGOUT("Failed to search nugget when front merging\n");
-			return;
-		}
-		ptmpng = FRONT_NUGGET(&prben->nghead);
-		copy_nugget(newng, ptmpng);
+	//child id is never 0, so it is a valid hash value
+	val = dio_hash_lookup(&path_trie, key);
+	if( val != NULL )
+		return (int)(uintptr_t)val;
 
-		pdng->ngflag = NG_FRONTMERGE;
-		pdng->mlink = ptmpng;
-		delete_nugget_at(pdng->sector + pdng->size);
-		break;
-	case 'C':
-		pdng->ngflag = NG_COMPLETE;
-		break;
-	};
+	if( !dio_hash_insert(&path_trie, key, (void*)(uintptr_t)path_node_cnt) )
+		return -1;
+	return path_node_cnt++;
 }
 
-void add_nugget_stat_func(statistic_init_func stat_init_fn, 
-				statistic_travel_func stat_trv_fn,
-				statistic_process_func stat_proc_fn){
-	if( stat_fn_cnt +1 >= MAX_STATISTIC_FUNCTION )
-		return;
-	
-	stat_init_fns[stat_fn_cnt] = stat_init_fn;
-	stat_trv_fns[stat_fn_cnt] = stat_trv_fn;
-	stat_proc_fns[stat_fn_cnt] = stat_proc_fn;
-	stat_fn_cnt++;
-}
+//------------------- lifecycle engine -------------------------------------//
+#define NR_LIFECYCLE_ACTION	(__BLK_TA_DRV_DATA + 1)
+static const struct lifecycle_entry lifecycle_table[NR_LIFECYCLE_ACTION] = {
+	[__BLK_TA_QUEUE]	= { 'Q', lc_queue,	0 },
+	[__BLK_TA_BACKMERGE]	= { 'M', lc_backmerge,	0 },
+	[__BLK_TA_FRONTMERGE]	= { 'F', lc_frontmerge,	0 },
+	[__BLK_TA_GETRQ]	= { 'G', lc_append,	0 },
+	[__BLK_TA_SLEEPRQ]	= { 'S', lc_append,	0 },
+	[__BLK_TA_REQUEUE]	= { 'R', lc_append,	LC_PROPAGATE },
+	[__BLK_TA_ISSUE]	= { 'D', lc_append,	LC_PROPAGATE },
+	[__BLK_TA_COMPLETE]	= { 'C', lc_append,	LC_PROPAGATE | LC_FINISH },
+	[__BLK_TA_PLUG]		= { 'P', NULL,		0 },	//queue event
+	[__BLK_TA_UNPLUG_IO]	= { 'U', NULL,		0 },	//queue event
+	[__BLK_TA_UNPLUG_TIMER]	= { 'T', NULL,		0 },	//queue event
+	[__BLK_TA_INSERT]	= { 'I', lc_append,	LC_PROPAGATE },
+	[__BLK_TA_SPLIT]	= { 'X', lc_split,	0 },
+	[__BLK_TA_BOUNCE]	= { 'B', lc_append,	0 },
+	[__BLK_TA_REMAP]	= { 'A', lc_remap,	0 },
+	[__BLK_TA_ABORT]	= { 'a', lc_append,	LC_PROPAGATE | LC_FINISH },
+	[__BLK_TA_DRV_DATA]	= { 'd', NULL,		0 },	//driver data
+};
 
-void add_bit_stat_func(statistic_init_func stat_init_fn,
-				statistic_itr_func stat_itr_fn,
-				statistic_process_func stat_proc_fn){
-	if( stat_fn_list_cnt >= MAX_STATISTIC_FUNCTION - stat_fn_cnt )
-		return;
-	
-	stat_init_fns[MAX_STATISTIC_FUNCTION - stat_fn_list_cnt - 1] = stat_init_fn;
-	stat_itr_fns[MAX_STATISTIC_FUNCTION - stat_fn_list_cnt - 1] = stat_itr_fn;
-	stat_proc_fns[MAX_STATISTIC_FUNCTION - stat_fn_list_cnt - 1] = stat_proc_fn;
-	stat_fn_list_cnt ++;
-}
+struct dio_nugget* handle_bit(struct bit_entity* pbiten){
+	unsigned int act = pbiten->bit.action & 0xffff;
+	const struct lifecycle_entry* plc = NULL;
+	struct dio_nugget* pdng = NULL;
+	struct dio_nugget* pmgng = NULL;
 
-void statistic_rb_traveling(){
-	struct rb_node* node;
-	int i=0, cnt=0;
+	if( act >= NR_LIFECYCLE_ACTION || lifecycle_table[act].handler == NULL )
+		return NULL;
+	plc = &lifecycle_table[act];
 
-	//init all statistic functions
-	for(i=0; i<stat_fn_cnt; i++){
-		if( stat_init_fns[i] != NULL )
-			stat_init_fns[i]();
-	}
-	
-	node = rb_first(&rben_root);
-	do{
-		struct dio_rbentity* prben = NULL;
-		prben = rb_entry(node, struct dio_rbentity, rblink);
+	pdng = plc->handler(pbiten);
+	if( pdng == NULL )
+		return NULL;
 
-		struct dio_nugget* pdng = NULL;
-		list_for_each_entry(pdng, &prben->nghead, nglink){
-			//traveling
-			for(i=0; i<stat_fn_cnt; i++){
-				if( stat_trv_fns[i] != NULL )
-					stat_trv_fns[i](pdng);	
-			}
-			cnt++;
+	//merged nuggets are dispatched and completed with their request
+	if( plc->flags & LC_PROPAGATE ){
+		list_for_each_entry(pmgng, &pdng->mghead, mglink){
+			extract_nugget(&pbiten->bit, plc->actc, pmgng);
+			//merged nugget keeps its merge kind on ngflag for the exporter
+			if( plc->flags & LC_FINISH )
+				complete_lower_nugget(pmgng);
 		}
-	}while((node = rb_next(node)) != NULL);
+	}
+	if( plc->flags & LC_FINISH ){
+		pdng->ngflag = NG_COMPLETE;
+		unindex_nugget(pdng);
+		complete_lower_nugget(pdng);
+	}
 
-	//process data
-	for(i=0; i<stat_fn_cnt; i++){
-		if( stat_proc_fns[i] != NULL )
-			stat_proc_fns[i](cnt);
+	if( pass_all.evt_cnt > 0 ){
+		run_evt_fns(pdng, plc->actc, pbiten->bit.time);
+		if( plc->flags & LC_PROPAGATE ){
+			list_for_each_entry(pmgng, &pdng->mghead, mglink)
+				run_evt_fns(pmgng, plc->actc, pbiten->bit.time);
+		}
 	}
+	return pdng;
+}
+
+void link_merged_nugget(struct dio_nugget* parent, struct dio_nugget* child, int ngflag){
+	unindex_nugget(child);
+	child->ngflag = ngflag;
+	child->mlink = parent;
+	list_add_tail(&child->mglink, &parent->mghead);
+	list_del_init(&child->actlink);
 
+	parent->size += child->size;
 }
 
-void statistic_list_for_each(){
-	struct bit_entity* pos;
-	int i=0, cnt=0;
-	int itrcnt = MAX_STATISTIC_FUNCTION - stat_fn_list_cnt;
+static inline char lifecycle_actc(struct bit_entity* pbiten){
+	return lifecycle_table[pbiten->bit.action & 0xffff].actc;
+}
 
-	//init all statistic functions
-	for(i=MAX_STATISTIC_FUNCTION-1; i >= itrcnt; i--){
-		if( stat_init_fns[i] != NULL )
-			stat_init_fns[i]();
+struct dio_nugget* lc_append(struct bit_entity* pbiten){
+	struct dio_nugget* pdng = get_nugget_at(bit_key(&pbiten->bit));
+	if( pdng == NULL ){
+		DBGOUT(">failed to get nugget at sector %llu\n", pbiten->bit.sector);
+		return NULL;
 	}
-	
-	list_for_each_entry(pos, &biten_head, link){
-		//foreach data
-		for(i=MAX_STATISTIC_FUNCTION-1; i >= itrcnt; i--){
-			if( stat_itr_fns[i] != NULL )
-				stat_itr_fns[i](&pos->bit);
+	extract_nugget(&pbiten->bit, lifecycle_actc(pbiten), pdng);
+	return pdng;
+}
+
+struct dio_nugget* lc_queue(struct bit_entity* pbiten){
+	struct dio_nugget* pdng = NULL;
+	char lastc;
+
+	pdng = (struct dio_nugget*)dio_hash_lookup(&actng_hash, bit_key(&pbiten->bit));
+	if( pdng != NULL && pdng->ngflag == NG_ACTIVE && pdng->elemidx > 0 ){
+		//split or remapped bio is queued again
+		lastc = pdng->states[pdng->elemidx-1];
+		if( lastc != 'X' && lastc != 'A' ){
+			//a new I/O on the same sector. 
+			//the old one can't get any bit anymore
+			unindex_nugget(pdng);
 		}
-		cnt++;
 	}
+	return lc_append(pbiten);
+}
 
-	//process data
-	for(i=MAX_STATISTIC_FUNCTION-1; i >= itrcnt; i--){
-		if( stat_proc_fns[i] != NULL )
-			stat_proc_fns[i](cnt);
+struct dio_nugget* lc_backmerge(struct bit_entity* pbiten){
+	struct dio_nugget* pdng = NULL;
+	struct dio_nugget* parent = NULL;
+
+	pdng = lc_append(pbiten);
+	if( pdng == NULL )
+		return NULL;
+
+	//the request which ends at the start of bio
+	parent = search_backmerge_nugget(pdng->key);
+	if( parent == NULL || parent == pdng ){
+		DBGOUT("Failed to search nugget when back merging\n");
+		return pdng;
 	}
 
+	link_merged_nugget(parent, pdng, NG_BACKMERGE);
+	index_nugget(parent);
+	return pdng;
 }
 
-//------------------- printing -------------------------------------//
-void print_time() {
-	struct bit_entity* p = NULL;
+struct dio_nugget* lc_frontmerge(struct bit_entity* pbiten){
+	struct dio_nugget* pdng = NULL;
+	struct dio_nugget* parent = NULL;
 
-	list_for_each_entry(p, &biten_head, link) {
+	pdng = lc_append(pbiten);
+	if( pdng == NULL )
+		return NULL;
 
-		fprintf(output,"%5d.%09lu\t", (int)SECONDS(p->bit.time), (unsigned long)NANO_SECONDS(p->bit.time));
-		fprintf(output,"%llu\t",p->bit.sector);
-		fprintf(output,"%u\t",p->bit.pid);
-		fprintf(output,"%u\n",p->bit.bytes/8);
+	//the request which starts at the end of bio
+	parent = search_active_nugget(pdng->key + pdng->size/512);
+	if( parent == NULL || parent == pdng ){
+		DBGOUT("Failed to search nugget when front merging\n");
+		return pdng;
 	}
+
+	//request starts at the sector of bio from now on
+	link_merged_nugget(parent, pdng, NG_FRONTMERGE);
+	move_nugget_to(parent, pdng->key);
+	return pdng;
 }
 
-void print_sector() {
+struct dio_nugget* lc_split(struct bit_entity* pbiten){
+	struct dio_nugget* pdng = NULL;
+	struct dio_nugget* newng = NULL;
+	uint64_t newsect = 0;
 
-	struct rb_node *node;
-	node = rb_first(&rben_root);
-	while((node = rb_next(node)) != NULL) {
-		struct list_head* nugget_head;
-		struct dio_rbentity* prbentity;
+	pdng = lc_append(pbiten);
+	if( pdng == NULL )
+		return NULL;
 
-		prbentity = rb_entry(node, struct dio_rbentity, rblink);
+	//pdu has the first sector of second part in big endian
+	memcpy(&newsect, pbiten->pdu, sizeof(uint64_t));
+	newsect = BE_TO_LE64(newsect);
+	if( newsect <= pdng->sector || pbiten->bit.bytes >= (__u32)pdng->size )
+		return pdng;
+
+	newng = create_nugget_at(pdng->key + (newsect - pdng->sector));
+	if( newng == NULL )
+		return pdng;
+
+	//second part has the same history with the first part
+	memcpy(newng->states, pdng->states, MAX_ELEMENT_SIZE);
+	memcpy(newng->times, pdng->times, sizeof(pdng->times));
+	newng->elemidx = pdng->elemidx;
+	newng->pathid = pdng->pathid;
+	newng->category = pdng->category;
+	newng->categories = pdng->categories;
+	newng->pid = pdng->pid;
+	newng->idxCPU = pdng->idxCPU;
+	newng->has_upper = pdng->has_upper;
+	newng->upper_key = pdng->upper_key;
+	newng->size = pdng->size - pbiten->bit.bytes;
+	index_nugget(newng);
+
+	pdng->size = pbiten->bit.bytes;
+	index_nugget(pdng);
+	return pdng;
+}
 
-		struct dio_nugget* pdng;
-		uint64_t tmpt = 0;
+struct dio_nugget* lc_remap(struct bit_entity* pbiten){
+	struct blk_io_trace_remap remap;
+	struct dio_nugget* pdng = NULL;
+	struct dio_nugget* upper = NULL;
+	uint64_t from;
+	int idx;
+
+	if( pbiten->bit.pdu_len < sizeof(remap) )
+		return lc_append(pbiten);
+
+	//pdu is written in big endian
+	memcpy(&remap, pbiten->pdu, sizeof(remap));
+	remap.device_from = BE_TO_LE32(remap.device_from);
+	remap.sector_from = BE_TO_LE64(remap.sector_from);
+
+	//remapping in the same device moves the nugget to new sector.
+	if( remap.device_from == pbiten->bit.device ){
+		from = DEV_KEY(device_index(remap.device_from), remap.sector_from);
+		pdng = search_active_nugget(from);
+		if( pdng != NULL && remap.sector_from != pbiten->bit.sector )
+			move_nugget_to(pdng, bit_key(&pbiten->bit));
+		return lc_append(pbiten);
+	}
 
-		list_for_each_entry(pdng, &(prbentity->nghead), nglink) {
-			tmpt = pdng->times[pdng->elemidx-1] - pdng->times[0];
-			fprintf(output,"%"PRIu64"\t",pdng->sector);
-			fprintf(output,"%5d.%09lu\t",(int)SECONDS(tmpt), (unsigned long)NANO_SECONDS(tmpt));
-			fprintf(output,"%u\t", pdng->pid);
-			fprintf(output,"%d\n", pdng->size);
-		}
+	//otherwise, the lifecycle starts from remap on this device.
+	//if the upper device is traced too, its nugget gets the latency of this.
+	//the upper device which has no bits of its own is not registered
+	idx = find_device(remap.device_from);
+	from = idx >= 0 ? DEV_KEY(idx, remap.sector_from) : 0;
+	if( idx >= 0 )
+		upper = search_active_nugget(from);
+	pdng = lc_append(pbiten);
+	if( pdng != NULL && upper != NULL && pdng->elemidx == 1 ){
+		pdng->has_upper = true;
+		pdng->upper_key = from;
+		idx = pdng->key >> DEV_KEY_SHIFT;
+		if( device_uppers[idx] < 0 )
+			device_uppers[idx] = upper->key >> DEV_KEY_SHIFT;
 	}
+	return pdng;
 }
 
-//------------------- i/o type statistics -------------------------------//
-static int r_cnt,w_cnt,x_cnt;
+void complete_lower_nugget(struct dio_nugget* pdng){
+	struct dio_nugget* upper = NULL;
+	uint64_t time;
 
-void init_type_statistic(){
-	r_cnt = w_cnt = x_cnt = 0;
+	if( !pdng->has_upper || pdng->elemidx == 0 || is_failed_nugget(pdng) )
+		return;
+	upper = search_active_nugget(pdng->upper_key);
+	if( upper == NULL )
+		return;
+
+	//the upper request is completed after all of its lower requests
+	time = pdng->times[pdng->elemidx-1] - pdng->times[0];
+	if( upper->lower_time < time )
+		upper->lower_time = time;
+	upper->nr_lower++;
 }
 
-void itr_type_statistic(struct blk_io_trace* pbit){
-	uint32_t category = pbit->action >> BLK_TC_SHIFT;
+bool dio_register_statistic(const struct dio_stat_ops* ops){
+	struct dio_stat_ops* newops = NULL;
 
-	if( category & BLK_TC_READ )
-		r_cnt++;
-	else if( category & BLK_TC_WRITE )
-		w_cnt++;
-	else
-		x_cnt++;
-}
+	if( stat_ops_cnt >= stat_ops_size ){
+		int size = stat_ops_size ? stat_ops_size * 2 : INIT_STAT_OPS_SIZE;
+		newops = (struct dio_stat_ops*)realloc(stat_ops, sizeof(struct dio_stat_ops) * size);
+		if( newops == NULL ){
+			perror("failed to allocate memory");
+			return false;
+		}
+		stat_ops = newops;
+		stat_ops_size = size;
+	}
 
-void process_type_statistic(int bit_cnt){
-	int tot;
-	fprintf(output, "%7s %10s %13s\n", "TYPE","COUNT","PERCENTAGE");
-	
-	fprintf(output, "%7s %10d %13f\n", "R",r_cnt, r_cnt/(double)bit_cnt*100);
-	fprintf(output, "%7s %10d %13f\n", "W",w_cnt,w_cnt/(double)bit_cnt*100);
-	fprintf(output, "%7s %10d %13f\n", "Unknown",x_cnt, x_cnt/(double)bit_cnt*100);
+	stat_ops[stat_ops_cnt++] = *ops;
+	return true;
+}
 
-	tot = r_cnt + w_cnt + x_cnt;
-	fprintf(output, "%7s %10d %13f\n", "Total :",tot, tot/(double)bit_cnt*100);
+FILE* dio_output(void){
+	return output;
 }
 
-//------------------- path statistics ------------------------------//
-struct list_head nugget_path_head;
-struct dio_nugget_path* pnugget_path;
+bool load_stat_module(const char* path){
+	void* handle = NULL;
+	dio_stat_module_init_func init_fn = NULL;
+
+	handle = dlopen(path, RTLD_NOW);
+	if( handle == NULL ){
+		fprintf(stderr, "failed to load %s : %s\n", path, dlerror());
+		return false;
+	}
+
+	init_fn = (dio_stat_module_init_func)dlsym(handle, DIO_STAT_MODULE_INIT);
+	if( init_fn == NULL ){
+		fprintf(stderr, "%s doesn't have %s\n", path, DIO_STAT_MODULE_INIT);
+		dlclose(handle);
+		return false;
+	}
+
+	//module is never unloaded, its callbacks are used until the end
+	init_fn();
+	return true;
+}
+
+static bool alloc_stat_pass(struct stat_pass* pp){
+	pp->itr = (statistic_itr_func*)malloc(sizeof(statistic_itr_func) * (stat_ops_cnt + 1));
+	pp->trv = (statistic_travel_func*)malloc(sizeof(statistic_travel_func) * (stat_ops_cnt + 1));
+	pp->evt = (statistic_event_func*)malloc(sizeof(statistic_event_func) * (stat_ops_cnt + 1));
+	pp->bat = (statistic_batch_func*)malloc(sizeof(statistic_batch_func) * (stat_ops_cnt + 1));
+	pp->itr_cnt = pp->trv_cnt = pp->evt_cnt = pp->bat_cnt = 0;
+	if( pp->itr == NULL || pp->trv == NULL || pp->evt == NULL || pp->bat == NULL ){
+		perror("failed to allocate memory");
+		return false;
+	}
+	return true;
+}
+
+bool statistic_prepare(){
+	int i=0;
+	struct stat_pass* pp = NULL;
+
+	if( !alloc_stat_pass(&pass_all) || !alloc_stat_pass(&pass_seq) ||
+		!alloc_stat_pass(&pass_par) )
+		return false;
+
+	for(i=0; i<stat_ops_cnt; i++){
+		pp = stat_ops[i].merge != NULL ? &pass_par : &pass_seq;
+		//batch function is used instead of itr if the statistic has both
+		if( stat_ops[i].batch != NULL ){
+			pass_all.bat[pass_all.bat_cnt++] = stat_ops[i].batch;
+			pp->bat[pp->bat_cnt++] = stat_ops[i].batch;
+		}
+		else if( stat_ops[i].itr != NULL ){
+			pass_all.itr[pass_all.itr_cnt++] = stat_ops[i].itr;
+			pp->itr[pp->itr_cnt++] = stat_ops[i].itr;
+		}
+		if( stat_ops[i].trv != NULL ){
+			pass_all.trv[pass_all.trv_cnt++] = stat_ops[i].trv;
+			pp->trv[pp->trv_cnt++] = stat_ops[i].trv;
+		}
+		if( stat_ops[i].evt != NULL )
+			pass_all.evt[pass_all.evt_cnt++] = stat_ops[i].evt;
+	}
+	return true;
+}
+
+static void run_bat_fns(struct stat_pass* pp, struct stat_batch* pb){
+	struct dio_bit_batch bat = { pb->bits, pb->action, pb->cpu, pb->nr };
+	int i=0;
+
+	for(i=0; pb->nr > 0 && i<pp->bat_cnt; i++)
+		pp->bat[i](&bat);
+	pb->nr = 0;
+}
+
+static inline void run_itr_fns(struct stat_pass* pp, struct stat_batch* pb,
+				struct blk_io_trace* pbit){
+	int i=0;
+	for(i=0; i<pp->itr_cnt; i++)
+		pp->itr[i](pbit);
+
+	if( pp->bat_cnt > 0 ){
+		pb->bits[pb->nr] = *pbit;
+		pb->action[pb->nr] = pbit->action;
+		pb->cpu[pb->nr] = pbit->cpu;
+		if( ++pb->nr == STAT_BATCH_SIZE )
+			run_bat_fns(pp, pb);
+	}
+}
+
+static inline void run_trv_fns(struct stat_pass* pp, struct dio_nugget* pdng){
+	int i=0;
+	for(i=0; i<pp->trv_cnt; i++)
+		pp->trv[i](pdng);
+}
+
+static inline void run_evt_fns(struct dio_nugget* pdng, char actc, uint64_t time){
+	int i=0;
+	for(i=0; i<pass_all.evt_cnt; i++)
+		pass_all.evt[i](pdng, actc, time);
+}
+
+static void* rb_worker_body(void* param){
+	struct stat_worker* pw = (struct stat_worker*)param;
+	struct dio_nugget* pdng = NULL;
+	int i=0;
+
+	cur_shard = pw->shard;
+	for(i=0; i<pw->rben_cnt; i++){
+		list_for_each_entry(pdng, &pw->prbens[i]->nghead, nglink){
+			run_trv_fns(&pass_par, pdng);
+			pw->ng_cnt++;
+		}
+	}
+	return NULL;
+}
+
+static void start_stat_worker(struct stat_worker* pw, void* (*body)(void*)){
+	if( pthread_create(&pw->td, NULL, body, pw) ){
+		perror("failed to create worker thread");
+		body(pw);
+		pw->td = 0;
+	}
+}
+
+static void join_stat_workers(struct stat_worker* workers){
+	int i=0;
+
+	for(i=0; i<nr_jobs; i++){
+		if( workers[i].td )
+			pthread_join(workers[i].td, NULL);
+	}
+	cur_shard = &shards[0];
+}
+
+void statistic_rb_traveling(){
+	struct rb_node* node;
+	struct dio_rbentity** prbens = NULL;
+	struct stat_worker workers[MAX_JOBS];
+	int i=0, cnt=0, rben_cnt=0, per=0;
+	bool is_sharded = false;
+
+	if( nr_jobs > 1 && pass_par.trv_cnt > 0 ){
+		for(node = rb_first(&rben_root); node != NULL; node = rb_next(node))
+			rben_cnt++;
+		prbens = (struct dio_rbentity**)malloc(sizeof(struct dio_rbentity*) * (rben_cnt + 1));
+		if( prbens == NULL )
+			perror("failed to allocate memory");
+	}
+
+	if( prbens != NULL ){
+		//statistics which can't be sharded are run on this thread
+		i = 0;
+		for(node = rb_first(&rben_root); node != NULL; node = rb_next(node)){
+			struct dio_rbentity* prben = NULL;
+			prben = rb_entry(node, struct dio_rbentity, rblink);
+			prbens[i++] = prben;
+
+			struct dio_nugget* pdng = NULL;
+			list_for_each_entry(pdng, &prben->nghead, nglink)
+				run_trv_fns(&pass_seq, pdng);
+		}
+
+		//each worker travels the rbentities of its sector range
+		per = (rben_cnt + nr_jobs - 1) / nr_jobs;
+		for(i=0; i<nr_jobs; i++){
+			memset(&workers[i], 0, sizeof(struct stat_worker));
+			workers[i].shard = &shards[i];
+			workers[i].prbens = prbens + (i*per < rben_cnt ? i*per : rben_cnt);
+			workers[i].rben_cnt = rben_cnt - i*per < per ? rben_cnt - i*per : per;
+			if( workers[i].rben_cnt < 0 )
+				workers[i].rben_cnt = 0;
+		}
+		for(i=0; i<nr_jobs; i++)
+			start_stat_worker(&workers[i], rb_worker_body);
+		join_stat_workers(workers);
+
+		for(i=0; i<nr_jobs; i++)
+			cnt += workers[i].ng_cnt;
+		merge_stat_shards(false);
+		free(prbens);
+		is_sharded = true;
+	}
+
+	for(node = rb_first(&rben_root); !is_sharded && node != NULL; node = rb_next(node)){
+		struct dio_rbentity* prben = NULL;
+		prben = rb_entry(node, struct dio_rbentity, rblink);
+
+		struct dio_nugget* pdng = NULL;
+		list_for_each_entry(pdng, &prben->nghead, nglink){
+			//traveling
+			run_trv_fns(&pass_all, pdng);
+			cnt++;
+		}
+	}
+
+	//process data
+	statistic_process_all(-1, cnt);
+}
+
+static void* list_worker_body(void* param){
+	struct stat_worker* pw = (struct stat_worker*)param;
+	struct list_head* p = pw->first;
+	struct stat_batch batch;
+	int i=0;
+
+	batch.nr = 0;
+	cur_shard = pw->shard;
+	for(i=0; i<pw->bit_cnt; i++, p = p->next)
+		run_itr_fns(&pass_par, &batch, &list_entry(p, struct bit_entity, link)->bit);
+	run_bat_fns(&pass_par, &batch);
+	return NULL;
+}
+
+void statistic_bit_pass(){
+	struct bit_entity* pos;
+	struct stat_worker workers[MAX_JOBS];
+	int cnt=0, per=0;
+	bool is_sharded = nr_jobs > 1 && (pass_par.itr_cnt > 0 || pass_par.bat_cnt > 0);
+
+	if( !is_sharded ){
+		list_for_each_entry(pos, &biten_head, link){
+			run_itr_fns(&pass_all, &main_batch, &pos->bit);
+			handle_bit(pos);
+			cnt++;
+		}
+		run_bat_fns(&pass_all, &main_batch);
+		statistic_process_all(cnt, -1);
+		return;
+	}
+
+	//each worker iterates the bits of its time range.
+	//worker is started as soon as lifecycle pass reaches its range,
+	//and runs with the lifecycle pass which doesn't change the bits.
+	per = (biten_cnt + nr_jobs - 1) / nr_jobs;
+	if( per == 0 )
+		per = 1;
+	memset(workers, 0, sizeof(struct stat_worker) * nr_jobs);
+	list_for_each_entry(pos, &biten_head, link){
+		if( cnt % per == 0 ){
+			struct stat_worker* pw = &workers[cnt / per];
+			pw->shard = &shards[cnt / per];
+			pw->first = &pos->link;
+			pw->bit_cnt = biten_cnt - cnt < per ? biten_cnt - cnt : per;
+			start_stat_worker(pw, list_worker_body);
+		}
+
+		//statistics which can't be sharded are run on this thread
+		run_itr_fns(&pass_seq, &main_batch, &pos->bit);
+		handle_bit(pos);
+		cnt++;
+	}
+	run_bat_fns(&pass_seq, &main_batch);
+	join_stat_workers(workers);
+
+	merge_stat_shards(true);
+	statistic_process_all(cnt, -1);
+}
+
+void init_stat_shard(struct stat_shard* pshard){
+	memset(pshard, 0, sizeof(struct stat_shard));
+	INIT_LIST_HEAD(&pshard->nugget_path_head);
+	pshard->psd_root = RB_ROOT;
+	init_class_time(pshard);
+}
+
+// bit statistic has only itr or batch callback, the others are nugget statistics.
+static inline bool is_bit_statistic(struct dio_stat_ops* ops){
+	return (ops->itr != NULL || ops->batch != NULL) && ops->trv == NULL;
+}
+
+// merge the shards of bit statistics or nugget statistics in order of partitions.
+void merge_stat_shards(bool is_bit){
+	int i=0, k=0;
+
+	for(i=0; i<stat_ops_cnt; i++){
+		if( stat_ops[i].merge == NULL || is_bit_statistic(&stat_ops[i]) != is_bit )
+			continue;
+		for(k=1; k<nr_jobs; k++)
+			stat_ops[i].merge(&shards[0], &shards[k]);
+	}
+}
+
+void statistic_init_all(){
+	int i=0;
+
+	//bit statistics are initialized first
+	for(i=0; i<stat_ops_cnt; i++){
+		if( stat_ops[i].init != NULL && is_bit_statistic(&stat_ops[i]) )
+			stat_ops[i].init();
+	}
+	for(i=0; i<stat_ops_cnt; i++){
+		if( stat_ops[i].init != NULL && !is_bit_statistic(&stat_ops[i]) )
+			stat_ops[i].init();
+	}
+}
+
+// bit statistics are processed if bit_cnt isn't negative,
+// and nugget statistics are processed if ng_cnt isn't negative.
+void statistic_process_all(int bit_cnt, int ng_cnt){
+	int i=0;
+
+	//printed bits and nuggets come before the results
+	dio_fmt_flush(&fmtbuf);
+
+	//bit statistics are processed first
+	for(i=0; bit_cnt >= 0 && i<stat_ops_cnt; i++){
+		if( stat_ops[i].proc != NULL && is_bit_statistic(&stat_ops[i]) )
+			stat_ops[i].proc(bit_cnt);
+	}
+	for(i=0; ng_cnt >= 0 && i<stat_ops_cnt; i++){
+		if( stat_ops[i].proc != NULL && !is_bit_statistic(&stat_ops[i]) )
+			stat_ops[i].proc(ng_cnt);
+	}
+}
+
+//------------------- stream mode -------------------------------------//
+void stream_push_bit(struct bit_entity* pbiten){
+	insert_proper_pos(pbiten);
+	if( stream_newest_time < pbiten->bit.time )
+		stream_newest_time = pbiten->bit.time;
+
+	//process the bits which can't be reordered anymore
+	if( stream_newest_time >= STREAM_REORDER_WINDOW )
+		stream_process_until(stream_newest_time - STREAM_REORDER_WINDOW);
+}
+
+void stream_process_until(uint64_t time){
+	struct bit_entity* p = NULL;
+
+	while( !list_empty(&biten_head) ){
+		p = list_entry(biten_head.next, struct bit_entity, link);
+		if( p->bit.time > time )
+			break;
+		list_del(&p->link);
+		stream_process_bit(p);
+	}
+}
+
+void stream_idle(){
+	uint64_t now = follow_clock();
+	uint64_t aged;
+
+	//the reorder window is aged by wall clock while no bit comes, so a bit
+	//is processed after the window of trace time or wall clock. the bits
+	//of a cpu which are flushed later within the window keep their order
+	if( stream_idle_since == 0 || stream_idle_newest != stream_newest_time ){
+		stream_idle_newest = stream_newest_time;
+		stream_idle_since = now;
+	}
+	aged = stream_newest_time + (now - stream_idle_since);
+	if( aged >= STREAM_REORDER_WINDOW )
+		stream_process_until(aged - STREAM_REORDER_WINDOW);
+}
+
+void stream_process_bit(struct bit_entity* pbiten){
+	struct dio_nugget* pdng = NULL;
+
+	run_itr_fns(&pass_all, &main_batch, &pbiten->bit);
+	stream_bit_cnt++;
+
+	pdng = handle_bit(pbiten);
+	if( pdng != NULL && pdng->mlink != NULL ){
+		//merged nugget is retired with its request
+		pdng = pdng->mlink;
+	}
+	if( pdng != NULL ){
+		//keep the active nugget list ordered by recent update time
+		list_del(&pdng->actlink);
+		list_add_tail(&pdng->actlink, &actng_head);
+
+		if( pdng->ngflag == NG_COMPLETE )
+			retire_nugget(pdng);
+	}
+
+	evict_stale_nuggets(pbiten->bit.time);
+	free(pbiten);
+}
+
+void stream_finish(){
+	struct bit_entity* p = NULL;
+	struct bit_entity* n = NULL;
+	struct dio_nugget* pdng = NULL;
+	struct dio_nugget* tmpng = NULL;
+
+	list_for_each_entry_safe(p, n, &biten_head, link){
+		list_del(&p->link);
+		stream_process_bit(p);
+	}
+
+	//uncompleted nuggets at the end of trace are given to statistics,
+	//as same as batch mode
+	list_for_each_entry_safe(pdng, tmpng, &actng_head, actlink)
+		retire_nugget(pdng);
+
+	run_bat_fns(&pass_all, &main_batch);
+	statistic_process_all(stream_bit_cnt, stream_ng_cnt);
+
+	if( stream_evict_cnt > 0 )
+		fprintf(stderr, "%d uncompleted nuggets were evicted\n", stream_evict_cnt);
+}
+
+void retire_nugget(struct dio_nugget* pdng){
+	struct dio_nugget* pmgng = NULL;
+
+	run_trv_fns(&pass_all, pdng);
+	stream_ng_cnt++;
+
+	list_for_each_entry(pmgng, &pdng->mghead, mglink){
+		run_trv_fns(&pass_all, pmgng);
+		stream_ng_cnt++;
+	}
+
+	free_nugget(pdng);
+}
+
+void evict_stale_nuggets(uint64_t now){
+	struct dio_nugget* pdng = NULL;
+
+	while( !list_empty(&actng_head) ){
+		pdng = list_entry(actng_head.next, struct dio_nugget, actlink);
+		if( pdng->times[pdng->elemidx-1] + evict_timeout >= now )
+			break;
+
+		free_nugget(pdng);
+		stream_evict_cnt++;
+	}
+}
+
+void free_nugget(struct dio_nugget* pdng){
+	struct dio_rbentity* prben = pdng->prben;
+	struct dio_nugget* pmgng = NULL;
+	struct dio_nugget* tmpng = NULL;
+
+	//merged nuggets are freed with their request
+	list_for_each_entry_safe(pmgng, tmpng, &pdng->mghead, mglink){
+		list_del_init(&pmgng->mglink);
+		pmgng->mlink = NULL;
+		free_nugget(pmgng);
+	}
+	list_del(&pdng->mglink);
+
+	unindex_nugget(pdng);
+	list_del(&pdng->actlink);
+	list_del(&pdng->nglink);
+	if( list_empty(&prben->nghead) ){
+		rb_erase(&prben->rblink, &rben_root);
+		free(prben);
+	}
+	free(pdng);
+}
+
+//------------------- printing -------------------------------------//
+// "%5d.%09lu\t%llu\t%u\t%u\n" of time, sector, pid, bytes/8
+void print_time(struct blk_io_trace* pbit) {
+	char* p = dio_fmt_reserve(&fmtbuf, 4 * DIO_FMT_MAX_FIELD);
+
+	p = dio_fmt_seconds(p, pbit->time);
+	p = dio_fmt_char(p, '\t');
+	p = dio_fmt_u64(p, pbit->sector);
+	p = dio_fmt_char(p, '\t');
+	p = dio_fmt_u64(p, pbit->pid);
+	p = dio_fmt_char(p, '\t');
+	p = dio_fmt_u64(p, pbit->bytes/8);
+	p = dio_fmt_char(p, '\n');
+	dio_fmt_commit(&fmtbuf, p);
+}
+
+// "%"PRIu64"\t%5d.%09lu\t%u\t%d\n" of sector, latency, pid, size
+void print_sector(struct dio_nugget* pdng) {
+	uint64_t tmpt = 0;
+	char* p = dio_fmt_reserve(&fmtbuf, 4 * DIO_FMT_MAX_FIELD);
+
+	tmpt = pdng->times[pdng->elemidx-1] - pdng->times[0];
+	p = dio_fmt_u64(p, pdng->sector);
+	p = dio_fmt_char(p, '\t');
+	p = dio_fmt_seconds(p, tmpt);
+	p = dio_fmt_char(p, '\t');
+	p = dio_fmt_u64(p, pdng->pid);
+	p = dio_fmt_char(p, '\t');
+	p = dio_fmt_int(p, pdng->size);
+	p = dio_fmt_char(p, '\n');
+	dio_fmt_commit(&fmtbuf, p);
+}
+
+//------------------- exporters -------------------------------------//
+// records are put on fmtbuf directly, so nothing is allocated for them.
+// times are in nanoseconds. empty field (null of JSON) means that
+// the nugget doesn't have the state.
+#define EXPORT_MAX_RECORD ((MAX_ELEMENT_SIZE + 16) * DIO_FMT_MAX_FIELD)
+
+// R, W, D, F, S, M, A of category like blkparse
+static char* export_rwbs(char* p, uint32_t category)
+{
+	char* start = p;
+
+	if(category & BLK_TC_FLUSH)
+		*p++ = 'F';
+	if(category & BLK_TC_DISCARD)
+		*p++ = 'D';
+	else if(category & BLK_TC_WRITE)
+		*p++ = 'W';
+	else if(category & BLK_TC_READ)
+		*p++ = 'R';
+	if(category & BLK_TC_FUA)
+		*p++ = 'F';
+	if(category & BLK_TC_AHEAD)
+		*p++ = 'A';
+	if(category & BLK_TC_SYNC)
+		*p++ = 'S';
+	if(category & BLK_TC_META)
+		*p++ = 'M';
+	if(p == start)
+		*p++ = 'N';
+	return p;
+}
+
+// separator and the key of JSON
+static char* export_key(char* p, const char* key, bool first)
+{
+	if(!first)
+	{
+		*p++ = ',';
+	}
+	if(export_type == EXPORT_TYPE_JSONL)
+	{
+		*p++ = '"';
+		p = dio_fmt_str(p, key);
+		p = dio_fmt_str(p, "\":");
+	}
+	return p;
+}
+
+// string value which is quoted on JSON
+static char* export_quote(char* p)
+{
+	if(export_type == EXPORT_TYPE_JSONL)
+	{
+		*p++ = '"';
+	}
+	return p;
+}
+
+static char* export_null(char* p)
+{
+	return export_type == EXPORT_TYPE_JSONL ? dio_fmt_str(p, "null") : p;
+}
+
+static char* export_comm(char* p, uint32_t pid)
+{
+	const char* comm = lookup_comm(pid);
+
+	if(comm == NULL)
+	{
+		return export_null(p);
+	}
+	return export_type == EXPORT_TYPE_JSONL ? dio_fmt_json_str(p, comm) : dio_fmt_csv_str(p, comm);
+}
+
+// time from the state of 'from' (or the first state) to the next state of 'to'
+static char* export_phase(char* p, struct dio_nugget* pdng, char from, char to)
+{
+	int f = 0;
+	int t = 0;
+
+	if(from != 0)
+	{
+		for(f=0 ; f<pdng->elemidx && pdng->states[f] != from ; f++);
+	}
+	for(t=f+1 ; t<pdng->elemidx && pdng->states[t] != to ; t++);
+
+	if(f >= pdng->elemidx || t >= pdng->elemidx)
+	{
+		return export_null(p);
+	}
+	return dio_fmt_u64(p, pdng->times[t] - pdng->times[f]);
+}
+
+void init_export_time(void)
+{
+	char* p;
+
+	if(export_type == EXPORT_TYPE_CSV)
+	{
+		p = dio_fmt_reserve(&fmtbuf, EXPORT_MAX_RECORD);
+		p = dio_fmt_str(p, "time,cpu,pid,comm,action,rwbs,sector,bytes,error,device\n");
+		dio_fmt_commit(&fmtbuf, p);
+	}
+}
+
+void export_time(struct blk_io_trace* pbit)
+{
+	unsigned int act = pbit->action & 0xffff;
+	char actc = act < NR_LIFECYCLE_ACTION ? lifecycle_table[act].actc : 0;
+	char* p = dio_fmt_reserve(&fmtbuf, EXPORT_MAX_RECORD);
+
+	if(export_type == EXPORT_TYPE_JSONL)
+	{
+		*p++ = '{';
+	}
+	p = export_key(p, "time", true);
+	p = dio_fmt_u64(p, pbit->time);
+	p = export_key(p, "cpu", false);
+	p = dio_fmt_u64(p, pbit->cpu);
+	p = export_key(p, "pid", false);
+	p = dio_fmt_u64(p, pbit->pid);
+	p = export_key(p, "comm", false);
+	p = export_comm(p, pbit->pid);
+	p = export_key(p, "action", false);
+	if(actc != 0)
+	{
+		p = export_quote(p);
+		*p++ = actc;
+		p = export_quote(p);
+	}
+	else
+	{
+		p = export_null(p);
+	}
+	p = export_key(p, "rwbs", false);
+	p = export_quote(p);
+	p = export_rwbs(p, pbit->action >> BLK_TC_SHIFT);
+	p = export_quote(p);
+	p = export_key(p, "sector", false);
+	p = dio_fmt_u64(p, pbit->sector);
+	p = export_key(p, "bytes", false);
+	p = dio_fmt_u64(p, pbit->bytes);
+	p = export_key(p, "error", false);
+	p = dio_fmt_u64(p, pbit->error);
+	p = export_key(p, "device", false);
+	p = dio_fmt_u64(p, pbit->device);
+	if(export_type == EXPORT_TYPE_JSONL)
+	{
+		*p++ = '}';
+	}
+	*p++ = '\n';
+	dio_fmt_commit(&fmtbuf, p);
+}
+
+void init_export_sector(void)
+{
+	char* p;
+
+	if(export_type == EXPORT_TYPE_CSV)
+	{
+		p = dio_fmt_reserve(&fmtbuf, EXPORT_MAX_RECORD);
+		p = dio_fmt_str(p, "sector,size,pid,comm,rwbs,merge,path,start,q2d,d2c,q2c,times\n");
+		dio_fmt_commit(&fmtbuf, p);
+	}
+}
+
+void export_sector(struct dio_nugget* pdng)
+{
+	char* p = dio_fmt_reserve(&fmtbuf, EXPORT_MAX_RECORD);
+	int i;
+
+	if(export_type == EXPORT_TYPE_JSONL)
+	{
+		*p++ = '{';
+	}
+	p = export_key(p, "sector", true);
+	p = dio_fmt_u64(p, pdng->sector);
+	p = export_key(p, "size", false);
+	p = dio_fmt_int(p, pdng->size);
+	p = export_key(p, "pid", false);
+	p = dio_fmt_u64(p, pdng->pid);
+	p = export_key(p, "comm", false);
+	p = export_comm(p, pdng->pid);
+	p = export_key(p, "rwbs", false);
+	p = export_quote(p);
+	p = export_rwbs(p, pdng->category);
+	p = export_quote(p);
+	p = export_key(p, "merge", false);
+	if(pdng->ngflag == NG_BACKMERGE || pdng->ngflag == NG_FRONTMERGE)
+	{
+		p = export_quote(p);
+		p = dio_fmt_str(p, pdng->ngflag == NG_BACKMERGE ? "back" : "front");
+		p = export_quote(p);
+	}
+	else
+	{
+		p = export_null(p);
+	}
+	p = export_key(p, "path", false);
+	p = export_quote(p);
+	for(i=0 ; i<pdng->elemidx ; i++)
+	{
+		*p++ = pdng->states[i];
+	}
+	p = export_quote(p);
+
+	// per-phase times. queue to issue, issue to complete and total
+	p = export_key(p, "start", false);
+	p = dio_fmt_u64(p, pdng->elemidx > 0 ? pdng->times[0] : 0);
+	p = export_key(p, "q2d", false);
+	p = export_phase(p, pdng, 0, 'D');
+	p = export_key(p, "d2c", false);
+	p = export_phase(p, pdng, 'D', 'C');
+	p = export_key(p, "q2c", false);
+	p = export_phase(p, pdng, 0, 'C');
+
+	// and the time of each state from the first state
+	p = export_key(p, "times", false);
+	if(export_type == EXPORT_TYPE_JSONL)
+	{
+		*p++ = '[';
+	}
+	for(i=0 ; i<pdng->elemidx ; i++)
+	{
+		if(i > 0)
+		{
+			*p++ = export_type == EXPORT_TYPE_JSONL ? ',' : ';';
+		}
+		p = dio_fmt_u64(p, pdng->times[i] - pdng->times[0]);
+	}
+	if(export_type == EXPORT_TYPE_JSONL)
+	{
+		p = dio_fmt_str(p, "]}");
+	}
+	*p++ = '\n';
+	dio_fmt_commit(&fmtbuf, p);
+}
+
+//------------------- i/o type statistics -------------------------------//
+void init_type_statistic(){
+	cur_shard->r_cnt = cur_shard->w_cnt = cur_shard->x_cnt = 0;
+	memset(cur_shard->class_cnt, 0, sizeof(cur_shard->class_cnt));
+}
+
+// read has priority over write, as same as the other statistics
+void batch_type_statistic(const struct dio_bit_batch* pbat){
+	const uint32_t* action = pbat->action;
+	int r_cnt = 0, w_cnt = 0;
+	int class_cnt[CLASS_PLAIN] = { 0, };
+	int i, k;
+
+	for(i=0; i<pbat->nr; i++){
+		uint32_t category = action[i] >> BLK_TC_SHIFT;
+		int is_r = (category & BLK_TC_READ) != 0;
+
+		r_cnt += is_r;
+		w_cnt += !is_r & ((category & BLK_TC_WRITE) != 0);
+		for(k=0; k<CLASS_PLAIN; k++)
+			class_cnt[k] += (category & class_table[k].mask) != 0;
+	}
+	cur_shard->r_cnt += r_cnt;
+	cur_shard->w_cnt += w_cnt;
+	cur_shard->x_cnt += pbat->nr - r_cnt - w_cnt;
+	for(k=0; k<CLASS_PLAIN; k++)
+		cur_shard->class_cnt[k] += class_cnt[k];
+}
+
+void process_type_statistic(int bit_cnt){
+	int r_cnt = cur_shard->r_cnt;
+	int w_cnt = cur_shard->w_cnt;
+	int x_cnt = cur_shard->x_cnt;
+	int tot, i;
+	fprintf(output, "%7s %10s %13s\n", "TYPE","COUNT","PERCENTAGE");
+	
+	fprintf(output, "%7s %10d %13f\n", "R",r_cnt, r_cnt/(double)bit_cnt*100);
+	fprintf(output, "%7s %10d %13f\n", "W",w_cnt,w_cnt/(double)bit_cnt*100);
+	fprintf(output, "%7s %10d %13f\n", "Unknown",x_cnt, x_cnt/(double)bit_cnt*100);
+
+	tot = r_cnt + w_cnt + x_cnt;
+	fprintf(output, "%7s %10d %13f\n", "Total :",tot, tot/(double)bit_cnt*100);
+
+	//classes are overlapped, so they are not in the total
+	for(i=0; i<CLASS_PLAIN; i++)
+		fprintf(output, "%7s %10d %13f\n", class_table[i].name,
+			cur_shard->class_cnt[i], cur_shard->class_cnt[i]/(double)bit_cnt*100);
+}
+
+void merge_type_statistic(struct stat_shard* dst, struct stat_shard* src){
+	int i;
+
+	dst->r_cnt += src->r_cnt;
+	dst->w_cnt += src->w_cnt;
+	dst->x_cnt += src->x_cnt;
+	for(i=0; i<CLASS_PLAIN; i++)
+		dst->class_cnt[i] += src->class_cnt[i];
+}
+
+//------------------- path statistics ------------------------------//
 FILE*	fPathData = NULL;
 
-int instr(const char* str1, const char* str2)
+int instr(const char* str1, const char* str2)
+{
+        int i, j;
+
+        i=0;
+        while(str1[i] != '\0')
+        {
+                j=0;
+                while(str2[j] != '\0')
+                {
+                        if(str1[i+j] != str2[j])
+                        {
+                                break;
+                        }
+                        j++;
+                }
+                if(str2[j] == '\0')
+                {
+                        return i+1;
+                }
+                i++;
+        }
+
+        return 0;
+}
+
+// return the slot of path on the dense path array of shard.
+// the array grows as the path trie grows
+struct dio_nugget_path** path_slot(struct stat_shard* pshard, int pathid)
+{
+	struct dio_nugget_path** paths;
+	int size;
+
+	if(pathid < 0)
+	{
+		return NULL;
+	}
+
+	if(pathid >= pshard->paths_size)
+	{
+		size = pshard->paths_size ? pshard->paths_size : INIT_PATH_TRIE_SIZE;
+		while(size <= pathid)
+		{
+			size *= 2;
+		}
+
+		paths = (struct dio_nugget_path**)realloc(pshard->paths, sizeof(struct dio_nugget_path*) * size);
+		if(paths == NULL)
+		{
+			return NULL;
+		}
+		memset(paths + pshard->paths_size, 0, sizeof(struct dio_nugget_path*) * (size - pshard->paths_size));
+		pshard->paths = paths;
+		pshard->paths_size = size;
+	}
+
+	return &pshard->paths[pathid];
+}
+
+void init_path_statistic(void)
+{
+	if(is_graphic)
+	{
+		fPathData = fopen("dioparse.path.dat", "wt");
+		if(!fPathData)
+		{
+			DBGOUT("dioparse.path.dat open error \n");
+		}
+	}
+}
+
+void travel_path_statistic(struct dio_nugget* pdng)
+{
+	char* 			pstates;
+	uint64_t*		ptimes;
+	int*			pelemidx;
+	int			i;
+	uint64_t		nugget_time;
+	struct data_time*	pdata_time;
+	struct data_time*	pdata_time_interval;
+	struct dio_nugget_path*	pnugget_path;
+	struct dio_nugget_path**	ppath;
+	
+	if(is_failed_nugget(pdng))
+	{
+		return ;
+	}
+
+	ppath = path_slot(cur_shard, pdng->pathid);
+	if(ppath == NULL)
+	{
+		return ;
+	}
+
+	pnugget_path = *ppath;
+	if(pnugget_path == NULL)	// if not exist
+	{
+		pnugget_path = (struct dio_nugget_path*)malloc(sizeof(struct dio_nugget_path));
+		memset(pnugget_path, 0, sizeof(struct dio_nugget_path));
+
+		// Init pnugget_path's members
+		pnugget_path->pathid = pdng->pathid;
+		pnugget_path->elemidx = pdng->elemidx;
+		init_data_time(&pnugget_path->data_time_read);
+		init_data_time(&pnugget_path->data_time_write);
+		for(i=0 ; i<pnugget_path->elemidx ; i++)
+		{
+			init_data_time(&pnugget_path->data_time_interval_read[i]);
+			init_data_time(&pnugget_path->data_time_interval_write[i]);
+		}
+		strncpy(pnugget_path->states, pdng->states, MAX_ELEMENT_SIZE);
+
+		// Add list
+		list_add(&(pnugget_path->link), &cur_shard->nugget_path_head);
+		*ppath = pnugget_path;
+	}
+	
+	// Add read/write count to distribute those.
+	if(pdng->category & BLK_TC_READ)
+	{
+		pdata_time = &pnugget_path->data_time_read;
+		pdata_time_interval = pnugget_path->data_time_interval_read;
+	}
+	else if(pdng->category & BLK_TC_WRITE)
+	{
+		pdata_time = &pnugget_path->data_time_write;
+		pdata_time_interval = pnugget_path->data_time_interval_write;
+	}
+	else
+	{
+		DBGOUT("%x \n", pdng->category);
+		return ;
+	}
+
+	// Set data on pnugget_path.
+	nugget_time = pdng->times[pnugget_path->elemidx-1] - pdng->times[0];
+	add_data_time(pdata_time, nugget_time);
+
+	// Set data on pnugget_path->data_time_interval
+	for(i=0 ; i<pnugget_path->elemidx-1 ; i++)
+	{
+		add_data_time(&pdata_time_interval[i], pdng->times[i+1] - pdng->times[i]);
+	}
+}
+
+
+void process_path_statistic(int ng_cnt)
+{
+	int i;
+	struct dio_nugget_path* pnugget_path;
+
+	if(is_graphic)
+	{
+		fprintf(fPathData, "%s %s %s\n", "path", "read", "write");
+	}
+	else
+	{
+		fprintf(output,"%20s %6s ", "Path", "Type");
+		print_data_time_header(output);
+		fprintf(output, "\n");
+	}
+
+	list_for_each_entry(pnugget_path, &cur_shard->nugget_path_head, link)
+	{
+		// Calculate average time(path)
+		finish_data_time(&pnugget_path->data_time_read);
+		finish_data_time(&pnugget_path->data_time_write);
+
+		// Calculate average time(interval)
+		for(i=0 ; i<pnugget_path->elemidx ; i++)
+		{
+			finish_data_time(&pnugget_path->data_time_interval_read[i]);
+			finish_data_time(&pnugget_path->data_time_interval_write[i]);
+		}
+
+		if(instr(pnugget_path->states, "P") || instr(pnugget_path->states, "U") || instr(pnugget_path->states, "?"))
+		{
+			continue;
+		}
+
+		if(is_graphic)
+		{
+			print_path_statistic_graphic(pnugget_path);
+		}
+		else
+		{
+			print_path_statistic_text(pnugget_path);
+		}
+	}
+
+	// Free all dynamic allocated variables.
+	struct dio_nugget_path* tmpdng_path;
+
+	list_for_each_entry_safe(pnugget_path, tmpdng_path, &cur_shard->nugget_path_head, link)
+	{
+		list_del(&pnugget_path->link);
+		clear_data_time(&pnugget_path->data_time_read);
+		clear_data_time(&pnugget_path->data_time_write);
+		for(i=0 ; i<pnugget_path->elemidx ; i++)
+		{
+			clear_data_time(&pnugget_path->data_time_interval_read[i]);
+			clear_data_time(&pnugget_path->data_time_interval_write[i]);
+		}
+		free(pnugget_path);
+	}
+	free(cur_shard->paths);
+	cur_shard->paths = NULL;
+	cur_shard->paths_size = 0;
+
+	if(fPathData != NULL)
+	{
+		fclose(fPathData);
+		system("gnuplot path.cmd -p");
+	}
+}
+
+void merge_path_statistic(struct stat_shard* dst, struct stat_shard* src)
+{
+	int i;
+	struct dio_nugget_path* psrc_path;
+	struct dio_nugget_path* pdst_path;
+	struct dio_nugget_path* tmpdng_path;
+	struct dio_nugget_path** ppath;
+
+	// Paths are added at the head of list as they are found,
+	// so the oldest path of src is merged first.
+	list_for_each_entry_safe_reverse(psrc_path, tmpdng_path, &src->nugget_path_head, link)
+	{
+		list_del(&psrc_path->link);
+
+		ppath = path_slot(dst, psrc_path->pathid);
+		if(ppath == NULL)
+		{
+			for(i=0 ; i<psrc_path->elemidx ; i++)
+			{
+				clear_data_time(&psrc_path->data_time_interval_read[i]);
+				clear_data_time(&psrc_path->data_time_interval_write[i]);
+			}
+			clear_data_time(&psrc_path->data_time_read);
+			clear_data_time(&psrc_path->data_time_write);
+			free(psrc_path);
+			continue;
+		}
+
+		pdst_path = *ppath;
+		if(pdst_path == NULL)
+		{
+			list_add(&psrc_path->link, &dst->nugget_path_head);
+			*ppath = psrc_path;
+			continue;
+		}
+
+		merge_data_time(&pdst_path->data_time_read, &psrc_path->data_time_read);
+		merge_data_time(&pdst_path->data_time_write, &psrc_path->data_time_write);
+		for(i=0 ; i<pdst_path->elemidx ; i++)
+		{
+			merge_data_time(&pdst_path->data_time_interval_read[i], &psrc_path->data_time_interval_read[i]);
+			merge_data_time(&pdst_path->data_time_interval_write[i], &psrc_path->data_time_interval_write[i]);
+		}
+
+		free(psrc_path);
+	}
+	free(src->paths);
+	src->paths = NULL;
+	src->paths_size = 0;
+}
+
+void print_path_statistic_graphic(struct dio_nugget_path* pnugget_path)
+{
+	fprintf(fPathData, "%s %"PRIu64" %"PRIu64"\n", pnugget_path->states, pnugget_path->data_time_read.count, pnugget_path->data_time_write.count);
+}
+
+void print_path_statistic_text(struct dio_nugget_path* pnugget_path)
+{
+	int i;
+
+	//printing
+	fprintf(output, "%20s %6s ", pnugget_path->states, "Read");
+	print_data_time_statistic(output, &pnugget_path->data_time_read);
+	fprintf(output, "\n");
+
+	fprintf(output, "%20s %6s ", " ", "Write");
+	print_data_time_statistic(output, &pnugget_path->data_time_write);
+	fprintf(output, "\n");
+
+	for(i=0 ; i<pnugget_path->elemidx-1 ; i++)
+	{
+		fprintf(output, "%18s%.2s %6s ", " ", &pnugget_path->states[i], "Read");
+		print_data_time_statistic(output, &pnugget_path->data_time_interval_read[i]);
+		if(pnugget_path->data_time_read.average_time != 0)
+		{
+			fprintf(output, " %2.2f%%", ((double)pnugget_path->data_time_interval_read[i].average_time / pnugget_path->data_time_read.average_time) * 100);
+		}
+		else
+		{
+			fprintf(output, " %2.2f%%", 0.0);
+		}
+		fprintf(output, "\n");
+
+		fprintf(output, "%20s %6s ", " ", "Write");
+		print_data_time_statistic(output, &pnugget_path->data_time_interval_write[i]);
+		if(pnugget_path->data_time_write.average_time != 0)
+		{
+			fprintf(output, " %2.2f%%", ((double)pnugget_path->data_time_interval_write[i].average_time / pnugget_path->data_time_write.average_time) * 100);
+		}
+		else
+		{
+			fprintf(output, " %2.2f%%", 0.0);
+		}
+		fprintf(output, "\n");
+	}
+	fprintf(output, "\n");
+}
+
+//------------------- data_time ------------------------------//
+void init_data_time(struct data_time* pdata_time)
+{
+	memset(pdata_time, 0, sizeof(struct data_time));
+	pdata_time->min_time = (uint64_t)(-1);
+}
+
+void add_data_time(struct data_time* pdata_time, uint64_t time)
+{
+	pdata_time->count++;
+	pdata_time->total_time += time;
+	if(pdata_time->max_time < time)
+	{
+		pdata_time->max_time = time;
+	}
+	if(pdata_time->min_time > time)
+	{
+		pdata_time->min_time = time;
+	}
+
+	if(pdata_time->hist == NULL)
+	{
+		pdata_time->hist = dio_hist_create();
+	}
+	if(pdata_time->hist != NULL)
+	{
+		dio_hist_record(pdata_time->hist, time);
+	}
+}
+
+void merge_data_time(struct data_time* dst, struct data_time* src)
+{
+	dst->count += src->count;
+	dst->total_time += src->total_time;
+	if(dst->max_time < src->max_time)
+	{
+		dst->max_time = src->max_time;
+	}
+	if(dst->min_time > src->min_time)
+	{
+		dst->min_time = src->min_time;
+	}
+
+	if(dst->hist == NULL)
+	{
+		dst->hist = src->hist;
+	}
+	else if(src->hist != NULL)
+	{
+		dio_hist_merge(dst->hist, src->hist);
+		dio_hist_destroy(src->hist);
+	}
+	src->hist = NULL;
+}
+
+void finish_data_time(struct data_time* pdata_time)
+{
+	if(pdata_time->count != 0)
+	{
+		pdata_time->average_time = pdata_time->total_time / pdata_time->count;
+	}
+
+	// if min_time is -1 that initializing value for calculating min_time, change that to 0.
+	if(pdata_time->min_time == (uint64_t)(-1))
+	{
+		pdata_time->min_time = 0;
+	}
+}
+
+void clear_data_time(struct data_time* pdata_time)
+{
+	dio_hist_destroy(pdata_time->hist);
+	pdata_time->hist = NULL;
+}
+
+void print_data_time_header(FILE* stream)
+{
+	int i;
+	char name[16];
+
+	fprintf(stream, "%6s %12s %12s %12s", "No", "AverageTime", "MaxTime", "MinTime");
+	for(i=0 ; i<nr_percentiles ; i++)
+	{
+		snprintf(name, sizeof(name), "p%g", percentiles[i]);
+		fprintf(stream, " %12s", name);
+	}
+}
+
+void print_data_time_statistic(FILE* stream, struct data_time* pdata_time)
+{
+	int i;
+	uint64_t time;
+
+	fprintf(stream, "%6"PRIu64" %2llu.%.9llu %2llu.%.9llu %2llu.%.9llu", pdata_time->count,
+			SECONDS(pdata_time->average_time), NANO_SECONDS(pdata_time->average_time),
+			SECONDS(pdata_time->max_time), NANO_SECONDS(pdata_time->max_time),
+			SECONDS(pdata_time->min_time), NANO_SECONDS(pdata_time->min_time)
+	       );
+
+	for(i=0 ; i<nr_percentiles ; i++)
+	{
+		time = dio_hist_percentile(pdata_time->hist, percentiles[i]);
+		fprintf(stream, " %2llu.%.9llu", SECONDS(time), NANO_SECONDS(time));
+	}
+}
+
+//---------------------------------------- pid statistic -------------------------------------------------//
+//function for handling data structure for pid statistic
+struct pid_stat_data* rb_search_psd(struct rb_root* root, uint32_t pid){
+	struct rb_node* n = root->rb_node;
+	struct pid_stat_data* ppsd = NULL;
+	
+	while(n){
+		ppsd = rb_entry(n, struct pid_stat_data, link);
+
+		if( pid < ppsd->pid )
+			n = n->rb_left;
+		else if( pid > ppsd->pid )
+			n = n->rb_right;
+		else 
+			return ppsd;
+	}
+	return NULL;
+}
+
+struct pid_stat_data* __rb_insert_psd(struct rb_root* root, struct pid_stat_data* newpsd){
+	struct pid_stat_data* ret;
+	struct rb_node** p = &(root->rb_node);
+	struct rb_node* parent = NULL;
+	
+	while(*p){
+		parent = *p;
+		ret = rb_entry(parent, struct pid_stat_data, link);
+
+		if( newpsd->pid < ret->pid )
+			p = &(*p)->rb_left;
+		else if( newpsd->pid > ret->pid )
+			p = &(*p)->rb_right;
+		else
+			return ret;
+	}
+
+	rb_link_node(&newpsd->link, parent, p);
+	return NULL;
+}
+
+struct pid_stat_data* rb_insert_psd(struct rb_root* root, struct pid_stat_data* newpsd){
+	struct pid_stat_data* ret = NULL;
+	if( (ret = __rb_insert_psd(root, newpsd) ) )
+		return ret;
+	rb_insert_color(&newpsd->link, root);
+	return ret;
+}
+
+void __clear_pid_stat(struct rb_node* p){
+	if( p->rb_left != NULL )
+		__clear_pid_stat(p->rb_left);
+	if( p->rb_right != NULL )
+		__clear_pid_stat(p->rb_right);
+	
+	struct pid_stat_data* psd = rb_entry(p, struct pid_stat_data, link);
+	clear_data_time(&psd->data_time_read);
+	clear_data_time(&psd->data_time_write);
+	free(psd);
+}
+
+FILE* fPidData = NULL;
+void init_pid_statistic()
+{
+	if(is_graphic)
+	{
+		fPidData = fopen("dioparse.pid.dat", "wt");
+		if(!fPidData)
+		{
+			DBGOUT("dioparse.pid.dat open error \n");
+			return ;
+		}
+	}
+}
+
+void travel_pid_statistic(struct dio_nugget* pdng){
+	struct pid_stat_data* ppsd = NULL;
+
+	if( is_failed_nugget(pdng) )
+		return;
+
+	ppsd = rb_search_psd(&cur_shard->psd_root, pdng->pid);
+	if( ppsd == NULL ){
+		ppsd = (struct pid_stat_data*)malloc(sizeof(struct pid_stat_data));
+		ppsd->pid = pdng->pid;
+		ppsd->nr_pids = 1;
+		init_data_time(&ppsd->data_time_read);
+		init_data_time(&ppsd->data_time_write);
+		
+		rb_insert_psd(&cur_shard->psd_root, ppsd);
+	}
+	
+	uint64_t tmpt = 0;
+	if( pdng->category & BLK_TC_READ ){
+		tmpt = pdng->times[pdng->elemidx-1] - pdng->times[0];
+		add_data_time(&ppsd->data_time_read, tmpt);
+	}
+	else if( pdng->category & BLK_TC_WRITE ){
+		tmpt = pdng->times[pdng->elemidx-1] - pdng->times[0];
+		add_data_time(&ppsd->data_time_write, tmpt);
+	}
+}
+
+void process_pid_statistic(int ng_cnt){
+	struct rb_node* node = NULL;
+	const char* comm = NULL;
+	char name[32];
+
+	if(is_group_comm)
+	{
+		group_pid_statistic(&cur_shard->psd_root);
+	}
+
+	if(is_graphic)
+	{
+		fprintf(fPidData, "%s %s %s\n", "pid", "read", "write");
+	}
+	else
+	{
+		fprintf(output,"%10s %16s %6s ", "pid", "Command", "Type");
+		print_data_time_header(output);
+		fprintf(output, "\n");
+	}
+	for(node = rb_first(&cur_shard->psd_root); node != NULL; node = rb_next(node)){
+		struct pid_stat_data* ppsd = NULL;
+		ppsd = rb_entry(node, struct pid_stat_data, link);
+		
+		finish_data_time(&ppsd->data_time_read);
+		finish_data_time(&ppsd->data_time_write);
+
+		//the group of several pids shows the count of them instead of pid.
+		//the pid which has no command name is not grouped
+		comm = lookup_comm(ppsd->pid);
+		if(ppsd->nr_pids > 1)
+		{
+			snprintf(name, sizeof(name), "%u pids", ppsd->nr_pids);
+		}
+		else
+		{
+			snprintf(name, sizeof(name), "%"PRIu32, ppsd->pid);
+		}
+
+		//printing
+		if(is_graphic)
+		{
+			//the label of graph is command name if it is known
+			if(comm != NULL && ppsd->nr_pids > 1)
+			{
+				print_pid_statistic_graphic(comm, ppsd);
+			}
+			else if(comm != NULL)
+			{
+				snprintf(name, sizeof(name), "%"PRIu32"(%s)", ppsd->pid, comm);
+				print_pid_statistic_graphic(name, ppsd);
+			}
+			else
+			{
+				snprintf(name, sizeof(name), "%"PRIu32, ppsd->pid);
+				print_pid_statistic_graphic(name, ppsd);
+			}
+		}
+		else
+		{
+			print_pid_statistic_text(name, comm != NULL ? comm : "-", ppsd);
+		}
+	}
+
+	//clear all pid tree
+	struct rb_node* parent = cur_shard->psd_root.rb_node;
+	if( parent != NULL )
+		__clear_pid_stat(parent);
+	cur_shard->psd_root = RB_ROOT;
+
+	if(fPidData != NULL)
+	{
+		fclose(fPidData);
+		system("gnuplot pid.cmd -p");
+	}
+}
+
+void merge_pid_statistic(struct stat_shard* dst, struct stat_shard* src){
+	struct rb_node* node = NULL;
+	struct pid_stat_data* psrc = NULL;
+	struct pid_stat_data* pdst = NULL;
+
+	while( (node = rb_first(&src->psd_root)) != NULL ){
+		rb_erase(node, &src->psd_root);
+		psrc = rb_entry(node, struct pid_stat_data, link);
+
+		pdst = rb_search_psd(&dst->psd_root, psrc->pid);
+		if( pdst == NULL ){
+			rb_insert_psd(&dst->psd_root, psrc);
+			continue;
+		}
+
+		merge_data_time(&pdst->data_time_read, &psrc->data_time_read);
+		merge_data_time(&pdst->data_time_write, &psrc->data_time_write);
+		clear_data_time(&psrc->data_time_read);
+		clear_data_time(&psrc->data_time_write);
+		free(psrc);
+	}
+}
+
+void group_pid_statistic(struct rb_root* root)
+{
+	struct rb_node* node = NULL;
+	struct rb_node* next = NULL;
+	struct pid_stat_data* ppsd = NULL;
+	struct pid_stat_data* pgroup = NULL;
+	struct dio_hash groups;
+	const char* comm = NULL;
+	uint64_t key;
+
+	// groups are found by the string hash of command name.
+	// on collision, the next keys are probed until the name matches
+	if(!dio_hash_init(&groups, INIT_COMM_HASH_SIZE))
+	{
+		DBGOUT("failed to allocate comm group hash \n");
+		return ;
+	}
+
+	for(node = rb_first(root); node != NULL; node = next){
+		next = rb_next(node);
+		ppsd = rb_entry(node, struct pid_stat_data, link);
+		comm = lookup_comm(ppsd->pid);
+		if(comm == NULL)
+		{
+			continue;
+		}
+
+		key = 5381;
+		while(*comm)
+		{
+			key = key * 33 + (unsigned char)*comm++;
+		}
+		comm = lookup_comm(ppsd->pid);
+
+		for(pgroup = (struct pid_stat_data*)dio_hash_lookup(&groups, key);
+			pgroup != NULL && strcmp(lookup_comm(pgroup->pid), comm) != 0;
+			pgroup = (struct pid_stat_data*)dio_hash_lookup(&groups, ++key));
+		if(pgroup == NULL)
+		{
+			dio_hash_insert(&groups, key, ppsd);
+			continue;
+		}
+
+		rb_erase(node, root);
+		merge_data_time(&pgroup->data_time_read, &ppsd->data_time_read);
+		merge_data_time(&pgroup->data_time_write, &ppsd->data_time_write);
+		pgroup->nr_pids += ppsd->nr_pids;
+		clear_data_time(&ppsd->data_time_read);
+		clear_data_time(&ppsd->data_time_write);
+		free(ppsd);
+	}
+	dio_hash_destroy(&groups);
+}
+
+void print_pid_statistic_graphic(const char* name, struct pid_stat_data* ppsd)
+{
+	char label[64];
+	int i;
+
+	// columns of data file are separated by space, so the command name
+	// can't have the spaces in it
+	snprintf(label, sizeof(label), "%s", name);
+	for(i=0 ; label[i] != '\0' ; i++)
+	{
+		if(isspace((unsigned char)label[i]))
+		{
+			label[i] = '_';
+		}
+	}
+	fprintf(fPidData, "%s %"PRIu64" %"PRIu64"\n", label, ppsd->data_time_read.count, ppsd->data_time_write.count);
+}
+void print_pid_statistic_text(const char* name, const char* comm, struct pid_stat_data* ppsd)
+{
+	fprintf(output, "%10s %16s %6s ", name, comm, "Read");
+	print_data_time_statistic(output, &ppsd->data_time_read);
+	fprintf(output, "\n");
+
+	fprintf(output, "%10s %16s %6s ", " ", " ", "Write");
+	print_data_time_statistic(output, &ppsd->data_time_write);
+	fprintf(output, "\n");
+	fprintf(output, "\n");
+}
+
+//------------------- series statistics ------------------------------//
+static struct series_bucket series_ring[SERIES_RING_SIZE];
+static uint64_t series_base;		//interval index of the oldest bucket on ring
+static bool series_started;
+static struct series_row* series_rows;	//closed buckets from series_first
+static uint64_t series_first;
+static uint64_t series_row_cnt;
+static uint64_t series_row_size;
+
+void init_series_statistic(void)
+{
+	memset(series_ring, 0, sizeof(series_ring));
+	series_started = false;
+	series_rows = NULL;
+	series_row_cnt = series_row_size = 0;
+}
+
+// return the closed row of interval index 'idx'
+struct series_row* series_row_at(uint64_t idx)
+{
+	struct series_row* rows;
+	uint64_t size;
+
+	if(series_row_cnt <= idx - series_first)
+	{
+		if(series_row_size <= idx - series_first)
+		{
+			size = series_row_size ? series_row_size * 2 : 1024;
+			while(size <= idx - series_first)
+			{
+				size *= 2;
+			}
+			rows = (struct series_row*)realloc(series_rows, sizeof(struct series_row) * size);
+			if(rows == NULL)
+			{
+				return NULL;
+			}
+			series_rows = rows;
+			series_row_size = size;
+		}
+		memset(series_rows + series_row_cnt, 0, sizeof(struct series_row) * (idx - series_first + 1 - series_row_cnt));
+		series_row_cnt = idx - series_first + 1;
+	}
+	return &series_rows[idx - series_first];
+}
+
+// close the oldest bucket into a row and move the ring forward
+void close_series_bucket(void)
+{
+	struct series_bucket* pbk = &series_ring[series_base % SERIES_RING_SIZE];
+	struct series_row* prow = series_row_at(series_base);
+	int i;
+
+	if(prow != NULL)
+	{
+		for(i=0 ; i<2 ; i++)
+		{
+			prow->ios[i] = pbk->ios[i];
+			prow->bytes[i] = pbk->bytes[i];
+		}
+		prow->total_time = pbk->total_time;
+		for(i=0 ; i<nr_percentiles ; i++)
+		{
+			prow->pct_time[i] = dio_hist_percentile(pbk->hist, percentiles[i]);
+		}
+	}
+
+	//histogram is reused by the next interval of this bucket
+	if(pbk->hist != NULL)
+	{
+		memset(pbk->hist, 0, sizeof(struct dio_hist));
+	}
+	pbk->ios[0] = pbk->ios[1] = 0;
+	pbk->bytes[0] = pbk->bytes[1] = 0;
+	pbk->total_time = 0;
+	series_base++;
+}
+
+void event_series_statistic(struct dio_nugget* pdng, char actc, uint64_t time)
+{
+	struct series_bucket* pbk;
+	struct series_row* prow;
+	uint64_t idx = time / series_interval;
+	uint64_t latency;
+	int rw;
+
+	//a request is counted once at its completion, merged bios are a part of it
+	if(actc != 'C' || pdng->mlink != NULL || is_failed_nugget(pdng))
+	{
+		return ;
+	}
+	if(pdng->category & BLK_TC_READ)
+	{
+		rw = 0;
+	}
+	else if(pdng->category & BLK_TC_WRITE)
+	{
+		rw = 1;
+	}
+	else
+	{
+		return ;
+	}
+	latency = pdng->times[pdng->elemidx-1] - pdng->times[0];
+
+	if(!series_started)
+	{
+		series_started = true;
+		series_base = series_first = idx;
+	}
+
+	if(idx < series_base)
+	{
+		//too late for the ring, only counted on its closed row
+		prow = series_row_at(idx < series_first ? series_first : idx);
+		if(prow != NULL)
+		{
+			prow->ios[rw]++;
+			prow->bytes[rw] += pdng->size;
+			prow->total_time += latency;
+		}
+		return ;
+	}
+
+	while(idx >= series_base + SERIES_RING_SIZE)
+	{
+		close_series_bucket();
+	}
+
+	pbk = &series_ring[idx % SERIES_RING_SIZE];
+	pbk->ios[rw]++;
+	pbk->bytes[rw] += pdng->size;
+	pbk->total_time += latency;
+	if(pbk->hist == NULL)
+	{
+		pbk->hist = dio_hist_create();
+	}
+	if(pbk->hist != NULL)
+	{
+		dio_hist_record(pbk->hist, latency);
+	}
+}
+
+void process_series_statistic(int ng_cnt)
+{
+	struct series_row* prow;
+	double sec = series_interval / 1000000000.0;
+	char name[24];	//'p' + %g (13 chars at most) + "(us)"
+	uint64_t i, ios;
+	int j;
+
+	//close the remained buckets which have data
+	for(i=0 ; series_started && i<SERIES_RING_SIZE ; i++)
+	{
+		close_series_bucket();
+	}
+
+	fprintf(output, "%12s %9s %9s %9s %9s %12s", "Time", "R_IOPS", "W_IOPS", "R_MB/s", "W_MB/s", "AvgLat(us)");
+	for(j=0 ; j<nr_percentiles ; j++)
+	{
+		snprintf(name, sizeof(name), "p%g(us)", percentiles[j]);
+		fprintf(output, " %12s", name);
+	}
+	fprintf(output, "\n");
+
+	//trailing empty rows are made by closing the ring
+	while(series_row_cnt > 0 &&
+		series_rows[series_row_cnt-1].ios[0] + series_rows[series_row_cnt-1].ios[1] == 0)
+	{
+		series_row_cnt--;
+	}
+
+	for(i=0 ; i<series_row_cnt ; i++)
+	{
+		prow = &series_rows[i];
+		ios = prow->ios[0] + prow->ios[1];
+
+		fprintf(output, "%12.3f %9.0f %9.0f %9.2f %9.2f %12.1f",
+			(series_first + i) * sec,
+			prow->ios[0] / sec, prow->ios[1] / sec,
+			prow->bytes[0] / sec / 1000000, prow->bytes[1] / sec / 1000000,
+			ios ? prow->total_time / (double)ios / 1000 : 0.0);
+		for(j=0 ; j<nr_percentiles ; j++)
+		{
+			fprintf(output, " %12.1f", prow->pct_time[j] / 1000.0);
+		}
+		fprintf(output, "\n");
+	}
+
+	for(i=0 ; i<SERIES_RING_SIZE ; i++)
+	{
+		dio_hist_destroy(series_ring[i].hist);
+		series_ring[i].hist = NULL;
+	}
+	free(series_rows);
+	series_rows = NULL;
+}
+
+//------------------- queue depth statistics ------------------------------//
+#define INIT_QD_HASH_SIZE 64
+static struct qd_data qd_all;		//whole device
+static struct dio_hash qd_hash;		//qd_data by pid
+static uint64_t qd_start_time;
+static uint64_t qd_end_time;
+static bool qd_started;
+
+void init_depth_statistic(void)
 {
-        int i, j;
+	memset(&qd_all, 0, sizeof(struct qd_data));
+	qd_started = false;
+	if(!dio_hash_init(&qd_hash, INIT_QD_HASH_SIZE))
+	{
+		DBGOUT("failed to allocate qd hash \n");
+	}
+}
 
-        i=0;
-        while(str1[i] != '\0')
-        {
-                j=0;
-                while(str2[j] != '\0')
-                {
-                        if(str1[i+j] != str2[j])
-                        {
-                                break;
-                        }
-                        j++;
-                }
-                if(str2[j] == '\0')
-                {
-                        return i+1;
-                }
-                i++;
-        }
+struct qd_data* get_qd_data(uint32_t pid)
+{
+	struct qd_data* pqd;
+
+	pqd = (struct qd_data*)dio_hash_lookup(&qd_hash, pid);
+	if(pqd != NULL)
+	{
+		return pqd;
+	}
+
+	pqd = (struct qd_data*)malloc(sizeof(struct qd_data));
+	if(pqd == NULL)
+	{
+		return NULL;
+	}
+	memset(pqd, 0, sizeof(struct qd_data));
+	pqd->pid = pid;
+
+	// pid had no request from the start of trace
+	pqd->queued.last_time = pqd->inflight.last_time = qd_start_time;
+	if(!dio_hash_insert(&qd_hash, pid, pqd))
+	{
+		free(pqd);
+		return NULL;
+	}
+	return pqd;
+}
+
+static inline int qd_hist_index(int depth)
+{
+	int idx = 0;
+
+	while(depth > 0 && idx < QD_HIST_SIZE-1)
+	{
+		depth >>= 1;
+		idx++;
+	}
+	return idx;
+}
+
+void update_qd_track(struct qd_track* ptrack, uint64_t time, int delta)
+{
+	if(time > ptrack->last_time)
+	{
+		ptrack->area += (uint64_t)ptrack->depth * (time - ptrack->last_time);
+		ptrack->hist[qd_hist_index(ptrack->depth)] += time - ptrack->last_time;
+		ptrack->last_time = time;
+	}
+
+	// the requests which were issued before the trace are not known
+	ptrack->depth += delta;
+	if(ptrack->depth < 0)
+	{
+		ptrack->depth = 0;
+	}
+	if(ptrack->max_depth < ptrack->depth)
+	{
+		ptrack->max_depth = ptrack->depth;
+	}
+}
+
+// is the request on device at this event?
+static bool is_inflight_nugget(struct dio_nugget* pdng)
+{
+	int i;
+
+	// the last state is this event
+	for(i=pdng->elemidx-2 ; i>=0 ; i--)
+	{
+		if(pdng->states[i] == 'D')
+		{
+			return true;
+		}
+		if(pdng->states[i] == 'R')
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+void event_depth_statistic(struct dio_nugget* pdng, char actc, uint64_t time)
+{
+	struct qd_data* pqd;
+	int queued = 0;
+	int inflight = 0;
+
+	if(!qd_started)
+	{
+		qd_started = true;
+		qd_start_time = qd_all.queued.last_time = qd_all.inflight.last_time = time;
+	}
+	qd_end_time = time;
+
+	switch(actc)
+	{
+	case 'Q':
+		// Q after split or remap is the same bio
+		if(pdng->elemidx == 1)
+		{
+			queued = 1;
+		}
+		break;
+	case 'X':
+		// the second part of split bio
+		queued = 1;
+		break;
+	case 'D':
+		if(pdng->mlink == NULL && !is_inflight_nugget(pdng))
+		{
+			inflight = 1;
+		}
+		break;
+	case 'R':
+		if(pdng->mlink == NULL && is_inflight_nugget(pdng))
+		{
+			inflight = -1;
+		}
+		break;
+	case 'C':
+	case 'a':
+		if(pdng->states[0] == 'Q')
+		{
+			queued = -1;
+		}
+		if(pdng->mlink == NULL && is_inflight_nugget(pdng))
+		{
+			inflight = -1;
+		}
+		break;
+	default:
+		return ;
+	}
+	if(queued == 0 && inflight == 0)
+	{
+		return ;
+	}
+
+	update_qd_track(&qd_all.queued, time, queued);
+	update_qd_track(&qd_all.inflight, time, inflight);
+
+	pqd = get_qd_data(pdng->pid);
+	if(pqd != NULL)
+	{
+		update_qd_track(&pqd->queued, time, queued);
+		update_qd_track(&pqd->inflight, time, inflight);
+	}
+}
+
+void print_qd_track(const char* name, const char* type, struct qd_track* ptrack)
+{
+	uint64_t span = qd_end_time - qd_start_time;
+	int i;
+
+	// close the track at the end of trace
+	update_qd_track(ptrack, qd_end_time, 0);
+
+	fprintf(output, "%10s %8s %9.3f %9d", name, type,
+		span ? ptrack->area / (double)span : 0.0, ptrack->max_depth);
+	for(i=0 ; i<QD_HIST_SIZE ; i++)
+	{
+		fprintf(output, " %6.2f%%", span ? ptrack->hist[i] * 100.0 / span : 0.0);
+	}
+	fprintf(output, "\n");
+}
+
+static int compare_qd_data(const void* a, const void* b)
+{
+	uint32_t pa = (*(struct qd_data**)a)->pid;
+	uint32_t pb = (*(struct qd_data**)b)->pid;
+
+	return pa < pb ? -1 : pa > pb;
+}
+
+void process_depth_statistic(int ng_cnt)
+{
+	struct qd_data** pqds;
+	char name[16];
+	unsigned int i, cnt = 0;
+
+	fprintf(output, "%10s %8s %9s %9s %7s %7s %7s %7s %7s %7s %7s %7s %7s\n",
+		"pid", "Type", "AvgDepth", "MaxDepth",
+		"0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64-127", "128-");
+	print_qd_track("all", "Queued", &qd_all.queued);
+	print_qd_track(" ", "InFlight", &qd_all.inflight);
+	fprintf(output, "\n");
+
+	// pids are printed in order
+	pqds = (struct qd_data**)malloc(sizeof(struct qd_data*) * (qd_hash.cnt + 1));
+	for(i=0 ; pqds != NULL && i<qd_hash.size ; i++)
+	{
+		if(qd_hash.tbl[i].val != NULL)
+		{
+			pqds[cnt++] = (struct qd_data*)qd_hash.tbl[i].val;
+		}
+	}
+	if(pqds != NULL)
+	{
+		qsort(pqds, cnt, sizeof(struct qd_data*), compare_qd_data);
+		for(i=0 ; i<cnt ; i++)
+		{
+			snprintf(name, sizeof(name), "%"PRIu32, pqds[i]->pid);
+			print_qd_track(name, "Queued", &pqds[i]->queued);
+			print_qd_track(" ", "InFlight", &pqds[i]->inflight);
+			fprintf(output, "\n");
+		}
+		free(pqds);
+	}
+
+	for(i=0 ; i<qd_hash.size ; i++)
+	{
+		free(qd_hash.tbl[i].val);
+	}
+	dio_hash_destroy(&qd_hash);
+}
+
+//------------------- follow statistics ------------------------------//
+static struct follow_window follow_win;
+static uint64_t follow_next;		//wall clock of the next report
+static bool follow_header;
+
+static uint64_t follow_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void follow_signal(int sig)
+{
+	follow_stop = 1;
+}
+
+void init_follow_statistic(void)
+{
+	memset(&follow_win, 0, sizeof(struct follow_window));
+	init_data_time(&follow_win.latency);
+	follow_next = follow_clock() + follow_interval;
+	follow_header = false;
+}
+
+void event_follow_statistic(struct dio_nugget* pdng, char actc, uint64_t time)
+{
+	int rw;
+
+	//a request is counted once at its completion, like series statistic
+	if(actc != 'C' || pdng->mlink != NULL || is_failed_nugget(pdng))
+	{
+		return ;
+	}
+	if(pdng->category & BLK_TC_READ)
+	{
+		rw = 0;
+	}
+	else if(pdng->category & BLK_TC_WRITE)
+	{
+		rw = 1;
+	}
+	else
+	{
+		return ;
+	}
+
+	if(follow_win.start_time == 0)
+	{
+		follow_win.start_time = pdng->times[0];
+	}
+	follow_win.ios[rw]++;
+	follow_win.bytes[rw] += pdng->size;
+	if(follow_win.last_time < time)
+	{
+		follow_win.last_time = time;
+	}
+	add_data_time(&follow_win.latency, time - pdng->times[0]);
+}
+
+static void print_follow_window(void)
+{
+	struct follow_window* pw = &follow_win;
+	double sec;
+	char name[24];	//'p' + %g (13 chars at most) + "(us)"
+	int j;
+
+	if(!follow_header)
+	{
+		fprintf(output, "%12s %9s %9s %9s %9s %12s", "Time", "R_IOPS", "W_IOPS", "R_MB/s", "W_MB/s", "AvgLat(us)");
+		for(j=0 ; j<nr_percentiles ; j++)
+		{
+			snprintf(name, sizeof(name), "p%g(us)", percentiles[j]);
+			fprintf(output, " %12s", name);
+		}
+		fprintf(output, "\n");
+		follow_header = true;
+	}
+
+	//rates are of the trace time which the window covers.
+	//idle window has no completion, and it's printed an interval after the last one
+	sec = (pw->last_time > pw->start_time ? pw->last_time - pw->start_time : follow_interval) / 1000000000.0;
+	if(pw->ios[0] + pw->ios[1] == 0 || pw->last_time <= pw->print_time)
+	{
+		pw->print_time += follow_interval;
+	}
+	else
+	{
+		pw->print_time = pw->last_time;
+	}
+	fprintf(output, "%12.3f %9.0f %9.0f %9.2f %9.2f %12.1f", pw->print_time / 1000000000.0,
+		pw->ios[0] / sec, pw->ios[1] / sec,
+		pw->bytes[0] / sec / (1024 * 1024), pw->bytes[1] / sec / (1024 * 1024),
+		pw->latency.count ? pw->latency.total_time / (double)pw->latency.count / 1000 : 0.0);
+	for(j=0 ; j<nr_percentiles ; j++)
+	{
+		fprintf(output, " %12.1f", dio_hist_percentile(pw->latency.hist, percentiles[j]) / 1000.0);
+	}
+	fprintf(output, "\n");
+
+	//next window starts at the end of this window
+	clear_data_time(&pw->latency);
+	memset(pw->ios, 0, sizeof(pw->ios));
+	memset(pw->bytes, 0, sizeof(pw->bytes));
+	init_data_time(&pw->latency);
+	pw->start_time = pw->last_time;
+}
+
+void report_follow_window(void)
+{
+	//nothing is printed until the first request is completed.
+	//the window isn't idle if its bits are still in reorder window
+	if(follow_win.last_time > 0 &&
+		(follow_win.ios[0] + follow_win.ios[1] > 0 || list_empty(&biten_head)))
+	{
+		print_follow_window();
+	}
+}
+
+void follow_tick(bool idle)
+{
+	struct timespec ts;
+	uint64_t now = follow_clock();
+
+	if(now >= follow_next)
+	{
+		//the window is printed after the printed bits and nuggets.
+		dio_fmt_flush(&fmtbuf);
+		follow_report();
+		fflush(output);
+		while(follow_next <= now)
+		{
+			follow_next += follow_interval;
+		}
+	}
+
+	if(idle)
+	{
+		ts.tv_sec = 0;
+		ts.tv_nsec = FOLLOW_POLL_MSEC * 1000000L;
+		nanosleep(&ts, NULL);
+	}
+}
+
+void process_follow_statistic(int ng_cnt)
+{
+	//the last window which is not printed yet
+	if(follow_win.ios[0] + follow_win.ios[1] > 0)
+	{
+		print_follow_window();
+	}
+	clear_data_time(&follow_win.latency);
+	fprintf(output, "\n");
+}
+
+//------------------- top statistics ------------------------------//
+static struct top_view* top_view;
+
+void init_top_statistic(void)
+{
+	//allocated once, and only the used slots are cleared on each report
+	top_view = (struct top_view*)malloc(sizeof(struct top_view));
+	if(top_view == NULL)
+	{
+		perror("failed to allocate memory");
+		exit(1);
+	}
+	memset(top_view, 0, sizeof(struct top_view));
+	follow_next = follow_clock() + follow_interval;
+}
+
+static struct top_pid* get_top_pid(uint32_t pid)
+{
+	struct top_pid* ptp;
+	int i, idx;
+
+	idx = pid % TOP_MAX_PIDS;
+	for(i=0 ; i<TOP_MAX_PIDS ; i++)
+	{
+		ptp = &top_view->pids[idx];
+		if(!ptp->used)
+		{
+			ptp->used = true;
+			ptp->pid = pid;
+			top_view->nr_pids++;
+			return ptp;
+		}
+		if(ptp->pid == pid)
+		{
+			return ptp;
+		}
+		idx = (idx + 1) % TOP_MAX_PIDS;
+	}
+
+	//table is full until the next report
+	ptp = &top_view->pids[TOP_MAX_PIDS];
+	ptp->used = true;
+	return ptp;
+}
+
+void event_top_statistic(struct dio_nugget* pdng, char actc, uint64_t time)
+{
+	struct top_view* ptv = top_view;
+	struct top_pid* ptp;
+	int queued = 0, inflight = 0;
+	int rw;
+
+	if(ptv->last_time < time)
+	{
+		ptv->last_time = time;
+	}
+	ptv->nr_events++;
+	if(ptv->start_time == 0)
+	{
+		ptv->start_time = time;
+		ptv->queued.last_time = ptv->inflight.last_time = time;
+	}
+
+	//queue depth is counted on the same rule as depth statistic
+	switch(actc)
+	{
+	case 'Q':
+		if(pdng->elemidx == 1)
+		{
+			queued = 1;
+			ptv->submit[pdng->idxCPU]++;
+		}
+		break;
+	case 'X':
+		queued = 1;
+		break;
+	case 'D':
+		if(pdng->mlink == NULL && !is_inflight_nugget(pdng))
+		{
+			inflight = 1;
+		}
+		break;
+	case 'R':
+		if(pdng->mlink == NULL && is_inflight_nugget(pdng))
+		{
+			inflight = -1;
+		}
+		break;
+	case 'C':
+	case 'a':
+		if(pdng->states[0] == 'Q')
+		{
+			queued = -1;
+		}
+		if(pdng->mlink == NULL && is_inflight_nugget(pdng))
+		{
+			inflight = -1;
+		}
+		break;
+	default:
+		return ;
+	}
+	if(queued != 0)
+	{
+		update_qd_track(&ptv->queued, time, queued);
+	}
+	if(inflight != 0)
+	{
+		update_qd_track(&ptv->inflight, time, inflight);
+	}
+
+	//a request is counted once at its completion, like follow statistic
+	if(actc != 'C' || pdng->mlink != NULL || is_failed_nugget(pdng))
+	{
+		return ;
+	}
+	if(pdng->category & BLK_TC_READ)
+	{
+		rw = 0;
+	}
+	else if(pdng->category & BLK_TC_WRITE)
+	{
+		rw = 1;
+	}
+	else
+	{
+		return ;
+	}
 
-        return 0;
+	ptv->complete[pdng->idxCPU]++;
+	ptp = get_top_pid(pdng->pid);
+	ptp->ios[rw]++;
+	ptp->bytes[rw] += pdng->size;
+	dio_hist_record(&ptp->latency, time - pdng->times[0]);
 }
 
-struct dio_nugget_path* find_nugget_path(struct list_head* nugget_path_head, char* states)
+static int compare_top_pid(const void* a, const void* b)
 {
-	struct dio_nugget_path* pdngpath;
+	const struct top_pid* pa = *(const struct top_pid**)a;
+	const struct top_pid* pb = *(const struct top_pid**)b;
+	uint64_t ia = pa->ios[0] + pa->ios[1];
+	uint64_t ib = pb->ios[0] + pb->ios[1];
 
-	list_for_each_entry(pdngpath, nugget_path_head, link)
+	if(ia != ib)
 	{
-		if(strcmp(pdngpath->states, states) == 0)
-		{
-			return pdngpath;
-		}
+		return ia < ib ? 1 : -1;
 	}
+	return (pa->bytes[0] + pa->bytes[1]) < (pb->bytes[0] + pb->bytes[1]) ? 1 : -1;
+}
 
-	return NULL;
+// average depth of the window, and the track starts the next window
+static double top_window_depth(struct qd_track* ptrack, uint64_t start, uint64_t end)
+{
+	double avg;
+
+	update_qd_track(ptrack, end, 0);
+	avg = end > start ? ptrack->area / (double)(end - start) : (double)ptrack->depth;
+	ptrack->area = 0;
+	ptrack->max_depth = ptrack->depth;
+	memset(ptrack->hist, 0, sizeof(ptrack->hist));
+	return avg;
 }
 
-void init_path_statistic(void)
+static void print_top_view(void)
 {
-	if(is_graphic)
+	struct top_view* ptv = top_view;
+	struct top_pid* rows[TOP_MAX_PIDS+1];
+	struct top_pid* ptp;
+	uint64_t ios[2] = {0, 0}, bytes[2] = {0, 0};
+	int max_queued = ptv->queued.max_depth;
+	int max_inflight = ptv->inflight.max_depth;
+	double sec, avg_queued, avg_inflight;
+	const char* comm;
+	char name[16];
+	int nr_rows = 0;
+	int i;
+
+	for(i=0 ; i<=TOP_MAX_PIDS ; i++)
 	{
-		fPathData = fopen("dioparse.path.dat", "wt");
-		if(!fPathData)
+		ptp = &ptv->pids[i];
+		if(!ptp->used)
 		{
-			DBGOUT("dioparse.path.dat open error \n");
+			continue;
 		}
+		ios[0] += ptp->ios[0];
+		ios[1] += ptp->ios[1];
+		bytes[0] += ptp->bytes[0];
+		bytes[1] += ptp->bytes[1];
+		rows[nr_rows++] = ptp;
 	}
+	qsort(rows, nr_rows, sizeof(struct top_pid*), compare_top_pid);
 
-	INIT_LIST_HEAD(&nugget_path_head);
-}
+	//idle view has no event, and it's drawn an interval after the last one
+	if(ptv->nr_events == 0 || ptv->last_time <= ptv->print_time)
+	{
+		ptv->print_time += follow_interval;
+	}
+	else
+	{
+		ptv->print_time = ptv->last_time;
+	}
 
-void travel_path_statistic(struct dio_nugget* pdng)
-{
-	char* 			pstates;
-	uint64_t*		ptimes;
-	int*			pelemidx;
-	int			i;
-	int			nugget_time;
-	int			nugget_time_interval;
-	struct data_time*	pdata_time;
-	struct data_time*	pdata_time_interval;
-	
-	pnugget_path = find_nugget_path(&nugget_path_head, pdng->states);
-	if(pnugget_path == NULL)	// if not exist
+	//rates are of the trace time which the window covers
+	sec = (ptv->last_time > ptv->start_time ? ptv->last_time - ptv->start_time : follow_interval) / 1000000000.0;
+	avg_queued = top_window_depth(&ptv->queued, ptv->start_time, ptv->last_time);
+	avg_inflight = top_window_depth(&ptv->inflight, ptv->start_time, ptv->last_time);
+
+	//redraw the screen on terminal, or the views are appended
+	if(isatty(fileno(output)))
 	{
-		pnugget_path = (struct dio_nugget_path*)malloc(sizeof(struct dio_nugget_path));
-		memset(pnugget_path, 0, sizeof(struct dio_nugget_path));
+		fprintf(output, "\033[H\033[2J");
+	}
+	fprintf(output, "diotop - %.3f sec, %d pids\n", ptv->print_time / 1000000000.0, ptv->nr_pids);
+	fprintf(output, "IOPS  : %9.0f read %9.0f write     MB/s : %9.2f read %9.2f write\n",
+		ios[0] / sec, ios[1] / sec,
+		bytes[0] / sec / (1024 * 1024), bytes[1] / sec / (1024 * 1024));
+	fprintf(output, "Mix   : %5.1f%% read %5.1f%% write\n",
+		ios[0] + ios[1] ? ios[0] * 100.0 / (ios[0] + ios[1]) : 0.0,
+		ios[0] + ios[1] ? ios[1] * 100.0 / (ios[0] + ios[1]) : 0.0);
+	fprintf(output, "Depth : queued %d (avg %.2f, max %d)  in-flight %d (avg %.2f, max %d)\n",
+		ptv->queued.depth, avg_queued, max_queued,
+		ptv->inflight.depth, avg_inflight, max_inflight);
+
+	fprintf(output, "CPU   :");
+	for(i=0 ; i<TOP_MAX_CPUS ; i++)
+	{
+		if(ptv->submit[i] + ptv->complete[i] > 0)
+		{
+			fprintf(output, " %d(Q %llu C %llu)", i,
+				(unsigned long long)ptv->submit[i], (unsigned long long)ptv->complete[i]);
+		}
+	}
+	fprintf(output, "\n\n");
 
-		pnugget_path->data_time_interval_read = (struct data_time*)malloc(sizeof(struct data_time) * pdng->elemidx);
-		pnugget_path->data_time_interval_write = (struct data_time*)malloc(sizeof(struct data_time) * pdng->elemidx);
-		memset(pnugget_path->data_time_interval_read, 0, sizeof(struct data_time) * pdng->elemidx);
-		memset(pnugget_path->data_time_interval_write, 0, sizeof(struct data_time) * pdng->elemidx);
+	fprintf(output, "%8s %16s %9s %9s %9s %9s %12s\n", "PID", "COMM", "R_IOPS", "W_IOPS", "R_MB/s", "W_MB/s", "p99(us)");
+	for(i=0 ; i<nr_rows && i<TOP_ROWS ; i++)
+	{
+		ptp = rows[i];
+		if(ptp == &ptv->pids[TOP_MAX_PIDS])
+		{
+			fprintf(output, "%8s %16s", "-", "(other)");
+		}
+		else
+		{
+			comm = lookup_comm(ptp->pid);
+			snprintf(name, sizeof(name), "%s", comm ? comm : "-");
+			fprintf(output, "%8u %16s", ptp->pid, name);
+		}
+		fprintf(output, " %9.0f %9.0f %9.2f %9.2f %12.1f\n",
+			ptp->ios[0] / sec, ptp->ios[1] / sec,
+			ptp->bytes[0] / sec / (1024 * 1024), ptp->bytes[1] / sec / (1024 * 1024),
+			dio_hist_percentile(&ptp->latency, 99) / 1000.0);
+	}
+	if(!isatty(fileno(output)))
+	{
+		fprintf(output, "\n");
+	}
 
-		// Init pnugget_path's members
-		pnugget_path->elemidx = pdng->elemidx;
-		pnugget_path->data_time_read.min_time = -1;
-		pnugget_path->data_time_write.min_time = -1;
-		for(i=0 ; i<pnugget_path->elemidx ; i++)
+	//next view starts at the end of this view
+	for(i=0 ; i<=TOP_MAX_PIDS ; i++)
+	{
+		if(ptv->pids[i].used)
 		{
-			pnugget_path->data_time_interval_read[i].min_time = -1;
-			pnugget_path->data_time_interval_write[i].min_time = -1;
+			memset(&ptv->pids[i], 0, sizeof(struct top_pid));
 		}
-		strncpy(pnugget_path->states, pdng->states, MAX_ELEMENT_SIZE);
+	}
+	ptv->nr_pids = 0;
+	memset(ptv->submit, 0, sizeof(ptv->submit));
+	memset(ptv->complete, 0, sizeof(ptv->complete));
+	ptv->nr_events = 0;
+	ptv->start_time = ptv->last_time;
+}
 
-		// Add list
-		list_add(&(pnugget_path->link), &nugget_path_head);
+void report_top_view(void)
+{
+	//the view is drawn when the trace is idle too, but nothing is drawn
+	//until the first event, or while the bits are in reorder window
+	if(top_view->start_time > 0 &&
+		(top_view->nr_events > 0 || list_empty(&biten_head)))
+	{
+		print_top_view();
 	}
-	
-	// Add read/write count to distribute those.
-	if(pdng->category & BLK_TC_READ)
+}
+
+void process_top_statistic(int ng_cnt)
+{
+	//the last view which is not printed yet
+	if(top_view->nr_events > 0)
 	{
-		pdata_time = &pnugget_path->data_time_read;
-		pdata_time_interval = pnugget_path->data_time_interval_read;
+		print_top_view();
 	}
-	else if(pdng->category & BLK_TC_WRITE)
+	free(top_view);
+	top_view = NULL;
+}
+
+//------------------- lba statistics ------------------------------//
+#define INIT_LBA_HASH_SIZE 64
+static struct lba_row* lba_rows;	//heatmap rows from lba_first
+static uint64_t lba_first;
+static uint64_t lba_row_cnt;
+static uint64_t lba_row_size;
+static int lba_max_cell;
+static int lba_min_cell;
+static bool lba_started;
+static struct lba_seq lba_all;		//whole device
+static struct dio_hash lba_hash;	//lba_seq by pid
+FILE* fHeatmapData = NULL;
+
+void init_lba_statistic(void)
+{
+	if(is_graphic)
 	{
-		pdata_time = &pnugget_path->data_time_write;
-		pdata_time_interval = pnugget_path->data_time_interval_write;
+		fHeatmapData = fopen("dioparse.heatmap.dat", "wt");
+		if(!fHeatmapData)
+		{
+			DBGOUT("dioparse.heatmap.dat open error \n");
+		}
 	}
-	else
+
+	lba_rows = NULL;
+	lba_row_cnt = lba_row_size = 0;
+	lba_max_cell = -1;
+	lba_min_cell = INT32_MAX;
+	lba_started = false;
+	memset(&lba_all, 0, sizeof(struct lba_seq));
+	if(!dio_hash_init(&lba_hash, INIT_LBA_HASH_SIZE))
 	{
-		DBGOUT("%x \n", pdng->category);
-		return ;
+		DBGOUT("failed to allocate lba hash \n");
 	}
+}
 
-	// Set data on pnugget_path.
-	nugget_time = pdng->times[pnugget_path->elemidx-1] - pdng->times[0];
-	pdata_time->count++;
-	pdata_time->total_time += nugget_time;
-	if(pdata_time->max_time < nugget_time)
+static uint32_t* lba_cell_at(uint64_t tidx, int cell)
+{
+	struct lba_row* rows;
+	struct lba_row* prow;
+	uint32_t* cells;
+	uint64_t size;
+	int ncell;
+
+	// row of heatmap is grown as time goes
+	if(lba_row_cnt <= tidx - lba_first)
 	{
-		pdata_time->max_time = nugget_time;
+		if(lba_row_size <= tidx - lba_first)
+		{
+			size = lba_row_size ? lba_row_size * 2 : 1024;
+			while(size <= tidx - lba_first)
+			{
+				size *= 2;
+			}
+			rows = (struct lba_row*)realloc(lba_rows, sizeof(struct lba_row) * size);
+			if(rows == NULL)
+			{
+				return NULL;
+			}
+			lba_rows = rows;
+			lba_row_size = size;
+		}
+		memset(lba_rows + lba_row_cnt, 0, sizeof(struct lba_row) * (tidx - lba_first + 1 - lba_row_cnt));
+		lba_row_cnt = tidx - lba_first + 1;
 	}
-	if(pdata_time->min_time > nugget_time)
+
+	// and its cells are grown as regions are touched
+	prow = &lba_rows[tidx - lba_first];
+	if(prow->ncell <= cell)
 	{
-		pdata_time->min_time = nugget_time;
+		ncell = prow->ncell ? prow->ncell : 16;
+		while(ncell <= cell)
+		{
+			ncell *= 2;
+		}
+		cells = (uint32_t*)realloc(prow->cells, sizeof(uint32_t) * ncell);
+		if(cells == NULL)
+		{
+			return NULL;
+		}
+		memset(cells + prow->ncell, 0, sizeof(uint32_t) * (ncell - prow->ncell));
+		prow->cells = cells;
+		prow->ncell = ncell;
 	}
+	return &prow->cells[cell];
+}
 
-	// Set data on pnugget_path->data_time_interval
-	for(i=0 ; i<pnugget_path->elemidx ; i++)
+void update_lba_seq(struct lba_seq* pseq, uint64_t sector, int size)
+{
+	uint64_t dist;
+	int idx;
+
+	pseq->ios++;
+	if(pseq->has_prev)
 	{
-		nugget_time_interval = pdng->times[i+1] - pdng->times[i];
-		pdata_time_interval[i].count++;
-		pdata_time_interval[i].total_time += nugget_time_interval;
-		if(pdata_time_interval[i].max_time < nugget_time)
+		dist = sector > pseq->next_sector ? sector - pseq->next_sector : pseq->next_sector - sector;
+		if(dist == 0)
 		{
-			pdata_time_interval[i].max_time = nugget_time;
+			pseq->seq_ios++;
+			if(++pseq->run == 1)
+			{
+				pseq->streams++;
+			}
 		}
-		if(pdata_time_interval[i].min_time > nugget_time)
+		else
 		{
-			pdata_time_interval[i].min_time = nugget_time;
+			pseq->run = 0;
 		}
+
+		// distance in sectors. 0, <4K, <64K, <1M, <128M, <1G, 1G-
+		if(dist == 0)
+			idx = 0;
+		else if(dist < 8)
+			idx = 1;
+		else if(dist < 128)
+			idx = 2;
+		else if(dist < 2048)
+			idx = 3;
+		else if(dist < 262144)
+			idx = 4;
+		else if(dist < 2097152)
+			idx = 5;
+		else
+			idx = 6;
+		pseq->seek_hist[idx]++;
 	}
 
+	pseq->has_prev = true;
+	pseq->next_sector = sector + size / 512;
 }
 
-
-void process_path_statistic(int ng_cnt)
+void event_lba_statistic(struct dio_nugget* pdng, char actc, uint64_t time)
 {
-	int i;
+	struct lba_seq* pseq;
+	uint32_t* pcell;
+	uint64_t tidx = time / series_interval;
+	int cell;
 
-	if(is_graphic)
+	// Q after split or remap is the same bio
+	if(actc != 'Q' || pdng->elemidx != 1)
 	{
-		fprintf(fPathData, "%s %s %s\n", "path", "read", "write");
+		return ;
 	}
-	else
+
+	if(!lba_started)
 	{
-		fprintf(output,"%20s %6s %6s %12s %12s %12s \n", "Path", "Type", "No", "AverageTime", "MaxTime", "MinTime");
+		lba_started = true;
+		lba_first = tidx;
 	}
-
-	list_for_each_entry(pnugget_path, &nugget_path_head, link)
+	cell = (int)(pdng->sector / lba_region);
+	if(tidx >= lba_first && (pcell = lba_cell_at(tidx, cell)) != NULL)
 	{
-		// Calculate average time(path)
-		if(pnugget_path->data_time_read.count != 0)
+		(*pcell)++;
+		if(lba_max_cell < cell)
 		{
-			pnugget_path->data_time_read.average_time = pnugget_path->data_time_read.total_time / pnugget_path->data_time_read.count;
+			lba_max_cell = cell;
 		}
-		if(pnugget_path->data_time_write.count != 0)
+		if(lba_min_cell > cell)
 		{
-			pnugget_path->data_time_write.average_time = pnugget_path->data_time_write.total_time / pnugget_path->data_time_write.count;
+			lba_min_cell = cell;
 		}
+	}
 
-		// if min_time is -1 that initializing value for calculating min_time, change that to 0.
-		if(pnugget_path->data_time_read.min_time == -1)
+	update_lba_seq(&lba_all, pdng->sector, pdng->size);
+
+	pseq = (struct lba_seq*)dio_hash_lookup(&lba_hash, pdng->pid);
+	if(pseq == NULL)
+	{
+		pseq = (struct lba_seq*)malloc(sizeof(struct lba_seq));
+		if(pseq == NULL)
 		{
-			pnugget_path->data_time_read.min_time = 0;
+			return ;
 		}
-		if(pnugget_path->data_time_write.min_time == -1)
+		memset(pseq, 0, sizeof(struct lba_seq));
+		pseq->pid = pdng->pid;
+		if(!dio_hash_insert(&lba_hash, pdng->pid, pseq))
 		{
-			pnugget_path->data_time_write.min_time = 0;
+			free(pseq);
+			return ;
 		}
+	}
+	update_lba_seq(pseq, pdng->sector, pdng->size);
+}
 
-		// Calculate average time(path interval)
-		for(i=0 ; i<pnugget_path->elemidx ; i++)
+void print_lba_seq(const char* name, struct lba_seq* pseq)
+{
+	uint64_t seeks = pseq->ios > 0 ? pseq->ios - 1 : 0;
+	int i;
+
+	fprintf(output, "%10s %8"PRIu64" %7.2f%% %8"PRIu64" %9.2f", name, pseq->ios,
+		pseq->ios ? pseq->seq_ios * 100.0 / pseq->ios : 0.0, pseq->streams,
+		pseq->streams ? (pseq->seq_ios + pseq->streams) / (double)pseq->streams : 0.0);
+	for(i=0 ; i<SEEK_HIST_SIZE ; i++)
+	{
+		fprintf(output, " %6.2f%%", seeks ? pseq->seek_hist[i] * 100.0 / seeks : 0.0);
+	}
+	fprintf(output, "\n");
+}
+
+static int compare_lba_seq(const void* a, const void* b)
+{
+	uint32_t pa = (*(struct lba_seq**)a)->pid;
+	uint32_t pb = (*(struct lba_seq**)b)->pid;
+
+	return pa < pb ? -1 : pa > pb;
+}
+
+void process_lba_statistic(int ng_cnt)
+{
+	struct lba_seq** pseqs;
+	struct lba_row* prow;
+	double sec = series_interval / 1000000000.0;
+	double gb = lba_region * 512.0 / (1024 * 1024 * 1024);
+	char name[16];
+	uint64_t i;
+	unsigned int cnt = 0;
+	int j;
+
+	// heatmap, a row for each interval and a column for each touched region
+	if(lba_max_cell >= 0)
+	{
+		fprintf(output, "%12s", "Time\\LBA(GB)");
+		for(j=lba_min_cell ; j<=lba_max_cell ; j++)
 		{
-			if(pnugget_path->data_time_interval_read[i].count != 0)
-			{
-				pnugget_path->data_time_interval_read[i].average_time = pnugget_path->data_time_interval_read[i].total_time / pnugget_path->data_time_interval_read[i].count;
-			}
-			if(pnugget_path->data_time_interval_write[i].count != 0)
-			{
-				pnugget_path->data_time_interval_write[i].average_time = pnugget_path->data_time_interval_write[i].total_time / pnugget_path->data_time_interval_write[i].count;
-			}
-	
-			// if min_time is -1 that initializing value for calculating min_time, change that to 0.
-			if(pnugget_path->data_time_interval_read[i].min_time == -1)
-			{
-				pnugget_path->data_time_interval_read[i].min_time = 0;
-			}
-			if(pnugget_path->data_time_interval_write[i].min_time == -1)
-			{
-				pnugget_path->data_time_interval_write[i].min_time = 0;
-			}
+			fprintf(output, " %8.1f", j * gb);
 		}
-		if(instr(pnugget_path->states, "P") || instr(pnugget_path->states, "U") || instr(pnugget_path->states, "?"))
+		fprintf(output, "\n");
+
+		for(i=0 ; i<lba_row_cnt ; i++)
 		{
-			continue;
+			prow = &lba_rows[i];
+			fprintf(output, "%12.3f", (lba_first + i) * sec);
+			for(j=lba_min_cell ; j<=lba_max_cell ; j++)
+			{
+				fprintf(output, " %8u", j < prow->ncell ? prow->cells[j] : 0);
+				if(fHeatmapData != NULL)
+				{
+					fprintf(fHeatmapData, "%.3f %.1f %u\n", (lba_first + i) * sec, j * gb,
+						j < prow->ncell ? prow->cells[j] : 0);
+				}
+			}
+			fprintf(output, "\n");
+			free(prow->cells);
 		}
+		fprintf(output, "\n");
+	}
+	free(lba_rows);
+	lba_rows = NULL;
 
-		if(is_graphic)
+	// sequential streams and seek distance
+	fprintf(output, "%10s %8s %8s %8s %9s %7s %7s %7s %7s %7s %7s %7s\n",
+		"pid", "IOs", "Seq", "Streams", "StreamLen",
+		"0", "<4K", "<64K", "<1M", "<128M", "<1G", "1G-");
+	print_lba_seq("all", &lba_all);
+
+	pseqs = (struct lba_seq**)malloc(sizeof(struct lba_seq*) * (lba_hash.cnt + 1));
+	for(i=0 ; pseqs != NULL && i<lba_hash.size ; i++)
+	{
+		if(lba_hash.tbl[i].val != NULL)
 		{
-			print_path_statistic_graphic(pnugget_path);
+			pseqs[cnt++] = (struct lba_seq*)lba_hash.tbl[i].val;
 		}
-		else
+	}
+	if(pseqs != NULL)
+	{
+		qsort(pseqs, cnt, sizeof(struct lba_seq*), compare_lba_seq);
+		for(i=0 ; i<cnt ; i++)
 		{
-			print_path_statistic_text(pnugget_path);
+			snprintf(name, sizeof(name), "%"PRIu32, pseqs[i]->pid);
+			print_lba_seq(name, pseqs[i]);
 		}
+		free(pseqs);
 	}
 
-	// Free all dynamic allocated variables.
-	struct dio_nugget_path* tmpdng_path;
+	for(i=0 ; i<lba_hash.size ; i++)
+	{
+		free(lba_hash.tbl[i].val);
+	}
+	dio_hash_destroy(&lba_hash);
 
-	list_for_each_entry_safe(pnugget_path, tmpdng_path, &nugget_path_head, link)
+	if(fHeatmapData != NULL)
 	{
-		list_del(&pnugget_path->link);
-		free(pnugget_path->data_time_interval_read);
-		free(pnugget_path->data_time_interval_write);
-		free(pnugget_path);
+		fclose(fHeatmapData);
+		system("gnuplot heatmap.cmd -p");
 	}
+}
 
-	if(fPathData != NULL)
+//------------------- stack statistics ------------------------------//
+void create_stackdev(struct stat_shard* pshard, int idx)
+{
+	int i;
+	int size = pshard->nr_stackdev;
+
+	if(idx < size)
 	{
-		fclose(fPathData);
-		system("gnuplot path.cmd -p");
+		return ;
+	}
+	size = idx + 1;
+
+	pshard->stackdev = (struct dio_stack_dev*)realloc(pshard->stackdev, sizeof(struct dio_stack_dev) * size);
+	for(i=pshard->nr_stackdev ; i<size ; i++)
+	{
+		init_data_time(&pshard->stackdev[i].latency);
+		init_data_time(&pshard->stackdev[i].lower);
+		init_data_time(&pshard->stackdev[i].added);
 	}
+	pshard->nr_stackdev = size;
 }
 
-void print_path_statistic_graphic(struct dio_nugget_path* pnugget_path)
+void init_stack_statistic(void)
 {
-	fprintf(fPathData, "%s %d %d\n", pnugget_path->states, pnugget_path->data_time_read.count, pnugget_path->data_time_write.count);
+	cur_shard->stackdev = NULL;
+	cur_shard->nr_stackdev = 0;
 }
 
-void print_path_statistic_text(struct dio_nugget_path* pnugget_path)
+void travel_stack_statistic(struct dio_nugget* pdng)
 {
-	int i;
+	struct dio_stack_dev* pdev;
+	uint64_t time;
+	int idx = pdng->key >> DEV_KEY_SHIFT;
 
-	//printing
-	fprintf(output, "%20s %6s ", pnugget_path->states, "Read");
-	print_data_time_statistic(output, &pnugget_path->data_time_read);
+	//only completed requests have the latency
+	if(pdng->elemidx == 0 || pdng->states[pdng->elemidx-1] != 'C' || is_failed_nugget(pdng))
+	{
+		return ;
+	}
+
+	create_stackdev(cur_shard, idx);
+	pdev = &cur_shard->stackdev[idx];
+	time = pdng->times[pdng->elemidx-1] - pdng->times[0];
+	add_data_time(&pdev->latency, time);
+	if(pdng->nr_lower > 0)
+	{
+		add_data_time(&pdev->lower, pdng->lower_time);
+		add_data_time(&pdev->added, time > pdng->lower_time ? time - pdng->lower_time : 0);
+	}
+}
+
+// count of upper devices over the device
+static int stack_level(int idx)
+{
+	int level = 0;
+
+	while(device_uppers[idx] >= 0 && level < nr_devices)
+	{
+		idx = device_uppers[idx];
+		level++;
+	}
+	return level;
+}
+
+static void print_stack_row(const char* dev, const char* upper, const char* type, struct data_time* pdata_time)
+{
+	finish_data_time(pdata_time);
+	fprintf(output, "%11s %11s %6s ", dev, upper, type);
+	print_data_time_statistic(output, pdata_time);
 	fprintf(output, "\n");
+	clear_data_time(pdata_time);
+}
 
-	fprintf(output, "%20s %6s ", " ", "Write");
-	print_data_time_statistic(output, &pnugget_path->data_time_write);
+void process_stack_statistic(int ng_cnt)
+{
+	int i, level, max_level = 0;
+	char dev[24], upper[24];
+	struct dio_stack_dev* pdev;
+
+	fprintf(output,"%11s %11s %6s ", "DEVICE", "UPPER", "Type");
+	print_data_time_header(output);
 	fprintf(output, "\n");
 
-	for(i=0 ; i<pnugget_path->elemidx-1 ; i++)
+	for(i=0 ; i<cur_shard->nr_stackdev ; i++)
+	{
+		level = stack_level(i);
+		if(max_level < level)
+		{
+			max_level = level;
+		}
+	}
+
+	// devices are printed from the top of stack
+	for(level=0 ; level<=max_level ; level++)
+	{
+		for(i=0 ; i<cur_shard->nr_stackdev ; i++)
+		{
+			pdev = &cur_shard->stackdev[i];
+			if(pdev->latency.count == 0 || stack_level(i) != level)
+			{
+				continue;
+			}
+
+			snprintf(dev, sizeof(dev), "%u:%u", devices[i] >> 20, devices[i] & 0xFFFFF);
+			if(device_uppers[i] >= 0)
+			{
+				snprintf(upper, sizeof(upper), "%u:%u",
+					devices[device_uppers[i]] >> 20, devices[device_uppers[i]] & 0xFFFFF);
+			}
+			else
+			{
+				strcpy(upper, "-");
+			}
+
+			print_stack_row(dev, upper, "Total", &pdev->latency);
+			if(pdev->lower.count > 0)
+			{
+				print_stack_row(" ", " ", "Lower", &pdev->lower);
+				print_stack_row(" ", " ", "Added", &pdev->added);
+			}
+			fprintf(output, "\n");
+		}
+	}
+
+	free(cur_shard->stackdev);
+	cur_shard->stackdev = NULL;
+	cur_shard->nr_stackdev = 0;
+}
+
+void merge_stack_statistic(struct stat_shard* dst, struct stat_shard* src)
+{
+	int i;
+
+	if(src->nr_stackdev > 0)
+	{
+		create_stackdev(dst, src->nr_stackdev - 1);
+	}
+	for(i=0 ; i<src->nr_stackdev ; i++)
+	{
+		merge_data_time(&dst->stackdev[i].latency, &src->stackdev[i].latency);
+		merge_data_time(&dst->stackdev[i].lower, &src->stackdev[i].lower);
+		merge_data_time(&dst->stackdev[i].added, &src->stackdev[i].added);
+	}
+
+	free(src->stackdev);
+	src->stackdev = NULL;
+	src->nr_stackdev = 0;
+}
+
+//------------------- class statistics ------------------------------//
+// the class data of every shard is initialized with the shard
+void init_class_time(struct stat_shard* pshard)
+{
+	int i;
+
+	for(i=0 ; i<NR_CLASSES ; i++)
+	{
+		init_data_time(&pshard->classtime[i].data_time_read);
+		init_data_time(&pshard->classtime[i].data_time_write);
+		pshard->classtime[i].bytes_read = 0;
+		pshard->classtime[i].bytes_write = 0;
+	}
+}
+
+void travel_class_statistic(struct dio_nugget* pdng)
+{
+	struct dio_class_time* pclasstime;
+	uint64_t time;
+	int i;
+	int classes = pdng->categories & CLASS_MASK;
+
+	if(is_failed_nugget(pdng))
 	{
-		fprintf(output, "%18s%.2s %6s ", " ", &pnugget_path->states[i], "Read");
-		print_data_time_statistic(output, &pnugget_path->data_time_interval_read[i]);
-		if(pnugget_path->data_time_read.average_time != 0)
-		{
-			fprintf(output, " %2.2f%%", ((double)pnugget_path->data_time_interval_read[i].average_time / pnugget_path->data_time_read.average_time) * 100);
-		}
-		else
+		return ;
+	}
+
+	time = pdng->times[pdng->elemidx-1] - pdng->times[0];
+	for(i=0 ; i<NR_CLASSES ; i++)
+	{
+		if(i == CLASS_PLAIN ? classes != 0 : !(classes & class_table[i].mask))
 		{
-			fprintf(output, " %2.2f%%", 0.0);
+			continue;
 		}
-		fprintf(output, "\n");
 
-		fprintf(output, "%20s %6s ", " ", "Write");
-		print_data_time_statistic(output, &pnugget_path->data_time_interval_write[i]);
-		if(pnugget_path->data_time_write.average_time != 0)
+		pclasstime = &cur_shard->classtime[i];
+		if(pdng->category & BLK_TC_READ)
 		{
-			fprintf(output, " %2.2f%%", ((double)pnugget_path->data_time_interval_write[i].average_time / pnugget_path->data_time_write.average_time) * 100);
+			add_data_time(&pclasstime->data_time_read, time);
+			pclasstime->bytes_read += pdng->size;
 		}
-		else
+		else if(pdng->category & BLK_TC_WRITE)
 		{
-			fprintf(output, " %2.2f%%", 0.0);
+			add_data_time(&pclasstime->data_time_write, time);
+			pclasstime->bytes_write += pdng->size;
 		}
-		fprintf(output, "\n");
 	}
-	fprintf(output, "\n");
 }
 
-void print_data_time_statistic(FILE* stream, struct data_time* pdata_time)
+void process_class_statistic(int ng_cnt)
 {
-	fprintf(stream, "%6d %2llu.%.9llu %2llu.%.9llu %2llu.%.9llu", pdata_time->count,
-			SECONDS(pdata_time->average_time), NANO_SECONDS(pdata_time->average_time),
-			SECONDS(pdata_time->max_time), NANO_SECONDS(pdata_time->max_time),
-			SECONDS(pdata_time->min_time), NANO_SECONDS(pdata_time->min_time)
-	       );
-}
+	int i;
+	struct dio_class_time* pclasstime;
 
-//---------------------------------------- pid statistic -------------------------------------------------//
-//function for handling data structure for pid statistic
-struct pid_stat_data* rb_search_psd(uint32_t pid){
-	struct rb_node* n = psd_root.rb_node;
-	struct pid_stat_data* ppsd = NULL;
-	
-	while(n){
-		ppsd = rb_entry(n, struct pid_stat_data, link);
+	fprintf(output,"%7s %6s %14s ", "Class", "Type", "Bytes");
+	print_data_time_header(output);
+	fprintf(output, "\n");
 
-		if( pid < ppsd->pid )
-			n = n->rb_left;
-		else if( pid > ppsd->pid )
-			n = n->rb_right;
-		else 
-			return ppsd;
-	}
-	return NULL;
-}
+	for(i=0 ; i<NR_CLASSES ; i++)
+	{
+		pclasstime = &cur_shard->classtime[i];
+		finish_data_time(&pclasstime->data_time_read);
+		finish_data_time(&pclasstime->data_time_write);
 
-struct pid_stat_data* __rb_insert_psd(struct pid_stat_data* newpsd){
-	struct pid_stat_data* ret;
-	struct rb_node** p = &(psd_root.rb_node);
-	struct rb_node* parent = NULL;
-	
-	while(*p){
-		parent = *p;
-		ret = rb_entry(parent, struct pid_stat_data, link);
+		if(pclasstime->data_time_read.count + pclasstime->data_time_write.count > 0)
+		{
+			fprintf(output, "%7s %6s %14"PRIu64" ", class_table[i].name, "Read", pclasstime->bytes_read);
+			print_data_time_statistic(output, &pclasstime->data_time_read);
+			fprintf(output, "\n");
+			fprintf(output, "%7s %6s %14"PRIu64" ", " ", "Write", pclasstime->bytes_write);
+			print_data_time_statistic(output, &pclasstime->data_time_write);
+			fprintf(output, "\n\n");
+		}
 
-		if( newpsd->pid < ret->pid )
-			p = &(*p)->rb_left;
-		else if( newpsd->pid > ret->pid )
-			p = &(*p)->rb_right;
-		else
-			return ret;
+		clear_data_time(&pclasstime->data_time_read);
+		clear_data_time(&pclasstime->data_time_write);
 	}
-
-	rb_link_node(&newpsd->link, parent, p);
-	return NULL;
 }
 
-struct pid_stat_data* rb_insert_psd(struct pid_stat_data* newpsd){
-	struct pid_stat_data* ret = NULL;
-	if( (ret = __rb_insert_psd(newpsd) ) )
-		return ret;
-	rb_insert_color(&newpsd->link, &psd_root);
-	return ret;
-}
+void merge_class_statistic(struct stat_shard* dst, struct stat_shard* src)
+{
+	int i;
 
-void __clear_pid_stat(struct rb_node* p){
-	if( p->rb_left != NULL )
-		__clear_pid_stat(p->rb_left);
-	if( p->rb_right != NULL )
-		__clear_pid_stat(p->rb_right);
-	
-	struct pid_stat_data* psd = rb_entry(p, struct pid_stat_data, link);
-	free(psd);
+	for(i=0 ; i<NR_CLASSES ; i++)
+	{
+		merge_data_time(&dst->classtime[i].data_time_read, &src->classtime[i].data_time_read);
+		merge_data_time(&dst->classtime[i].data_time_write, &src->classtime[i].data_time_write);
+		dst->classtime[i].bytes_read += src->classtime[i].bytes_read;
+		dst->classtime[i].bytes_write += src->classtime[i].bytes_write;
+	}
 }
 
-FILE* fPidData = NULL;
-void init_pid_statistic()
+//------------------- error statistics ------------------------------//
+static struct dio_hash err_hash[NR_ERR_GROUPS];	//err_count by key of each group
+static uint64_t err_done_ios;	//completed requests including failed ones
+static uint64_t err_ios;
+
+void init_error_statistic(void)
 {
-	if(is_graphic)
+	int i;
+
+	for(i=0 ; i<NR_ERR_GROUPS ; i++)
 	{
-		fPidData = fopen("dioparse.pid.dat", "wt");
-		if(!fPidData)
+		if(!dio_hash_init(&err_hash[i], INIT_ERR_HASH_SIZE))
 		{
-			DBGOUT("dioparse.pid.dat open error \n");
-			return ;
+			DBGOUT("failed to allocate error hash \n");
 		}
 	}
+	err_done_ios = err_ios = 0;
 }
 
-void travel_pid_statistic(struct dio_nugget* pdng){
-	struct pid_stat_data* ppsd = rb_search_psd(pdng->pid);
-	if( ppsd == NULL ){
-		ppsd = (struct pid_stat_data*)malloc(sizeof(struct pid_stat_data));
-		ppsd->pid = pdng->pid;
-		
-		ppsd->data_time_read.min_time = (unsigned int)(-1);
-		ppsd->data_time_read.max_time = 0;
-		ppsd->data_time_read.total_time = 0;
-		ppsd->data_time_read.count = 0;
-		ppsd->data_time_read.average_time = 0;
-
-		ppsd->data_time_write.min_time = (unsigned int)(-1);
-		ppsd->data_time_write.max_time = 0;
-		ppsd->data_time_write.total_time = 0;
-		ppsd->data_time_write.count = 0;
-		ppsd->data_time_write.average_time = 0;
-		
-		rb_insert_psd(ppsd);
+struct err_count* get_err_count(int group, uint64_t key)
+{
+	struct err_count* pec;
+
+	pec = (struct err_count*)dio_hash_lookup(&err_hash[group], key);
+	if(pec != NULL)
+	{
+		return pec;
 	}
-	
-	uint64_t tmpt = 0;
-	if( pdng->category & BLK_TC_READ ){
-		tmpt = pdng->times[pdng->elemidx-1] - pdng->times[0];
-		if( ppsd->data_time_read.min_time > tmpt )
-			ppsd->data_time_read.min_time = tmpt;
-		else if( ppsd->data_time_read.max_time < tmpt )
-			ppsd->data_time_read.max_time = tmpt;
-		ppsd->data_time_read.total_time += tmpt;
-		ppsd->data_time_read.count ++;
+
+	pec = (struct err_count*)malloc(sizeof(struct err_count));
+	if(pec == NULL)
+	{
+		return NULL;
 	}
-	else if( pdng->category & BLK_TC_WRITE ){
-		tmpt = pdng->times[pdng->elemidx-1] - pdng->times[0];
-		if( ppsd->data_time_write.min_time > tmpt )
-			ppsd->data_time_write.min_time = tmpt;
-		else if( ppsd->data_time_write.max_time < tmpt )
-			ppsd->data_time_write.max_time = tmpt;
-		ppsd->data_time_write.total_time = tmpt;
-		ppsd->data_time_write.count ++;
+	memset(pec, 0, sizeof(struct err_count));
+	pec->key = key;
+	init_data_time(&pec->latency);
+	if(!dio_hash_insert(&err_hash[group], key, pec))
+	{
+		free(pec);
+		return NULL;
 	}
+	return pec;
 }
 
-void process_pid_statistic(int ng_cnt){
-	struct rb_node* node = NULL;
+void event_error_statistic(struct dio_nugget* pdng, char actc, uint64_t time)
+{
+	struct err_count* pec;
+	uint64_t keys[NR_ERR_GROUPS];
+	int i;
 
-	if(is_graphic)
+	//a request is counted once at its completion, like series statistic
+	if(actc != 'C' || pdng->mlink != NULL)
 	{
-		fprintf(fPidData, "%s %s %s\n", "pid", "read", "write");
+		return ;
 	}
-	else
+	err_done_ios++;
+	if(!is_failed_nugget(pdng))
 	{
-		fprintf(output,"%10s %6s %6s %12s %12s %12s \n", "pid", "Type", "No", "AverageTime", "MaxTime", "MinTime");
+		return ;
 	}
-	node = rb_first(&psd_root);
-	do{
-		struct pid_stat_data* ppsd = NULL;
-		ppsd = rb_entry(node, struct pid_stat_data, link);
-		
-		if( ppsd->data_time_read.count != 0 ){
-			ppsd->data_time_read.average_time = 
-				ppsd->data_time_read.total_time / ppsd->data_time_read.count;
-		}
-		if( ppsd->data_time_write.count != 0 ){
-			ppsd->data_time_write.average_time = 
-				ppsd->data_time_write.total_time / ppsd->data_time_write.count;
-		}
-
-		if( ppsd->data_time_read.min_time == (uint64_t)(-1) )
-			ppsd->data_time_read.min_time = 0;
-		if( ppsd->data_time_write.min_time == (uint64_t)(-1) )
-			ppsd->data_time_write.min_time = 0;
-
-		//printing
-		if(is_graphic)
+	err_ios++;
+
+	//region is on the device of request
+	keys[ERR_BY_ERRNO] = pdng->error;
+	keys[ERR_BY_PID] = pdng->pid;
+	keys[ERR_BY_REGION] = DEV_KEY(pdng->key >> DEV_KEY_SHIFT, pdng->sector / lba_region);
+	keys[ERR_BY_TIME] = time / series_interval;
+	for(i=0 ; i<NR_ERR_GROUPS ; i++)
+	{
+		pec = get_err_count(i, keys[i]);
+		if(pec == NULL)
 		{
-			print_pid_statistic_graphic(ppsd);
+			continue;
 		}
-		else
+		pec->ios++;
+		pec->bytes += pdng->size;
+		if(i == ERR_BY_ERRNO)
 		{
-			print_pid_statistic_text(ppsd);
+			add_data_time(&pec->latency, time - pdng->times[0]);
 		}
-	}while( (node = rb_next(node)) != NULL );
+	}
+}
 
-	//clear all pid tree
-	struct rb_node* parent = psd_root.rb_node;
-	__clear_pid_stat(parent);
+static int compare_err_ios(const void* a, const void* b)
+{
+	const struct err_count* pa = *(const struct err_count**)a;
+	const struct err_count* pb = *(const struct err_count**)b;
 
-	if(fPidData != NULL)
+	if(pa->ios != pb->ios)
 	{
-		fclose(fPidData);
-		system("gnuplot pid.cmd -p");
+		return pa->ios < pb->ios ? 1 : -1;
 	}
+	return pa->key < pb->key ? -1 : pa->key > pb->key;
 }
 
-void print_pid_statistic_graphic(struct pid_stat_data* ppsd)
+static int compare_err_key(const void* a, const void* b)
 {
-	fprintf(fPidData, "%"PRIu32" %d %d\n", ppsd->pid, ppsd->data_time_read.count, ppsd->data_time_write.count);
+	const struct err_count* pa = *(const struct err_count**)a;
+	const struct err_count* pb = *(const struct err_count**)b;
+
+	return pa->key < pb->key ? -1 : pa->key > pb->key;
 }
-void print_pid_statistic_text(struct pid_stat_data* ppsd)
+
+// return the counts of group in order, it should be freed
+static struct err_count** sort_err_counts(int group, unsigned int* pcnt)
 {
-	fprintf(output, "%10"PRIu32" %6s %6d %2llu.%.9llu %2llu.%.9llu %2llu.%.9llu \n", 
-			ppsd->pid, "Read", ppsd->data_time_read.count, 
-			SECONDS(ppsd->data_time_read.average_time), NANO_SECONDS(ppsd->data_time_read.average_time),
-			SECONDS(ppsd->data_time_read.max_time), NANO_SECONDS(ppsd->data_time_read.max_time),
-			SECONDS(ppsd->data_time_read.min_time), NANO_SECONDS(ppsd->data_time_read.min_time)
-	       );
+	struct dio_hash* ph = &err_hash[group];
+	struct err_count** pecs;
+	unsigned int i, cnt = 0;
 
-	fprintf(output, "%10s %6s %6d %2llu.%.9llu %2llu.%.9llu %2llu.%.9llu \n", 
-			" ", "Write", ppsd->data_time_write.count,
-			SECONDS(ppsd->data_time_write.average_time), NANO_SECONDS(ppsd->data_time_write.average_time),
-			SECONDS(ppsd->data_time_write.max_time), NANO_SECONDS(ppsd->data_time_write.max_time),
-			SECONDS(ppsd->data_time_write.min_time), NANO_SECONDS(ppsd->data_time_write.min_time)
-	       );
-	fprintf(output, "\n");
+	pecs = (struct err_count**)malloc(sizeof(struct err_count*) * (ph->cnt + 1));
+	if(pecs == NULL)
+	{
+		*pcnt = 0;
+		return NULL;
+	}
+	for(i=0 ; i<ph->size ; i++)
+	{
+		if(ph->tbl[i].val != NULL)
+		{
+			pecs[cnt++] = (struct err_count*)ph->tbl[i].val;
+		}
+	}
+	qsort(pecs, cnt, sizeof(struct err_count*),
+		group == ERR_BY_ERRNO || group == ERR_BY_PID ? compare_err_ios : compare_err_key);
+	*pcnt = cnt;
+	return pecs;
 }
 
+void process_error_statistic(int ng_cnt)
+{
+	struct err_count** pecs;
+	struct err_count* pec;
+	double sec = series_interval / 1000000000.0;
+	double gb = lba_region * 512.0 / (1024 * 1024 * 1024);
+	const char* comm;
+	char name[24];
+	unsigned int i, cnt;
+	uint32_t dev;
+	int k;
+
+	fprintf(output, "Failed requests : %"PRIu64" / %"PRIu64" (%f%%)\n\n", err_ios, err_done_ios,
+		err_done_ios ? err_ios / (double)err_done_ios * 100 : 0.0);
+
+	// by errno, with the time until the failure
+	pecs = sort_err_counts(ERR_BY_ERRNO, &cnt);
+	fprintf(output, "%6s %14s ", "Errno", "Bytes");
+	print_data_time_header(output);
+	fprintf(output, " %s\n", "Error");
+	for(i=0 ; i<cnt ; i++)
+	{
+		pec = pecs[i];
+		finish_data_time(&pec->latency);
+		fprintf(output, "%6"PRIu64" %14"PRIu64" ", pec->key, pec->bytes);
+		print_data_time_statistic(output, &pec->latency);
+		fprintf(output, " %s\n", strerror((int)pec->key));
+		clear_data_time(&pec->latency);
+	}
+	fprintf(output, "\n");
+	free(pecs);
+
+	// by pid
+	pecs = sort_err_counts(ERR_BY_PID, &cnt);
+	fprintf(output, "%10s %16s %10s %14s\n", "pid", "Command", "COUNT", "Bytes");
+	for(i=0 ; i<cnt ; i++)
+	{
+		pec = pecs[i];
+		comm = lookup_comm((uint32_t)pec->key);
+		fprintf(output, "%10"PRIu64" %16s %10"PRIu64" %14"PRIu64"\n",
+			pec->key, comm ? comm : "-", pec->ios, pec->bytes);
+	}
+	fprintf(output, "\n");
+	free(pecs);
+
+	// by lba region of each device
+	pecs = sort_err_counts(ERR_BY_REGION, &cnt);
+	fprintf(output, "%11s %12s %10s %14s\n", "Device", "LBA(GB)", "COUNT", "Bytes");
+	for(i=0 ; i<cnt ; i++)
+	{
+		pec = pecs[i];
+		dev = KEY_DEVICE(pec->key);
+		snprintf(name, sizeof(name), "%u:%u", dev >> 20, dev & 0xFFFFF);
+		fprintf(output, "%11s %12.1f %10"PRIu64" %14"PRIu64"\n",
+			name, KEY_SECTOR(pec->key) * gb, pec->ios, pec->bytes);
+	}
+	fprintf(output, "\n");
+	free(pecs);
+
+	// by time interval, only the intervals which have failures
+	pecs = sort_err_counts(ERR_BY_TIME, &cnt);
+	fprintf(output, "%12s %10s %14s\n", "Time", "COUNT", "Bytes");
+	for(i=0 ; i<cnt ; i++)
+	{
+		pec = pecs[i];
+		fprintf(output, "%12.3f %10"PRIu64" %14"PRIu64"\n", pec->key * sec, pec->ios, pec->bytes);
+	}
+	fprintf(output, "\n");
+	free(pecs);
+
+	for(k=0 ; k<NR_ERR_GROUPS ; k++)
+	{
+		for(i=0 ; i<err_hash[k].size ; i++)
+		{
+			free(err_hash[k].tbl[i].val);
+		}
+		dio_hash_destroy(&err_hash[k]);
+	}
+}
 
 //------------------- section statistics (for example)------------------------------//
 #define MAX_MON_SECTION 10
@@ -1510,26 +5506,22 @@ void process_section_statistic(int ng_cnt){
 
 #define INIT_NUM_CPU 4
 FILE* fCpuData = NULL;
-struct dio_cpu *diocpu;
-int maxCPU = 0;
 
-void create_diocpu(void)
+void create_diocpu(struct stat_shard* pshard)
 {
-	int i;
-
 	// Create diocpu
-	if(diocpu == NULL)
+	if(pshard->diocpu == NULL)
 	{
-		diocpu = (struct dio_cpu*)malloc(sizeof(struct dio_cpu) * INIT_NUM_CPU);
+		pshard->diocpu = (struct dio_cpu*)malloc(sizeof(struct dio_cpu) * INIT_NUM_CPU);
 	}
 	else
 	{
-		diocpu = (struct dio_cpu*)realloc(diocpu, sizeof(struct dio_cpu) * (maxCPU + INIT_NUM_CPU));
+		pshard->diocpu = (struct dio_cpu*)realloc(pshard->diocpu, sizeof(struct dio_cpu) * (pshard->maxCPU + INIT_NUM_CPU));
 	}
 
 	// Init members
-	memset(diocpu + maxCPU, 0, sizeof(struct dio_cpu) * INIT_NUM_CPU);
-	maxCPU += INIT_NUM_CPU;
+	memset(pshard->diocpu + pshard->maxCPU, 0, sizeof(struct dio_cpu) * INIT_NUM_CPU);
+	pshard->maxCPU += INIT_NUM_CPU;
 }
 
 void init_cpu_statistic(void)
@@ -1543,33 +5535,46 @@ void init_cpu_statistic(void)
 		}
 	}
 
-	create_diocpu();
+	create_diocpu(cur_shard);
 }
 
-void itr_cpu_statistic(struct blk_io_trace* pbit)
+// notify bits and the bits of too large cpu are not counted.
+// they are added to cpu 0 as zero, so the loop doesn't have branches
+#define MAX_STAT_CPU 128
+void batch_cpu_statistic(const struct dio_bit_batch* pbat)
 {
-	uint32_t category = pbit->action >> BLK_TC_SHIFT;
+	const uint32_t* action = pbat->action;
+	const uint32_t* cpu = pbat->cpu;
+	struct dio_cpu* diocpu;
+	uint32_t max_cpu = 0;
+	int i;
 
 	// Is enough diocpu?
-	
-	// Distribute read/write data and point that.
-	if(category & BLK_TC_NOTIFY || pbit->cpu > 128)
+	for(i=0 ; i<pbat->nr ; i++)
 	{
-		DBGOUT("cpu:%d \n", pbit->cpu);
-		return ;
-	}
+		uint32_t category = action[i] >> BLK_TC_SHIFT;
+		int is_valid = !(category & BLK_TC_NOTIFY) & (cpu[i] <= MAX_STAT_CPU);
+		uint32_t c = is_valid ? cpu[i] : 0;
 
-	while(maxCPU <= pbit->cpu)
-	{
-		create_diocpu();
+		max_cpu = c > max_cpu ? c : max_cpu;
 	}
-	if(category & BLK_TC_READ)
+	while((uint32_t)cur_shard->maxCPU <= max_cpu)
 	{
-		diocpu[pbit->cpu].r_cnt++;
+		create_diocpu(cur_shard);
 	}
-	else if(category & BLK_TC_WRITE)
+
+	// Distribute read/write data and point that.
+	diocpu = cur_shard->diocpu;
+	for(i=0 ; i<pbat->nr ; i++)
 	{
-		diocpu[pbit->cpu].w_cnt++;
+		uint32_t category = action[i] >> BLK_TC_SHIFT;
+		int is_valid = !(category & BLK_TC_NOTIFY) & (cpu[i] <= MAX_STAT_CPU);
+		int is_r = is_valid & ((category & BLK_TC_READ) != 0);
+		int is_w = is_valid & !is_r & ((category & BLK_TC_WRITE) != 0);
+		uint32_t c = is_valid ? cpu[i] : 0;
+
+		diocpu[c].r_cnt += is_r;
+		diocpu[c].w_cnt += is_w;
 	}
 }
 
@@ -1585,7 +5590,9 @@ void process_cpu_statistic(int bit_cnt)
 	}
 
 	//clear data
-	free(diocpu);
+	free(cur_shard->diocpu);
+	cur_shard->diocpu = NULL;
+	cur_shard->maxCPU = 0;
 	if(fCpuData != NULL)
 	{
 		fclose(fCpuData);
@@ -1593,9 +5600,30 @@ void process_cpu_statistic(int bit_cnt)
 	}
 }
 
+void merge_cpu_statistic(struct stat_shard* dst, struct stat_shard* src)
+{
+	int i;
+
+	while(dst->maxCPU < src->maxCPU)
+	{
+		create_diocpu(dst);
+	}
+	for(i=0 ; i<src->maxCPU ; i++)
+	{
+		dst->diocpu[i].r_cnt += src->diocpu[i].r_cnt;
+		dst->diocpu[i].w_cnt += src->diocpu[i].w_cnt;
+	}
+
+	free(src->diocpu);
+	src->diocpu = NULL;
+	src->maxCPU = 0;
+}
+
 void print_cpu_statistic_graphic(void)
 {
 	int i;
+	struct dio_cpu* diocpu = cur_shard->diocpu;
+	int maxCPU = cur_shard->maxCPU;
 
 	fprintf(fCpuData, "%s %s %s\n", "cpu", "read", "write");
 	for(i=0 ; i<maxCPU ; i++)
@@ -1607,6 +5635,8 @@ void print_cpu_statistic_graphic(void)
 void print_cpu_statistic_text(int bit_cnt)
 {
 	int i, tot;
+	struct dio_cpu* diocpu = cur_shard->diocpu;
+	int maxCPU = cur_shard->maxCPU;
 	fprintf(output,"%4s %7s %8s %8s\n", "CPU", "Type", "COUNT", "RATE");
 
 	for(i=0 ; i<maxCPU ; i++)
@@ -1626,6 +5656,103 @@ void print_cpu_statistic_text(int bit_cnt)
 
 }
 
+// cpu latency is the time from the first event to the last event of nugget
+// on the cpu which handled the last event
+void create_cputime(struct stat_shard* pshard, int cpu)
+{
+	int i;
+	int size = pshard->maxCPUTime;
+
+	while(size <= cpu)
+	{
+		size += INIT_NUM_CPU;
+	}
+	if(size == pshard->maxCPUTime)
+	{
+		return ;
+	}
+
+	pshard->cputime = (struct dio_cpu_time*)realloc(pshard->cputime, sizeof(struct dio_cpu_time) * size);
+	for(i=pshard->maxCPUTime ; i<size ; i++)
+	{
+		init_data_time(&pshard->cputime[i].data_time_read);
+		init_data_time(&pshard->cputime[i].data_time_write);
+	}
+	pshard->maxCPUTime = size;
+}
+
+void travel_cpu_time_statistic(struct dio_nugget* pdng)
+{
+	uint64_t time;
+
+	if(is_failed_nugget(pdng))
+	{
+		return ;
+	}
+
+	create_cputime(cur_shard, pdng->idxCPU);
+
+	time = pdng->times[pdng->elemidx-1] - pdng->times[0];
+	if(pdng->category & BLK_TC_READ)
+	{
+		add_data_time(&cur_shard->cputime[pdng->idxCPU].data_time_read, time);
+	}
+	else if(pdng->category & BLK_TC_WRITE)
+	{
+		add_data_time(&cur_shard->cputime[pdng->idxCPU].data_time_write, time);
+	}
+}
+
+void process_cpu_time_statistic(int ng_cnt)
+{
+	int i;
+	struct dio_cpu_time* pcputime;
+
+	fprintf(output,"%4s %6s ", "CPU", "Type");
+	print_data_time_header(output);
+	fprintf(output, "\n");
+
+	for(i=0 ; i<cur_shard->maxCPUTime ; i++)
+	{
+		pcputime = &cur_shard->cputime[i];
+		finish_data_time(&pcputime->data_time_read);
+		finish_data_time(&pcputime->data_time_write);
+
+		fprintf(output, "%4d %6s ", i, "Read");
+		print_data_time_statistic(output, &pcputime->data_time_read);
+		fprintf(output, "\n");
+		fprintf(output, "%4s %6s ", " ", "Write");
+		print_data_time_statistic(output, &pcputime->data_time_write);
+		fprintf(output, "\n\n");
+
+		clear_data_time(&pcputime->data_time_read);
+		clear_data_time(&pcputime->data_time_write);
+	}
+
+	free(cur_shard->cputime);
+	cur_shard->cputime = NULL;
+	cur_shard->maxCPUTime = 0;
+}
+
+void merge_cpu_time_statistic(struct stat_shard* dst, struct stat_shard* src)
+{
+	int i;
+
+	if(src->maxCPUTime > 0)
+	{
+		create_cputime(dst, src->maxCPUTime - 1);
+	}
+	for(i=0 ; i<src->maxCPUTime ; i++)
+	{
+		merge_data_time(&dst->cputime[i].data_time_read, &src->cputime[i].data_time_read);
+		merge_data_time(&dst->cputime[i].data_time_write, &src->cputime[i].data_time_write);
+	}
+
+	free(src->cputime);
+	src->cputime = NULL;
+	src->maxCPUTime = 0;
+}
+
 #if 0	// Replace other source
 //------------------- cpu statistics ------------------------------//
 
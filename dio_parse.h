@@ -0,0 +1,144 @@
+/*
+	dio_parse.h
+	The interface of dioparse for the statistic modules.
+
+	A statistic module is a shared object which is loaded by '-l' option.
+	It should define dio_stat_module_init() which registers its statistics
+	with dio_register_statistic(). Registered callbacks are run on the same
+	pass over bits and nuggets as the built-in statistics.
+*/
+
+#ifndef DIO_PARSE_H
+#define DIO_PARSE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "list.h"
+#include "rbtree.h"
+#include "blktrace_api.h"
+#include "dio_index.h"
+
+// dio_rbentity used for handling nuggets as sector order
+struct dio_rbentity{
+	struct rb_node rblink;		//red black tree link
+	struct list_head nghead;	//head of nugget list
+	uint64_t sector;
+	uint32_t device;
+	uint64_t key;			//device and sector, rbtree is ordered by it
+};
+
+// dio_nugget is a treated data of bit
+// it will be linked at dio_rbentity 's nghead
+#define MAX_ELEMENT_SIZE 50
+#define NG_ACTIVE	1
+#define NG_BACKMERGE	2
+#define NG_FRONTMERGE	3
+#define NG_COMPLETE	4
+struct dio_nugget{
+	struct list_head nglink;	//link of dio_nugget datatype
+	struct list_head actlink;	//link of active nugget list (stream mode only)
+	struct dio_rbentity* prben;	//rbentity which has this nugget
+	struct list_head mghead;	//head of nuggets merged into this nugget
+	struct list_head mglink;	//link of mlink's mghead
+
+	//real nugget data
+	int elemidx;	//element index. (elemidx-1) is count of nugget states
+	int category;	//category of the last bit
+	int categories;	//categories of all bits (flush, fua, sync, ...)
+	int error;	//errno of completion, 0 if it's succeeded
+	char states[MAX_ELEMENT_SIZE];	//action
+	uint64_t times[MAX_ELEMENT_SIZE];	//states[elemidx] is occured at times[elemidx]
+	int size;	//size of nugget
+	uint64_t sector;	//sector number of bit who was requested. is it really need?
+	uint32_t pid;
+	struct dio_nugget* mlink;	//if it was merged, than mlink points the other nugget
+	int ngflag;
+	int idxCPU;
+	int pathid;	//id of states on the path trie
+
+	// stacked devices (dm, md) remap the I/O to the lower devices.
+	// the nugget of lower device has the key of nugget which was remapped to it,
+	// and the nugget of upper device gets the latency of its lower nuggets
+	uint32_t device;
+	uint64_t key;		//device and sector, key of the indexes of nugget
+	bool has_upper;
+	uint64_t upper_key;	//key of the nugget on upper device
+	int nr_lower;		//count of the completed nuggets on lower devices
+	uint64_t lower_time;	//the longest latency of them
+
+	struct dio_interval ival;	//sector range on active nugget interval tree
+	bool is_indexed;		//is it linked on the interval tree?
+};
+
+// statistic data of a worker thread (see dio_parse.c)
+struct stat_shard;
+
+// statistic initialize function.
+typedef void(*statistic_init_func)(void);
+
+// statistic traveling function.
+// rb traveling function will be given the each nugget as a parameter
+typedef void(*statistic_travel_func)(struct dio_nugget*);
+
+// statistic iterating function.
+// list iterating function will be given the each bit as a parameter
+typedef void(*statistic_itr_func)(struct blk_io_trace*);
+
+// batch of bits for batch function.
+// bits are the copies of bit headers (without pdu), and their fields which
+// are used by counting statistics are also given as columns.
+struct dio_bit_batch{
+	const struct blk_io_trace* bits;
+	const uint32_t* action;
+	const uint32_t* cpu;
+	int nr;
+};
+
+// statistic batch function.
+// it is given the bits in batch instead of one bit per call, so the counting
+// can be done in a loop without branches. the batch is given later than itr
+// function, so it's for the statistic which doesn't depend on the order
+// with the other callbacks.
+typedef void(*statistic_batch_func)(const struct dio_bit_batch*);
+
+// statistic event function.
+// it is given the nugget which got an event of lifecycle, in time order.
+// 'actc' is the action character of event (ex. 'Q', 'D', 'C').
+// the merged nuggets get the events which are propagated from their request.
+typedef void(*statistic_event_func)(struct dio_nugget*, char actc, uint64_t time);
+
+// data process function.
+// it is given the count of nuggets if the statistic has travel function,
+// or the count of bits.
+typedef void(*statistic_process_func)(int);
+
+// shard merge function. 'src' shard is merged into 'dst' shard.
+// statistic which doesn't have merge function is run on main thread
+typedef void(*statistic_merge_func)(struct stat_shard* dst, struct stat_shard* src);
+
+// statistic callbacks. any of them can be NULL.
+// statistics which have only itr (or batch) are processed before the others.
+struct dio_stat_ops{
+	const char* name;
+	statistic_init_func init;
+	statistic_itr_func itr;
+	statistic_travel_func trv;
+	statistic_event_func evt;	//always run on the lifecycle thread
+	statistic_process_func proc;
+	statistic_merge_func merge;
+	statistic_batch_func batch;	//bits in batch, at the end for old modules
+};
+
+// register the statistic. ops is copied.
+// return false if it couldn't be registered
+bool dio_register_statistic(const struct dio_stat_ops* ops);
+
+// output stream of dioparse
+FILE* dio_output(void);
+
+// entry point of statistic module
+#define DIO_STAT_MODULE_INIT "dio_stat_module_init"
+typedef void(*dio_stat_module_init_func)(void);
+
+#endif
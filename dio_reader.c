@@ -0,0 +1,396 @@
+/*
+	dio_reader.c
+	Buffered reader of the raw tracing data which dio-shark writes.
+
+	This source is free on GNU General Public License.
+*/
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "dio_reader.h"
+#include "dio_shark.h"
+#include "dio_decode.h"
+
+// the time of bit found by resync should be in this range from the last bit
+#define DIO_RESYNC_TIME_SLACK	(10ULL * 1000000000)		/* bits of cpus are not ordered */
+#define DIO_RESYNC_TIME_RANGE	(24ULL * 3600 * 1000000000)
+
+static void dio_reader_report_skip(struct dio_reader* prd);
+
+bool dio_reader_open(struct dio_reader* prd, const char* path){
+	char* idxpath = NULL;
+	int comp;
+
+	memset(prd, 0, sizeof(struct dio_reader));
+	prd->idxfd = -1;
+	prd->skip_start = -1;
+	prd->decomp.fd = -1;
+
+	prd->fd = open(path, O_RDONLY);
+	if( prd->fd < 0 )
+		return false;
+
+	//columnar format has its own reader, and it owns fd
+	if( dio_col_probe(prd->fd) ){
+		prd->col = (struct dio_col_reader*)malloc(sizeof(struct dio_col_reader));
+		if( prd->col == NULL || !dio_col_reader_open(prd->col, prd->fd) ){
+			if( prd->col != NULL )
+				dio_col_reader_close(prd->col);
+			else
+				close(prd->fd);
+			free(prd->col);
+			prd->col = NULL;
+			prd->fd = -1;
+			return false;
+		}
+		prd->fd = -1;
+		return true;
+	}
+
+	prd->buf = (char*)malloc(DIO_READER_BUF_SIZE);
+	if( prd->buf == NULL ){
+		close(prd->fd);
+		prd->fd = -1;
+		return false;
+	}
+
+	//compressed file is read from the pipe of decompressor.
+	//sidecar index is not used, its offsets are of the raw file
+	comp = dio_comp_probe(prd->fd);
+	if( comp != DIO_COMP_NONE ){
+		if( !dio_decomp_open(&prd->decomp, prd->fd, comp) ){
+			close(prd->fd);
+			prd->fd = -1;
+			free(prd->buf);
+			prd->buf = NULL;
+			return false;
+		}
+		close(prd->fd);
+		prd->fd = prd->decomp.fd;
+		return true;
+	}
+
+	//sidecar index is optional
+	idxpath = (char*)malloc(strlen(path) + sizeof(DIO_IDX_SUFFIX));
+	if( idxpath != NULL ){
+		sprintf(idxpath, "%s%s", path, DIO_IDX_SUFFIX);
+		prd->idxfd = open(idxpath, O_RDONLY);
+		free(idxpath);
+	}
+	return true;
+}
+
+void dio_reader_close(struct dio_reader* prd){
+	//the damage reaches the end of file
+	if( prd->skip_start >= 0 ){
+		prd->pos = prd->len;
+		dio_reader_report_skip(prd);
+	}
+	if( prd->col != NULL ){
+		dio_col_reader_close(prd->col);
+		free(prd->col);
+		prd->col = NULL;
+	}
+	if( prd->decomp.pid > 0 )
+		dio_decomp_close(&prd->decomp);
+	else if( prd->fd >= 0 )
+		close(prd->fd);
+	prd->fd = -1;
+	if( prd->idxfd >= 0 )
+		close(prd->idxfd);
+	prd->idxfd = -1;
+	free(prd->buf);
+	prd->buf = NULL;
+	free(prd->proc_offs);
+	prd->proc_offs = NULL;
+}
+
+// detect the byte order of file from the first bit.
+// return false if the bit is not a valid bit in both byte orders
+static bool dio_reader_detect(struct dio_reader* prd, const struct blk_io_trace* pbit){
+	if( prd->order == DIO_ORDER_UNKNOWN )
+		prd->order = dio_decode_order(pbit);
+	if( prd->order == DIO_ORDER_UNKNOWN ){
+		errno = EINVAL;
+		return false;
+	}
+	return true;
+}
+
+static void dio_reader_report_skip(struct dio_reader* prd){
+	uint64_t end = prd->offset + prd->pos;
+
+	fprintf(stderr, "resync : skipped %llu bytes at offset %llu\n",
+		(unsigned long long)(end - prd->skip_start), (unsigned long long)prd->skip_start);
+	prd->skip_bytes += end - prd->skip_start;
+	prd->nr_skips++;
+	prd->skip_start = -1;
+}
+
+// make at least 'need' bytes available from pos.
+// return the available length which can be less than 'need' at the end of file
+static ssize_t dio_reader_fill(struct dio_reader* prd, size_t need){
+	ssize_t rdsz;
+
+	if( prd->len - prd->pos >= need )
+		return prd->len - prd->pos;
+
+	//move the remained data to the front of buffer
+	if( prd->pos > 0 ){
+		memmove(prd->buf, prd->buf + prd->pos, prd->len - prd->pos);
+		prd->offset += prd->pos;
+		prd->len -= prd->pos;
+		prd->decoded = prd->decoded > prd->pos ? prd->decoded - prd->pos : 0;
+		prd->pos = 0;
+	}
+
+	while( prd->len < need && prd->fd >= 0 ){
+		rdsz = read(prd->fd, prd->buf + prd->len, DIO_READER_BUF_SIZE - prd->len);
+		if( rdsz < 0 ){
+			if( errno == EINTR )
+				continue;
+			return -1;
+		}
+		if( rdsz == 0 ){
+			//the decompressor should be exited successfully at the end
+			if( prd->decomp.pid > 0 ){
+				prd->fd = -1;
+				if( !dio_decomp_close(&prd->decomp) ){
+					errno = EIO;
+					return -1;
+				}
+			}
+			break;
+		}
+		prd->len += rdsz;
+	}
+	return prd->len - prd->pos;
+}
+
+// start to skip the damaged bytes from the bit at pos
+static void dio_reader_skip(struct dio_reader* prd){
+	prd->skip_start = prd->offset + prd->pos;
+	prd->decoded = prd->pos;
+	prd->pos++;
+}
+
+// find the plausible bit on buf from pos. its time should be near the time
+// of bits before the damage. return its offset from pos, or len if none
+static size_t dio_reader_scan(struct dio_reader* prd, size_t len){
+	const char* p = prd->buf + prd->pos;
+	struct blk_io_trace bit;
+	size_t off = 0, found;
+	int order;
+
+	while( off < len ){
+		//both byte orders are tried if the first bit is damaged
+		if( prd->order != DIO_ORDER_UNKNOWN ){
+			order = prd->order;
+			found = off + dio_decode_scan(p + off, len - off, order == DIO_ORDER_SWAPPED);
+		}
+		else{
+			order = DIO_ORDER_NATIVE;
+			found = off + dio_decode_scan(p + off, len - off, false);
+			if( off + dio_decode_scan(p + off, found - off, true) < found ){
+				order = DIO_ORDER_SWAPPED;
+				found = off + dio_decode_scan(p + off, found - off, true);
+			}
+		}
+		if( found >= len )
+			break;
+
+		memcpy(&bit, p + found, sizeof(struct blk_io_trace));
+		if( order == DIO_ORDER_SWAPPED )
+			dio_decode_swap(&bit);
+		if( prd->last_time == 0 ||
+			(bit.time + DIO_RESYNC_TIME_SLACK >= prd->last_time &&
+			bit.time <= prd->last_time + DIO_RESYNC_TIME_RANGE) ){
+			prd->order = order;
+			return found;
+		}
+		off = found + 1;
+	}
+	return len;
+}
+
+// skip to the next valid bit after the damage.
+// return 1 if it is found, 0 at the end of file, -1 on error
+static int dio_reader_resync(struct dio_reader* prd){
+	ssize_t avail;
+	size_t off;
+
+	while( 1 ){
+		avail = dio_reader_fill(prd, DIO_READER_BUF_SIZE);
+		if( avail < 0 )
+			return -1;
+
+		off = dio_reader_scan(prd, avail);
+		if( off < (size_t)avail ){
+			prd->pos += off;
+			prd->decoded = prd->pos;
+			dio_reader_report_skip(prd);
+			return 1;
+		}
+
+		//the tail can be the front of a bit which is not read yet
+		if( avail >= (ssize_t)sizeof(struct blk_io_trace) )
+			prd->pos += avail - (sizeof(struct blk_io_trace) - 1);
+		if( avail < DIO_READER_BUF_SIZE )
+			return 0;
+	}
+}
+
+int dio_reader_next(struct dio_reader* prd, struct blk_io_trace* pbit, void* pdu, int pdusz){
+	ssize_t avail;
+	size_t reclen, need = sizeof(struct blk_io_trace);
+	bool invalid;
+	int ret;
+
+	if( prd->col != NULL )
+		return dio_col_reader_next(prd->col, pbit, pdu, pdusz);
+
+	//process bits which are skipped by seeking come first
+	if( prd->proc_pos < prd->nr_proc ){
+		uint64_t off = prd->proc_offs[prd->proc_pos++];
+
+		if( pread(prd->fd, pbit, sizeof(struct blk_io_trace), off) != sizeof(struct blk_io_trace) ||
+			!dio_reader_detect(prd, pbit) )
+			return -1;
+		if( prd->order == DIO_ORDER_SWAPPED )
+			dio_decode_swap(pbit);
+		if( !dio_decode_valid(pbit) ){
+			errno = EINVAL;
+			return -1;
+		}
+		if( pdu != NULL ){
+			memset(pdu, 0, pdusz);
+			if( pdusz > pbit->pdu_len )
+				pdusz = pbit->pdu_len;
+			if( pread(prd->fd, pdu, pdusz, off + sizeof(struct blk_io_trace)) != pdusz )
+				return -1;
+		}
+		return 1;
+	}
+
+	//decode all complete bits on buffer at once
+	while( prd->pos >= prd->decoded ){
+		avail = dio_reader_fill(prd, need);
+		if( avail < 0 )
+			return -1;
+		if( avail < (ssize_t)need )
+			return 0;	//truncated bit at the end of file is ignored
+		if( prd->skip_start >= 0 ){
+			ret = dio_reader_resync(prd);
+			if( ret <= 0 )
+				return ret;
+			continue;
+		}
+		memcpy(pbit, prd->buf + prd->pos, sizeof(struct blk_io_trace));
+		if( !dio_reader_detect(prd, pbit) ){
+			if( !prd->resync )
+				return -1;
+			dio_reader_skip(prd);
+			continue;
+		}
+
+		prd->decoded = prd->pos + dio_decode_bits(prd->buf + prd->pos, prd->len - prd->pos,
+			prd->order == DIO_ORDER_SWAPPED, &invalid);
+		if( prd->pos < prd->decoded )
+			break;
+		if( invalid ){
+			if( !prd->resync ){
+				errno = EINVAL;
+				return -1;
+			}
+			dio_reader_skip(prd);
+			continue;
+		}
+
+		//the first bit is not complete yet
+		if( prd->order == DIO_ORDER_SWAPPED )
+			dio_decode_swap(pbit);
+		need = sizeof(struct blk_io_trace) + pbit->pdu_len;
+	}
+	memcpy(pbit, prd->buf + prd->pos, sizeof(struct blk_io_trace));
+	reclen = sizeof(struct blk_io_trace) + pbit->pdu_len;
+	if( prd->last_time < pbit->time )
+		prd->last_time = pbit->time;
+
+	if( pdu != NULL ){
+		memset(pdu, 0, pdusz);
+		if( pdusz > pbit->pdu_len )
+			pdusz = pbit->pdu_len;
+		memcpy(pdu, prd->buf + prd->pos + sizeof(struct blk_io_trace), pdusz);
+	}
+	prd->pos += reclen;
+	return 1;
+}
+
+// seek to the last position where all bits before it are earlier than 'time'.
+// the index is only a hint, so nothing is changed if it can't be used
+static void dio_reader_seek_index(struct dio_reader* prd, uint64_t time){
+	struct stat st;
+	struct dio_idx_entry* entries = NULL;
+	uint64_t seek_off = 0;
+	size_t nr, i;
+	char magic[DIO_IDX_MAGIC_LEN];
+
+	if( fstat(prd->idxfd, &st) < 0 || st.st_size < DIO_IDX_MAGIC_LEN ||
+		pread(prd->idxfd, magic, DIO_IDX_MAGIC_LEN, 0) != DIO_IDX_MAGIC_LEN ||
+		memcmp(magic, DIO_IDX_MAGIC, DIO_IDX_MAGIC_LEN) != 0 )
+		return;
+
+	nr = (st.st_size - DIO_IDX_MAGIC_LEN) / sizeof(struct dio_idx_entry);
+	if( nr == 0 )
+		return;
+	entries = (struct dio_idx_entry*)malloc(nr * sizeof(struct dio_idx_entry));
+	if( entries == NULL )
+		return;
+	if( pread(prd->idxfd, entries, nr * sizeof(struct dio_idx_entry), DIO_IDX_MAGIC_LEN) !=
+		(ssize_t)(nr * sizeof(struct dio_idx_entry)) )
+		goto out;
+
+	for(i=0; i<nr; i++){
+		if( entries[i].type == DIO_IDX_SEEK && entries[i].time < time && seek_off < entries[i].offset )
+			seek_off = entries[i].offset;
+	}
+	if( seek_off == 0 || fstat(prd->fd, &st) < 0 || seek_off > (uint64_t)st.st_size )
+		goto out;
+
+	prd->proc_offs = (uint64_t*)malloc(nr * sizeof(uint64_t));
+	if( prd->proc_offs == NULL )
+		goto out;
+	for(i=0; i<nr; i++){
+		if( entries[i].type == DIO_IDX_PROCESS && entries[i].offset < seek_off )
+			prd->proc_offs[prd->nr_proc++] = entries[i].offset;
+	}
+
+	if( lseek(prd->fd, seek_off, SEEK_SET) < 0 ){
+		prd->nr_proc = 0;
+		goto out;
+	}
+	prd->offset = seek_off;
+
+out:
+	free(entries);
+}
+
+void dio_reader_set_filter(struct dio_reader* prd, const struct dio_col_filter* pfilter){
+	if( prd->col != NULL ){
+		dio_col_reader_set_filter(prd->col, pfilter);
+		return;
+	}
+
+	if( prd->idxfd >= 0 && pfilter->time_start > 0 && prd->offset == 0 && prd->len == 0 )
+		dio_reader_seek_index(prd, pfilter->time_start);
+}
+
+void dio_reader_set_resync(struct dio_reader* prd, bool resync){
+	prd->resync = resync;
+}
@@ -0,0 +1,69 @@
+/*
+	dio_reader.h
+	Buffered reader of the raw tracing data which dio-shark writes.
+
+	The bits are decoded from a large buffer instead of reading
+	each bit and seeking over its pdu with system calls.
+	The columnar format of dio_column.h is read through the same interface.
+	If the raw file has the sidecar index which dio-shark writes, the reader
+	seeks to the start of time filter with it.
+	The bits of raw file are validated and converted to the host byte order
+	on the buffer (see dio_decode.h), so a trace of big endian host can be read.
+	On resync mode, the damaged bytes are skipped to the next valid bit
+	instead of failing the read.
+	A compressed raw file is read from its decompressor (see dio_compress.h).
+*/
+
+#ifndef DIO_READER_H
+#define DIO_READER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "blktrace_api.h"
+#include "dio_column.h"
+#include "dio_compress.h"
+
+#define DIO_READER_BUF_SIZE	(1024*1024)
+
+struct dio_reader{
+	int fd;
+	char* buf;
+	size_t len;		//length of valid data in buf
+	size_t pos;		//position of next bit in buf
+	uint64_t offset;	//file offset of buf[0]
+	size_t decoded;		//bits before it on buf are decoded
+	int order;		//byte order of file (DIO_ORDER_*)
+	uint64_t last_time;	//the latest time of read bits
+
+	bool resync;
+	int64_t skip_start;	//file offset where the damage starts, -1 if not damaged
+	uint64_t skip_bytes;	//total length of skipped bytes
+	uint32_t nr_skips;	//count of skipped ranges
+	struct dio_col_reader* col;	//not NULL if the file is columnar format
+	struct dio_decomp decomp;	//decompressor of compressed file. fd is its pipe
+
+	int idxfd;		//sidecar index of raw file, -1 if there isn't
+	uint64_t* proc_offs;	//offsets of process bits before the seeked position
+	uint32_t nr_proc;
+	uint32_t proc_pos;	//position of next process bit to be read
+};
+
+bool dio_reader_open(struct dio_reader* prd, const char* path);
+void dio_reader_close(struct dio_reader* prd);
+
+// read a bit and the front of its pdu (at most pdusz bytes, rest is zero filled)
+// return 1 if a bit is read, 0 at the end of file, -1 on error.
+// errno is EINVAL if the bit has wrong magic or version
+int dio_reader_next(struct dio_reader* prd, struct blk_io_trace* pbit, void* pdu, int pdusz);
+
+// let the reader skip the bits which can't be matched with the filter.
+// the bits are still needed to be filtered, the reader skips only what it can.
+// it should be called before the first bit is read
+void dio_reader_set_filter(struct dio_reader* prd, const struct dio_col_filter* pfilter);
+
+// skip the damaged bytes of raw file and go on reading.
+// each skipped range is reported on stderr
+void dio_reader_set_resync(struct dio_reader* prd, bool resync);
+
+#endif
@@ -43,10 +43,18 @@ static char devPath[MAX_FILE_LENGTH];
 static char devName[16];
 /* global variables */
 bool g_isdone = false;
-pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;	// lock of output and index file
 pthread_cond_t g_cond	= PTHREAD_COND_INITIALIZER;
 pthread_barrier_t g_barrier;
 
+/* output file is shared by sharks, and written record by record */
+int g_fdOutput = -1;
+int g_fdIndex = -1;
+uint64_t g_outOffset = 0;	// size of output file
+uint64_t g_maxTime = 0;		// latest time of records written
+uint64_t g_idxRecords = 0;	// records since last seek entry
+uint64_t g_idxBytes = 0;	// bytes since last seek entry
+
 
 /* function declaration */
 struct list_head* create_list_head(void);
@@ -69,6 +77,11 @@ void fasten_sharks(struct list_head* shark_boss);
 int openfile_device(char *devpath);
 int openfile_debugfs(int idxCPU);
 int openfile_output(void);
+int openfile_index(void);
+
+int whole_records_len(char* buf, int len);
+bool write_records(char* buf, int len);
+bool write_all(int fd, char* buf, int len);
 
 void setup_buts(struct blk_user_trace_setup *pbuts);
 
@@ -120,6 +133,20 @@ int main(int argc, char** argv){
 	}
 	buts_stat = BUTS_STAT_SETUPED;
 	strcpy(devName,buts.name);
+	DBGOUT("openfile_output() entry \n");
+	// open output file and its index
+	g_fdOutput = openfile_output();
+	if(g_fdOutput < 0)
+	{
+		fprintf(stderr, "openfile_output() failed: %d/%s\n", errno, strerror(errno));
+		goto out;
+	}
+	g_fdIndex = openfile_index();
+	if(g_fdIndex < 0)
+	{
+		fprintf(stderr, "openfile_index() failed: %d/%s\n", errno, strerror(errno));
+		goto out;
+	}
 	DBGOUT("create_list_head() entry \n");
 	// create list head for creating threads
 	shark_boss = create_list_head();
@@ -169,7 +196,7 @@ out:
 	}
 
 	// fasten sharks that loosed
-	if(!list_empty(shark_boss))
+	if(shark_boss != NULL && !list_empty(shark_boss))
 	{
 		fasten_sharks(shark_boss);
 	}
@@ -180,6 +207,16 @@ out:
 		free(shark_boss);
 	}
 
+	// close output and index file
+	if(g_fdOutput >= 0)
+	{
+		close(g_fdOutput);
+	}
+	if(g_fdIndex >= 0)
+	{
+		close(g_fdIndex);
+	}
+
 	// close device file
 	if(fdDevice != 0)
 	{
@@ -350,11 +387,14 @@ void* shark_body(void* param){
 	struct blk_user_trace_setup buts;
 	struct thread_shark *shark = param;
 	struct pollfd fdpoll;
-	int fdOutput;
-	char buf[BUF_SIZE];
+	char buf[BUF_SIZE * 2];		// read data and the part of record left
+	int buflen = 0;
 	int lenread;
+	int lenrecord;
 	int ret;
 
+	fdpoll.fd = -1;
+
 	// lock this thread on one cpu
 	ret = lock_shark_on_cpu(shark->idxCPU);
 	if(!ret)
@@ -375,14 +415,6 @@ void* shark_body(void* param){
 	// wake thread that wait opening debug file
 	pthread_barrier_wait(&g_barrier);	
 
-	// open output file
-	fdOutput = openfile_output();
-	if(fdOutput < 0)
-	{
-		fprintf(stderr, "openfile_output() failed:%d/%s\n", errno, strerror(errno));
-		goto out;
-	}
-
 	// set poll data
 	fdpoll.events	= POLLIN;
 	fdpoll.revents	= 0;
@@ -403,34 +435,60 @@ void* shark_body(void* param){
 
 		if(fdpoll.revents & POLLIN)
 		{
-			memset(buf, 0, sizeof(buf));
-			lenread = read(fdpoll.fd, buf, sizeof(buf));
+			lenread = read(fdpoll.fd, buf + buflen, BUF_SIZE);
 			if(lenread < 0)
 			{
-				fprintf(stderr, "openfile_output() failed:%d/%s\n", errno, strerror(errno));
+				fprintf(stderr, "read() failed:%d/%s\n", errno, strerror(errno));
 				goto out;
 			}
+			buflen += lenread;
 
-			write(fdOutput, buf, lenread);
+			// only whole records are written, so the records of
+			// sharks are never mixed in the middle
+			lenrecord = whole_records_len(buf, buflen);
+			if(buflen - lenrecord > BUF_SIZE)
+			{
+				// too big record to be kept
+				lenrecord = buflen;
+			}
+			if(!write_records(buf, lenrecord))
+			{
+				fprintf(stderr, "write_records() failed:%d/%s\n", errno, strerror(errno));
+				goto out;
+			}
+			buflen -= lenrecord;
+			memmove(buf, buf + lenrecord, buflen);
 		}
 	}
 
 	//Write remain
-	memset(buf, 0, sizeof(buf));
-	lenread = read(fdpoll.fd, buf, sizeof(buf));
+	while((lenread = read(fdpoll.fd, buf + buflen, BUF_SIZE)) > 0)
+	{
+		buflen += lenread;
+		lenrecord = whole_records_len(buf, buflen);
+		if(buflen - lenrecord > BUF_SIZE)
+		{
+			lenrecord = buflen;
+		}
+		if(!write_records(buf, lenrecord))
+		{
+			fprintf(stderr, "write_records() failed:%d/%s\n", errno, strerror(errno));
+			goto out;
+		}
+		buflen -= lenrecord;
+		memmove(buf, buf + lenrecord, buflen);
+	}
 	if(lenread < 0)
 	{
-		fprintf(stderr, "openfile_output() failed:%d/%s\n", errno, strerror(errno));
+		fprintf(stderr, "read() failed:%d/%s\n", errno, strerror(errno));
 		goto out;
 	}
-
-	write(fdOutput, buf, lenread);
+	if(buflen > 0 && !write_records(buf, buflen))
+	{
+		fprintf(stderr, "write_records() failed:%d/%s\n", errno, strerror(errno));
+	}
 
 out:
-	// close output file
-	if(!(fdOutput < 0))
-		close(fdOutput);
-
 	// close debugfs file
 	if(!(fdpoll.fd < 0))
 		close(fdpoll.fd);
@@ -485,12 +543,121 @@ int openfile_debugfs(int idxCPU)
 int openfile_output(void)
 {	int fdOutput;
 
-	fdOutput = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	fdOutput = open(outPath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
 	if (fdOutput <0)
 		return -1;
 
 	return fdOutput;
 }
+int openfile_index(void)
+{
+	int fdIndex;
+	char buf[MAX_FILE_LENGTH + sizeof(DIO_IDX_SUFFIX)];
+
+	snprintf(buf, sizeof(buf), "%s%s", outPath, DIO_IDX_SUFFIX);
+	fdIndex = open(buf, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (fdIndex < 0)
+		return -1;
+
+	if(!write_all(fdIndex, DIO_IDX_MAGIC, DIO_IDX_MAGIC_LEN))
+	{
+		close(fdIndex);
+		return -1;
+	}
+	return fdIndex;
+}
+
+/*
+   length of the whole records from the front of buf
+ */
+int whole_records_len(char* buf, int len)
+{
+	struct blk_io_trace bit;
+	int pos = 0;
+
+	while(len - pos >= (int)sizeof(struct blk_io_trace))
+	{
+		memcpy(&bit, buf + pos, sizeof(struct blk_io_trace));
+		if(len - pos < (int)sizeof(struct blk_io_trace) + bit.pdu_len)
+			break;
+		pos += sizeof(struct blk_io_trace) + bit.pdu_len;
+	}
+	return pos;
+}
+
+bool write_all(int fd, char* buf, int len)
+{
+	int lenwrite;
+
+	while(len > 0)
+	{
+		lenwrite = write(fd, buf, len);
+		if(lenwrite < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+		buf += lenwrite;
+		len -= lenwrite;
+	}
+	return true;
+}
+
+/*
+   write the records on output file and add the index entries of them
+ */
+bool write_records(char* buf, int len)
+{
+	struct blk_io_trace bit;
+	struct dio_idx_entry entry;
+	int pos = 0;
+	int lenrecord;
+	bool ret = true;
+
+	if(len == 0)
+		return true;
+
+	pthread_mutex_lock(&g_mutex);
+	if(!write_all(g_fdOutput, buf, len))
+	{
+		pthread_mutex_unlock(&g_mutex);
+		return false;
+	}
+
+	memset(&entry, 0, sizeof(entry));
+	while(ret && len - pos >= (int)sizeof(struct blk_io_trace))
+	{
+		memcpy(&bit, buf + pos, sizeof(struct blk_io_trace));
+		lenrecord = sizeof(struct blk_io_trace) + bit.pdu_len;
+		if(lenrecord > len - pos)
+			break;
+
+		if(bit.action == BLK_TN_PROCESS)
+		{
+			entry.offset = g_outOffset + pos;
+			entry.time = bit.time;
+			entry.type = DIO_IDX_PROCESS;
+			ret = write_all(g_fdIndex, (char*)&entry, sizeof(entry));
+		}
+		if(g_maxTime < bit.time)
+			g_maxTime = bit.time;
+		pos += lenrecord;
+
+		if(++g_idxRecords >= DIO_IDX_RECORDS || (g_idxBytes += lenrecord) >= DIO_IDX_BYTES)
+		{
+			entry.offset = g_outOffset + pos;
+			entry.time = g_maxTime;
+			entry.type = DIO_IDX_SEEK;
+			ret = ret && write_all(g_fdIndex, (char*)&entry, sizeof(entry));
+			g_idxRecords = g_idxBytes = 0;
+		}
+	}
+	g_outOffset += len;
+	pthread_mutex_unlock(&g_mutex);
+
+	return ret;
+}
 
 void setup_buts(struct blk_user_trace_setup *pbuts)
 {
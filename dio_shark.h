@@ -21,6 +21,28 @@
 # define DBGOUT(fmt, ...)
 #endif
 
+/* sidecar index of output file
+   the index file (output file name + DIO_IDX_SUFFIX) is DIO_IDX_MAGIC and
+   the array of dio_idx_entry. every DIO_IDX_RECORDS records or DIO_IDX_BYTES
+   bytes, a seek entry is added. time of seek entry is the latest time of
+   records before its offset, so the records before offset can be skipped
+   when the wanted time is later than that. process entry points the
+   process notify record, which is needed even if it is skipped */
+#define DIO_IDX_SUFFIX		".idx"
+#define DIO_IDX_MAGIC		"DIOIDX01"
+#define DIO_IDX_MAGIC_LEN	8
+#define DIO_IDX_RECORDS		4096
+#define DIO_IDX_BYTES		(1024*1024)
+
+#define DIO_IDX_SEEK		1
+#define DIO_IDX_PROCESS		2
+struct dio_idx_entry{
+	uint64_t offset;	//file offset of output file
+	uint64_t time;
+	uint32_t type;
+	uint32_t reserved;
+};
+
 /* thread info */
 struct thread_shark{
 	struct list_head list;
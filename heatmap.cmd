@@ -0,0 +1,7 @@
+set title "I/O heatmap per LBA region"
+set view map
+set xlabel "Time (sec)"
+set ylabel "LBA region (GB)"
+set cblabel "No. of I/O"
+
+plot 'dioparse.heatmap.dat' using 1:2:3 with image